@@ -9,6 +9,6 @@ public class ProceduralLandscapeTarget : TargetRules
 	{
 		Type = TargetType.Game;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
-		ExtraModuleNames.AddRange( new string[] { "ProceduralLandscape" } );
+		ExtraModuleNames.AddRange( new string[] { "ProceduralLandscape", "ProceduralLandscapeCore" } );
 	}
 }
@@ -0,0 +1,209 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BakeProceduralTilesCommandlet.h"
+
+#include "../ProceduralLandscape.h"
+#include "../Tile/Foliage/FoliageDataAsset.h"
+#include "../Tile/Foliage/FoliageGenerationComponent.h"
+#include "../Tile/TileDiskCache.h"
+#include "../Tile/TileGenerator.h"
+#include "TileMeshBufferPool.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Parse.h"
+
+#include <atomic>
+
+namespace
+{
+	/**
+	 * Settings of a single foliage generation component of a tile.
+	 */
+	struct FBakedFoliageType
+	{
+		//Name of the cache record, see UFoliageGenerationComponent::MakeCacheRecordName
+		FString RecordName;
+
+		int SpawnCount = 0;
+
+		int MaxTries = 0;
+
+		EFoliagePlacementType PlacementType = EFoliagePlacementType::Random;
+
+		//Plain copies of the foliage types that have a mesh, aligned with the transforms of the record
+		TArray<FFoliageDescriptor> Descriptors;
+	};
+
+	/**
+	 * Adds the settings of a foliage generation component, components without a foliage mesh never store a record and are skipped.
+	 */
+	void AddBakedFoliageType(TArray<FBakedFoliageType>& FoliageTypes_Out, const TCHAR* ComponentName, const TArray<UFoliageDataAsset*>& FoliageData, int SpawnCount, int MaxTries, int Seed, EFoliagePlacementType PlacementType)
+	{
+		FBakedFoliageType FoliageType;
+		for (UFoliageDataAsset* FoliageDatum : FoliageData) {
+			if (FoliageDatum && FoliageDatum->FoliageMesh) FoliageType.Descriptors.Add(FoliageDatum->MakeDescriptor());
+		}
+		if (FoliageType.Descriptors.Num() == 0) return;
+		FoliageType.RecordName = UFoliageGenerationComponent::MakeCacheRecordName(ComponentName, FoliageData, SpawnCount, MaxTries, Seed, PlacementType);
+		FoliageType.SpawnCount = SpawnCount;
+		FoliageType.MaxTries = MaxTries;
+		FoliageType.PlacementType = PlacementType;
+		FoliageTypes_Out.Add(MoveTemp(FoliageType));
+	}
+}
+
+UBakeProceduralTilesCommandlet::UBakeProceduralTilesCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UBakeProceduralTilesCommandlet::Main(const FString& Params)
+{
+	FTileIndex MinTileIndex;
+	FTileIndex MaxTileIndex;
+	if (!ParseTileIndex(Params, TEXT("Min="), MinTileIndex) || !ParseTileIndex(Params, TEXT("Max="), MaxTileIndex)) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("BakeProceduralTiles: -Min=X,Y and -Max=X,Y are required"));
+		return 1;
+	}
+	if (MinTileIndex.X > MaxTileIndex.X || MinTileIndex.Y > MaxTileIndex.Y) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("BakeProceduralTiles: -Min has to be smaller than or equal to -Max"));
+		return 1;
+	}
+
+	UClass* GeneratorClass = ATileGenerator::StaticClass();
+	FString GeneratorPath;
+	if (FParse::Value(*Params, TEXT("Generator="), GeneratorPath)) {
+		GeneratorClass = LoadClass<ATileGenerator>(nullptr, *GeneratorPath);
+		if (!GeneratorClass) {
+			UE_LOG(LogProceduralLandscape, Error, TEXT("BakeProceduralTiles: could not load the tile generator class %s"), *GeneratorPath);
+			return 1;
+		}
+	}
+	//The defaults hold the whole configuration, no generator has to be spawned
+	const ATileGenerator* Generator = GeneratorClass->GetDefaultObject<ATileGenerator>();
+	int Seed = Generator->RandomSeed;
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	bool bForce = FParse::Param(*Params, TEXT("Force"));
+	bool bNoWrite = FParse::Param(*Params, TEXT("NoWrite"));
+
+	FTileGenerationParams BaseTileGenerationParams = Generator->MakeTileGenerationParams(Seed);
+	BaseTileGenerationParams.bGenerateSkirts = false;
+	FTileDiskCachePtr DiskCache = MakeShared<FTileDiskCache, ESPMode::ThreadSafe>(FTileDiskCache::GetCacheDirectory(BaseTileGenerationParams, Seed));
+
+	//Every resolution and scale the runtime can request for a tile of the region is baked
+	TArray<FTileGenerationParams> Jobs;
+	int LODLevelCount = Generator->bUseLODRings ? FMath::Max(Generator->LODLevelCount, 1) : 1;
+	for (int LODLevel = 0; LODLevel < LODLevelCount; ++LODLevel) {
+		for (int64 X = MinTileIndex.X; X <= MaxTileIndex.X; ++X) {
+			for (int64 Y = MinTileIndex.Y; Y <= MaxTileIndex.Y; ++Y) {
+				FTileGenerationParams& Job = Jobs.Add_GetRef(BaseTileGenerationParams);
+				Job.TileIndex = FTileIndex(X, Y);
+				Job.TileResolution = Generator->GetLODResolution(LODLevel);
+			}
+		}
+	}
+	if (Generator->bUseQuadtree) {
+		for (int Depth = 1; Depth <= Generator->QuadtreeDepth; ++Depth) {
+			int Scale = 1 << Depth;
+			//Nodes start at multiples of their scale, every node that touches the region is baked
+			for (int64 X = (MinTileIndex.X >> Depth) * Scale; X <= MaxTileIndex.X; X += Scale) {
+				for (int64 Y = (MinTileIndex.Y >> Depth) * Scale; Y <= MaxTileIndex.Y; Y += Scale) {
+					FTileGenerationParams& Job = Jobs.Add_GetRef(BaseTileGenerationParams);
+					Job.TileIndex = FTileIndex(X, Y);
+					Job.LODScale = Scale;
+				}
+			}
+		}
+	}
+
+	UE_LOG(LogProceduralLandscape, Display, TEXT("BakeProceduralTiles: baking %d tiles with seed %d into %s"), Jobs.Num(), Seed, *FTileDiskCache::GetCacheDirectory(BaseTileGenerationParams, Seed));
+
+	FTileMeshBufferPool MeshBufferPool;
+	double StartTime = FPlatformTime::Seconds();
+	ParallelFor(Jobs.Num(), [&](int32 JobIndex) {
+		const FTileGenerationParams& Job = Jobs[JobIndex];
+		FTileMeshDataPtr MeshData = MeshBufferPool.Acquire(Job.TileResolution);
+		//Only the heightfield and the normals are stored, so the data for an update is enough and skips the index buffer
+		AProceduralTile::BuildMeshData(Job, true, *MeshData, bForce || bNoWrite ? nullptr : DiskCache);
+		if (bForce && !bNoWrite) DiskCache->SaveHeightfield(Job, MeshData->Heightfield, MeshData->Normals.GetData());
+		MeshBufferPool.Release(MeshData);
+	});
+	double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogProceduralLandscape, Display, TEXT("BakeProceduralTiles: %d tiles in %.3f s, %.1f tiles/s, %.3f ms per tile"), Jobs.Num(), Seconds, Jobs.Num() / FMath::Max(Seconds, 1e-6), Seconds * 1000.0 / FMath::Max(Jobs.Num(), 1));
+
+	//Foliage only exists on tiles at full detail, the components run in the same order as in the foliage jobs of the generator
+	TArray<FBakedFoliageType> FoliageTypes;
+	if (Generator->bGenerateTrees) AddBakedFoliageType(FoliageTypes, AProceduralTile::TreeGenerationComponentName, Generator->TreeData, Generator->TreeSpawnCount, Generator->TreeMaxTries, Seed, Generator->TreePlacementType);
+	if (Generator->bGenerateBushes) AddBakedFoliageType(FoliageTypes, AProceduralTile::BushGenerationComponentName, Generator->BushData, Generator->BushSpawnCount, Generator->BushMaxTries, Seed, Generator->BushPlacementType);
+	if (Generator->bGenerateGrass) AddBakedFoliageType(FoliageTypes, AProceduralTile::GrassGenerationComponentName, Generator->GrassData, Generator->GrassSpawnCount, Generator->GrassMaxTries, Seed, EFoliagePlacementType::Random);
+	TArray<FTileIndex> FoliageTiles;
+	if (FoliageTypes.Num() > 0) {
+		for (int64 X = MinTileIndex.X; X <= MaxTileIndex.X; ++X) {
+			for (int64 Y = MinTileIndex.Y; Y <= MaxTileIndex.Y; ++Y) {
+				FoliageTiles.Add(FTileIndex(X, Y));
+			}
+		}
+	}
+
+	std::atomic<int64> FoliageInstanceCount{ 0 };
+	StartTime = FPlatformTime::Seconds();
+	ParallelFor(FoliageTiles.Num(), [&](int32 FoliageTileIndex) {
+		FTileIndex CurrentTileIndex = FoliageTiles[FoliageTileIndex];
+		FTileHeightfield Heightfield;
+		TArray<FGeneratedFoliageInfo> FoliageInfos;
+		for (const FBakedFoliageType& FoliageType : FoliageTypes) {
+			//Later components avoid the instances of baked components, exactly like at runtime.
+			//The record has one section per foliage type, like InstancesToSpawn of the component
+			TArray<FTransformArrayA2> Instances;
+			Instances.SetNum(FoliageType.Descriptors.Num());
+			if (!bForce && !bNoWrite && DiskCache->LoadFoliage(CurrentTileIndex, FoliageType.RecordName, Instances)) {
+				UFoliageGenerationComponent::AddFoliageInfos(Instances, FoliageType.Descriptors, FoliageInfos);
+				continue;
+			}
+			//The ground is only generated if a component of the tile has to be placed, always at full resolution
+			if (Heightfield.Heights.Num() == 0) {
+				FTileGenerationParams GroundGenerationParams = BaseTileGenerationParams;
+				GroundGenerationParams.TileIndex = CurrentTileIndex;
+				FTileTerrain::GenerateHeightfield(GroundGenerationParams.GetTerrainTileParams(), Heightfield);
+			}
+			FFoliagePlacementParams PlacementParams = UFoliageGenerationComponent::MakePlacementParams(CurrentTileIndex, Generator->TileSize, FoliageType.SpawnCount, FoliageType.MaxTries, Seed, FoliageType.PlacementType);
+			TArray<FFoliageInstance> PlacedInstances;
+			UFoliageGenerationComponent::PlaceFoliage(PlacementParams, FoliageType.Descriptors, Heightfield, FoliageInfos, PlacedInstances);
+			for (FTransformArrayA2& DescriptorInstances : Instances) DescriptorInstances.Reset();
+			for (const FFoliageInstance& Instance : PlacedInstances) {
+				Instances[Instance.DescriptorIndex].Add(Instance.Transform);
+			}
+			FoliageInstanceCount += PlacedInstances.Num();
+			if (!bNoWrite) DiskCache->SaveFoliage(CurrentTileIndex, FoliageType.RecordName, Instances);
+		}
+	});
+	Seconds = FPlatformTime::Seconds() - StartTime;
+
+	if (FoliageTiles.Num() > 0) {
+		UE_LOG(LogProceduralLandscape, Display, TEXT("BakeProceduralTiles: foliage of %d tiles in %.3f s, %lld instances were placed"), FoliageTiles.Num(), Seconds, FoliageInstanceCount.load());
+	}
+	if (!bForce && !bNoWrite) {
+		UE_LOG(LogProceduralLandscape, Display, TEXT("BakeProceduralTiles: %d records were already baked, %d were generated"), DiskCache->GetHitCount(), DiskCache->GetMissCount());
+	}
+	return 0;
+}
+
+bool UBakeProceduralTilesCommandlet::ParseTileIndex(const FString& Params, const TCHAR* Name, FTileIndex& TileIndex_Out)
+{
+	FString Value;
+	if (!FParse::Value(*Params, Name, Value, false)) return false;
+	FString XString;
+	FString YString;
+	if (!Value.Split(TEXT(","), &XString, &YString)) return false;
+	XString.TrimStartAndEndInline();
+	YString.TrimStartAndEndInline();
+	if (!XString.IsNumeric() || !YString.IsNumeric()) return false;
+	TileIndex_Out = FTileIndex(FCString::Atoi64(*XString), FCString::Atoi64(*YString));
+	return true;
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "../Tile/ProceduralTile.h"
+#include "BakeProceduralTilesCommandlet.generated.h"
+
+/**
+ * Generates the heightfields and the foliage of a rectangular region of tiles into the tile disk cache without a world, rendering or ticking.
+ * The foliage is stored under the same record names as the foliage generation components use, so the runtime loads it instead of placing it.
+ *
+ * Usage: -run=BakeProceduralTiles -Min=X,Y -Max=X,Y [-Generator=/Game/Path/BP_TileGenerator.BP_TileGenerator_C] [-Seed=N] [-Force] [-NoWrite]
+ *
+ * -Generator the class whose defaults provide the configuration, ATileGenerator if it is not set
+ * -Seed overrides the random seed of the configuration
+ * -Force generates every tile again even if it is already in the cache
+ * -NoWrite only generates the tiles, useful to measure the throughput of the generation
+ */
+UCLASS()
+class PROCEDURALLANDSCAPE_API UBakeProceduralTilesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBakeProceduralTilesCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	/**
+	 * Reads a tile index in the form X,Y from the command line.
+	 *
+	 * \param Params the command line of the commandlet
+	 * \param Name the name of the argument including the equals sign
+	 * \param TileIndex_Out the parsed index
+	 * \return true if the argument exists and is valid
+	 */
+	static bool ParseTileIndex(const FString& Params, const TCHAR* Name, FTileIndex& TileIndex_Out);
+};
@@ -0,0 +1,526 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BenchmarkProceduralTilesCommandlet.h"
+
+#include "../ProceduralLandscape.h"
+#include "../Tile/ProceduralTile.h"
+#include "../Tile/TileGenerator.h"
+#include "../Tile/Foliage/FoliageGenerationComponent.h"
+#include "TileFractalNoise.h"
+#include "TileMeshBufferPool.h"
+#include "TileNoise.h"
+
+#include "Dom/JsonObject.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Templates/TypeCompatibleBytes.h"
+
+#include <atomic>
+
+namespace
+{
+	/**
+	 * Forwards every request to the wrapped allocator and counts the allocations.
+	 * The allocator is process wide, so allocations of other threads are counted as well. The benchmarks run on the game thread
+	 * without background work, so they only add a little noise.
+	 */
+	class FCountingMalloc : public FMalloc
+	{
+	public:
+		explicit FCountingMalloc(FMalloc* InnerMalloc_In) : InnerMalloc(InnerMalloc_In) {}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			++AllocationCount;
+			return InnerMalloc->Malloc(Count, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			++AllocationCount;
+			return InnerMalloc->TryMalloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			SIZE_T OriginalSize = GetOriginalSize(Original);
+			void* Result = InnerMalloc->Realloc(Original, Count, Alignment);
+			CountRealloc(Original, OriginalSize, Result, Count);
+			return Result;
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			SIZE_T OriginalSize = GetOriginalSize(Original);
+			void* Result = InnerMalloc->TryRealloc(Original, Count, Alignment);
+			CountRealloc(Original, OriginalSize, Result, Count);
+			return Result;
+		}
+
+		virtual void Free(void* Original) override
+		{
+			InnerMalloc->Free(Original);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return InnerMalloc->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return InnerMalloc->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			InnerMalloc->Trim(bTrimThreadCaches);
+		}
+
+		virtual void SetupTLSCachesOnCurrentThread() override
+		{
+			InnerMalloc->SetupTLSCachesOnCurrentThread();
+		}
+
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+		{
+			InnerMalloc->ClearAndDisableTLSCachesOnCurrentThread();
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return InnerMalloc->IsInternallyThreadSafe();
+		}
+
+		virtual bool ValidateHeap() override
+		{
+			return InnerMalloc->ValidateHeap();
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return InnerMalloc->GetDescriptiveName();
+		}
+
+		int64 GetAllocationCount() const
+		{
+			return AllocationCount.load();
+		}
+
+	private:
+		/**
+		 * \param Original the block that is reallocated, can be null
+		 * \return the usable size of the block, 0 if it is null or the allocator does not track sizes
+		 */
+		SIZE_T GetOriginalSize(void* Original)
+		{
+			SIZE_T OriginalSize = 0;
+			if (Original && !InnerMalloc->GetAllocationSize(Original, OriginalSize)) OriginalSize = 0;
+			return OriginalSize;
+		}
+
+		/**
+		 * Counts a reallocation that had to allocate, a block that shrinks or grows in place is not counted.
+		 */
+		void CountRealloc(void* Original, SIZE_T OriginalSize, void* Result, SIZE_T Count)
+		{
+			if (Count == 0 || !Result) return;
+			if (Result != Original || Count > OriginalSize) ++AllocationCount;
+		}
+
+		FMalloc* InnerMalloc;
+
+		std::atomic<int64> AllocationCount{ 0 };
+	};
+
+	/**
+	 * Installs the counting allocator the first time it is requested, must be called on the game thread.
+	 * Worker threads can still hold the previous value of GMalloc, so the allocator is never uninstalled or destroyed.
+	 * It lives in static storage that is not destructed at exit, frees after the commandlet still go through it.
+	 */
+	FCountingMalloc& GetCountingMalloc()
+	{
+		static TTypeCompatibleBytes<FCountingMalloc> CountingMallocStorage;
+		static FCountingMalloc* CountingMalloc = nullptr;
+		if (!CountingMalloc) {
+			CountingMalloc = new (CountingMallocStorage.GetTypedPtr()) FCountingMalloc(GMalloc);
+			GMalloc = CountingMalloc;
+		}
+		return *CountingMalloc;
+	}
+
+	/**
+	 * Counts the allocations between its creation and GetAllocationCount, the counts of nested scopes overlap.
+	 */
+	class FScopedAllocationCounter
+	{
+	public:
+		FScopedAllocationCounter()
+			: StartAllocationCount(GetCountingMalloc().GetAllocationCount())
+		{
+		}
+
+		int64 GetAllocationCount() const
+		{
+			return GetCountingMalloc().GetAllocationCount() - StartAllocationCount;
+		}
+
+	private:
+		int64 StartAllocationCount;
+	};
+
+	//Generations that are not measured, they fill the pools and caches
+	constexpr int WarmupIterations = 2;
+}
+
+UBenchmarkProceduralTilesCommandlet::UBenchmarkProceduralTilesCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UBenchmarkProceduralTilesCommandlet::Main(const FString& Params)
+{
+	UClass* GeneratorClass = ATileGenerator::StaticClass();
+	FString GeneratorPath;
+	if (FParse::Value(*Params, TEXT("Generator="), GeneratorPath)) {
+		GeneratorClass = LoadClass<ATileGenerator>(nullptr, *GeneratorPath);
+		if (!GeneratorClass) {
+			UE_LOG(LogProceduralLandscape, Error, TEXT("BenchmarkProceduralTiles: could not load the tile generator class %s"), *GeneratorPath);
+			return 1;
+		}
+	}
+	const ATileGenerator* Generator = GeneratorClass->GetDefaultObject<ATileGenerator>();
+
+	int Iterations = 20;
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	Iterations = FMath::Max(Iterations, 1);
+	double Tolerance = 0.1;
+	FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+	TArray<int> SpawnCounts = ParseIntList(Params, TEXT("SpawnCounts="), { 50, 200, 800, 5000 });
+	TArray<int> MaxTries = ParseIntList(Params, TEXT("MaxTries="), { 10, 100 });
+
+	FString OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), FString::Printf(TEXT("ProceduralLandscape-%s.csv"), *FDateTime::Now().ToString()));
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	//Installed once for the whole run, before the benchmarks start any work on other threads
+	GetCountingMalloc();
+	Metrics.Reset();
+	BenchmarkNoise(Iterations);
+	BenchmarkTiles(Generator, Iterations);
+	BenchmarkFoliage(Generator, Iterations, SpawnCounts, MaxTries);
+
+	for (const FProceduralBenchmarkMetric& Metric : Metrics) {
+		UE_LOG(LogProceduralLandscape, Display, TEXT("%-48s %16.3f %s"), *Metric.Name, Metric.Value, *Metric.Unit);
+	}
+	if (!WriteReport(OutputPath)) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("BenchmarkProceduralTiles: could not write %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogProceduralLandscape, Display, TEXT("BenchmarkProceduralTiles: report written to %s"), *OutputPath);
+
+	FString BaselinePath;
+	if (!FParse::Value(*Params, TEXT("Baseline="), BaselinePath)) return 0;
+	TMap<FString, FProceduralBenchmarkMetric> Baseline;
+	if (!ReadReport(BaselinePath, Baseline)) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("BenchmarkProceduralTiles: could not read the baseline %s"), *BaselinePath);
+		return 1;
+	}
+	int RegressionCount = CompareAgainstBaseline(Baseline, Tolerance);
+	if (RegressionCount > 0) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("BenchmarkProceduralTiles: %d metrics regressed by more than %.0f%%"), RegressionCount, Tolerance * 100);
+		return 1;
+	}
+	return 0;
+}
+
+void UBenchmarkProceduralTilesCommandlet::BenchmarkNoise(int Iterations)
+{
+	const int RowLength = 256;
+	TArray<float> YPositions;
+	TArray<float> ZOffsets;
+	YPositions.SetNumUninitialized(RowLength);
+	ZOffsets.SetNumUninitialized(RowLength);
+	for (int i = 0; i < RowLength; ++i) {
+		YPositions[i] = i / 17.f;
+	}
+	const FVector2D NoiseScale(0.37f, 0.41f);
+	const FVector2D NoiseOffset(3.5f, 7.25f);
+
+	//Every iteration evaluates a full 256x256 tile
+	int64 EvaluationCount = int64(Iterations) * RowLength * RowLength;
+	float Checksum = 0.f;
+	double StartTime = FPlatformTime::Seconds();
+	for (int Row = 0; Row < Iterations * RowLength; ++Row) {
+		FTileNoise::GetZOffsetRow(Row / 13.f, YPositions.GetData(), RowLength, NoiseScale, NoiseOffset, 1.f, ZOffsets.GetData());
+		Checksum += ZOffsets[Row % RowLength];
+	}
+	double KernelSeconds = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	for (int Row = 0; Row < Iterations * RowLength; ++Row) {
+		float XPos = Row / 13.f;
+		for (int i = 0; i < RowLength; ++i) {
+			ZOffsets[i] = FMath::PerlinNoise2D(FVector2D(XPos * NoiseScale.X + NoiseOffset.X, YPositions[i] * NoiseScale.Y + NoiseOffset.Y));
+		}
+		Checksum += ZOffsets[Row % RowLength];
+	}
+	double EngineSeconds = FPlatformTime::Seconds() - StartTime;
+
+	//Four octaves is a typical detail noise, the warped ridged variant is the most expensive configuration.
+	//The fractal takes its locations in double precision, like the heightfield of a tile
+	TArray<double> FractalYPositions(YPositions);
+	FTileFractalParams FractalParams;
+	FractalParams.OctaveCount = 4;
+	FractalParams.Scale = NoiseScale;
+	FractalParams.Offset = NoiseOffset;
+	FractalParams.Strength = 1.f;
+	double FbmSeconds = TimeFractalNoise(FractalParams, Iterations, FractalYPositions, ZOffsets, Checksum);
+	FractalParams.Type = ETileFractalType::Ridged;
+	FractalParams.WarpStrength = 0.5f;
+	FractalParams.WarpScale = NoiseScale * 0.25f;
+	double RidgedSeconds = TimeFractalNoise(FractalParams, Iterations, FractalYPositions, ZOffsets, Checksum);
+	//Keeps the loops from being optimized away
+	UE_LOG(LogProceduralLandscape, Verbose, TEXT("BenchmarkProceduralTiles: noise checksum %f"), Checksum);
+
+	AddMetric(TEXT("Noise.EvaluationsPerSecond"), EvaluationCount / FMath::Max(KernelSeconds, 1e-9), TEXT("evaluations/s"), true);
+	AddMetric(TEXT("Noise.EngineEvaluationsPerSecond"), EvaluationCount / FMath::Max(EngineSeconds, 1e-9), TEXT("evaluations/s"), true);
+	AddMetric(TEXT("Noise.Fbm4SamplesPerSecond"), EvaluationCount / FMath::Max(FbmSeconds, 1e-9), TEXT("samples/s"), true);
+	AddMetric(TEXT("Noise.RidgedWarped4SamplesPerSecond"), EvaluationCount / FMath::Max(RidgedSeconds, 1e-9), TEXT("samples/s"), true);
+}
+
+double UBenchmarkProceduralTilesCommandlet::TimeFractalNoise(const FTileFractalParams& FractalParams, int Iterations, const TArray<double>& YPositions, TArray<float>& ZOffsets, float& Checksum)
+{
+	int RowLength = YPositions.Num();
+	double StartTime = FPlatformTime::Seconds();
+	for (int Row = 0; Row < Iterations * RowLength; ++Row) {
+		FTileFractalNoise::GetZOffsetRow(Row / 13.0, YPositions.GetData(), RowLength, FractalParams, ZOffsets.GetData());
+		Checksum += ZOffsets[Row % RowLength];
+	}
+	return FPlatformTime::Seconds() - StartTime;
+}
+
+void UBenchmarkProceduralTilesCommandlet::BenchmarkTiles(const ATileGenerator* Generator, int Iterations)
+{
+	FTileGenerationParams BaseTileGenerationParams = Generator->MakeTileGenerationParams(Generator->RandomSeed);
+	FTileMeshBufferPool MeshBufferPool;
+	for (int TileResolution = 2; TileResolution <= 256; TileResolution *= 2) {
+		FTileGenerationParams CurrentTileGenerationParams = BaseTileGenerationParams;
+		CurrentTileGenerationParams.TileResolution = TileResolution;
+
+		//The first generation of a resolution allocates the pooled buffers and the shared index buffer
+		int64 ColdAllocationCount = 0;
+		for (int i = 0; i < WarmupIterations; ++i) {
+			FScopedAllocationCounter AllocationCounter;
+			CurrentTileGenerationParams.TileIndex = FTileIndex(-1 - i, 0);
+			FTileMeshDataPtr MeshData = MeshBufferPool.Acquire(TileResolution);
+			AProceduralTile::BuildMeshData(CurrentTileGenerationParams, false, *MeshData, nullptr);
+			MeshBufferPool.Release(MeshData);
+			if (i == 0) ColdAllocationCount = AllocationCounter.GetAllocationCount();
+		}
+
+		int64 AllocationCount = 0;
+		double StartTime = FPlatformTime::Seconds();
+		{
+			FScopedAllocationCounter AllocationCounter;
+			for (int i = 0; i < Iterations; ++i) {
+				CurrentTileGenerationParams.TileIndex = FTileIndex(i, i);
+				FTileMeshDataPtr MeshData = MeshBufferPool.Acquire(TileResolution);
+				AProceduralTile::BuildMeshData(CurrentTileGenerationParams, false, *MeshData, nullptr);
+				MeshBufferPool.Release(MeshData);
+			}
+			AllocationCount = AllocationCounter.GetAllocationCount();
+		}
+		double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		AddMetric(FString::Printf(TEXT("Tile.R%d.MsPerTile"), TileResolution), Seconds * 1000.0 / Iterations, TEXT("ms"), false);
+		AddMetric(FString::Printf(TEXT("Tile.R%d.AllocationsPerTile"), TileResolution), double(AllocationCount) / Iterations, TEXT("allocations"), false);
+		AddMetric(FString::Printf(TEXT("Tile.R%d.ColdAllocations"), TileResolution), double(ColdAllocationCount), TEXT("allocations"), false);
+	}
+}
+
+void UBenchmarkProceduralTilesCommandlet::BenchmarkFoliage(const ATileGenerator* Generator, int Iterations, const TArray<int>& SpawnCounts, const TArray<int>& MaxTries)
+{
+	struct FFoliageType
+	{
+		const TCHAR* Name;
+		const TArray<UFoliageDataAsset*>* FoliageData;
+		bool bSupportsPoissonDisk;
+	};
+	const FFoliageType FoliageTypes[] = { { TEXT("Tree"), &Generator->TreeData, true }, { TEXT("Bush"), &Generator->BushData, true }, { TEXT("Grass"), &Generator->GrassData, false } };
+
+	bool bHasFoliage = false;
+	for (const FFoliageType& FoliageType : FoliageTypes) bHasFoliage |= FoliageType.FoliageData->Num() > 0;
+	if (!bHasFoliage) {
+		UE_LOG(LogProceduralLandscape, Warning, TEXT("BenchmarkProceduralTiles: the generator has no foliage data, use -Generator= to measure the foliage placement"));
+		return;
+	}
+
+	//The foliage components are owned by a tile actor, so the tile needs a world
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("ProceduralLandscapeBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	FTileGenerationParams CurrentTileGenerationParams = Generator->MakeTileGenerationParams(Generator->RandomSeed);
+	AProceduralTile* Tile = World->SpawnActor<AProceduralTile>(FVector::ZeroVector, FRotator::ZeroRotator);
+	Tile->Setup(nullptr, nullptr, nullptr, true, true, true);
+	Tile->GenerateTile(CurrentTileGenerationParams);
+	//The ground is sampled from the heights of the tile, exactly like the foliage jobs of the generator do
+	FTileHeightfieldPtr GroundHeightfield = Tile->GetGroundHeightfield();
+	UFoliageGenerationComponent* FoliageGenerationComponents[] = { Tile->GetTreeGenerationComponent(), Tile->GetBushGenerationComponent(), Tile->GetGrassGenerationComponent() };
+
+	for (int TypeIndex = 0; TypeIndex < UE_ARRAY_COUNT(FoliageTypes); ++TypeIndex) {
+		const FFoliageType& FoliageType = FoliageTypes[TypeIndex];
+		UFoliageGenerationComponent* FoliageGenerationComponent = FoliageGenerationComponents[TypeIndex];
+		if (FoliageType.FoliageData->Num() == 0 || !FoliageGenerationComponent) continue;
+
+		//Trees and bushes are measured with both placement types, grass only uses the random placement
+		TArray<EFoliagePlacementType, TInlineAllocator<2>> PlacementTypes = { EFoliagePlacementType::Random };
+		if (FoliageType.bSupportsPoissonDisk) PlacementTypes.Add(EFoliagePlacementType::PoissonDisk);
+		for (EFoliagePlacementType PlacementType : PlacementTypes) {
+			for (int SpawnCount : SpawnCounts) {
+				for (int CurrentMaxTries : MaxTries) {
+					int64 PlacementCount = 0;
+					int64 AllocationCount = 0;
+					double Seconds = 0.0;
+					for (int i = 0; i < WarmupIterations + Iterations; ++i) {
+						//Every iteration uses another seed, so the result does not depend on a single lucky layout
+						FoliageGenerationComponent->SetupFoliageGeneration(CurrentTileGenerationParams.TileIndex, *FoliageType.FoliageData, SpawnCount, CurrentMaxTries, SpawnCount, Generator->RandomSeed + i, false, false, 0.f, false, nullptr, PlacementType);
+						TArray<FGeneratedFoliageInfo> FoliageInfos;
+						FScopedAllocationCounter AllocationCounter;
+						double StartTime = FPlatformTime::Seconds();
+						FoliageGenerationComponent->GenerateFoliage(FoliageInfos, false, CurrentTileGenerationParams.TileSize, [&GroundHeightfield]() -> const FTileHeightfield& { return *GroundHeightfield; });
+						if (i < WarmupIterations) continue;
+						Seconds += FPlatformTime::Seconds() - StartTime;
+						AllocationCount += AllocationCounter.GetAllocationCount();
+						PlacementCount += FoliageInfos.Num();
+					}
+
+					FString Prefix = FString::Printf(TEXT("Foliage.%s%s.S%d.T%d"), FoliageType.Name, PlacementType == EFoliagePlacementType::PoissonDisk ? TEXT(".Poisson") : TEXT(""), SpawnCount, CurrentMaxTries);
+					AddMetric(Prefix + TEXT(".PlacementsPerSecond"), PlacementCount / FMath::Max(Seconds, 1e-9), TEXT("placements/s"), true);
+					AddMetric(Prefix + TEXT(".MsPerTile"), Seconds * 1000.0 / Iterations, TEXT("ms"), false);
+					AddMetric(Prefix + TEXT(".AllocationsPerTile"), double(AllocationCount) / Iterations, TEXT("allocations"), false);
+					AddMetric(Prefix + TEXT(".InstancesPerTile"), double(PlacementCount) / Iterations, TEXT("instances"), true);
+				}
+			}
+		}
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+}
+
+void UBenchmarkProceduralTilesCommandlet::AddMetric(const FString& Name, double Value, const TCHAR* Unit, bool bHigherIsBetter)
+{
+	FProceduralBenchmarkMetric& Metric = Metrics.AddDefaulted_GetRef();
+	Metric.Name = Name;
+	Metric.Value = Value;
+	Metric.Unit = Unit;
+	Metric.bHigherIsBetter = bHigherIsBetter;
+}
+
+bool UBenchmarkProceduralTilesCommandlet::WriteReport(const FString& Path) const
+{
+	FString Report;
+	if (FPaths::GetExtension(Path).Equals(TEXT("json"), ESearchCase::IgnoreCase)) {
+		TArray<TSharedPtr<FJsonValue>> MetricValues;
+		for (const FProceduralBenchmarkMetric& Metric : Metrics) {
+			TSharedRef<FJsonObject> MetricObject = MakeShared<FJsonObject>();
+			MetricObject->SetStringField(TEXT("Name"), Metric.Name);
+			MetricObject->SetNumberField(TEXT("Value"), Metric.Value);
+			MetricObject->SetStringField(TEXT("Unit"), Metric.Unit);
+			MetricObject->SetBoolField(TEXT("HigherIsBetter"), Metric.bHigherIsBetter);
+			MetricValues.Add(MakeShared<FJsonValueObject>(MetricObject));
+		}
+		TSharedRef<FJsonObject> ReportObject = MakeShared<FJsonObject>();
+		ReportObject->SetArrayField(TEXT("Metrics"), MetricValues);
+		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Report);
+		if (!FJsonSerializer::Serialize(ReportObject, Writer)) return false;
+	}
+	else {
+		Report = TEXT("Metric,Value,Unit,HigherIsBetter\n");
+		for (const FProceduralBenchmarkMetric& Metric : Metrics) {
+			Report += FString::Printf(TEXT("%s,%.6f,%s,%d\n"), *Metric.Name, Metric.Value, *Metric.Unit, Metric.bHigherIsBetter ? 1 : 0);
+		}
+	}
+	return FFileHelper::SaveStringToFile(Report, *Path);
+}
+
+bool UBenchmarkProceduralTilesCommandlet::ReadReport(const FString& Path, TMap<FString, FProceduralBenchmarkMetric>& Metrics_Out)
+{
+	FString Report;
+	if (!FFileHelper::LoadFileToString(Report, *Path)) return false;
+
+	if (FPaths::GetExtension(Path).Equals(TEXT("json"), ESearchCase::IgnoreCase)) {
+		TSharedPtr<FJsonObject> ReportObject;
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Report), ReportObject) || !ReportObject.IsValid()) return false;
+		const TArray<TSharedPtr<FJsonValue>>* MetricValues;
+		if (!ReportObject->TryGetArrayField(TEXT("Metrics"), MetricValues)) return false;
+		for (const TSharedPtr<FJsonValue>& MetricValue : *MetricValues) {
+			const TSharedPtr<FJsonObject>* MetricObject;
+			if (!MetricValue->TryGetObject(MetricObject)) continue;
+			FProceduralBenchmarkMetric Metric;
+			Metric.Name = (*MetricObject)->GetStringField(TEXT("Name"));
+			Metric.Value = (*MetricObject)->GetNumberField(TEXT("Value"));
+			Metric.Unit = (*MetricObject)->GetStringField(TEXT("Unit"));
+			Metric.bHigherIsBetter = (*MetricObject)->GetBoolField(TEXT("HigherIsBetter"));
+			Metrics_Out.Add(Metric.Name, Metric);
+		}
+		return true;
+	}
+
+	TArray<FString> Lines;
+	Report.ParseIntoArrayLines(Lines);
+	//The first line holds the column names
+	for (int i = 1; i < Lines.Num(); ++i) {
+		TArray<FString> Columns;
+		Lines[i].ParseIntoArray(Columns, TEXT(","), false);
+		if (Columns.Num() < 4) continue;
+		FProceduralBenchmarkMetric Metric;
+		Metric.Name = Columns[0];
+		Metric.Value = FCString::Atod(*Columns[1]);
+		Metric.Unit = Columns[2];
+		Metric.bHigherIsBetter = FCString::Atoi(*Columns[3]) != 0;
+		Metrics_Out.Add(Metric.Name, Metric);
+	}
+	return true;
+}
+
+int UBenchmarkProceduralTilesCommandlet::CompareAgainstBaseline(const TMap<FString, FProceduralBenchmarkMetric>& Baseline, double Tolerance) const
+{
+	int RegressionCount = 0;
+	for (const FProceduralBenchmarkMetric& Metric : Metrics) {
+		const FProceduralBenchmarkMetric* BaselineMetric = Baseline.Find(Metric.Name);
+		if (!BaselineMetric) continue;
+		bool bIsRegression = Metric.bHigherIsBetter
+			? Metric.Value < BaselineMetric->Value * (1.0 - Tolerance)
+			: Metric.Value > BaselineMetric->Value * (1.0 + Tolerance);
+		if (!bIsRegression) continue;
+		++RegressionCount;
+		UE_LOG(LogProceduralLandscape, Error, TEXT("BenchmarkProceduralTiles: %s regressed from %.3f to %.3f %s"), *Metric.Name, BaselineMetric->Value, Metric.Value, *Metric.Unit);
+	}
+	return RegressionCount;
+}
+
+TArray<int> UBenchmarkProceduralTilesCommandlet::ParseIntList(const FString& Params, const TCHAR* Name, TArray<int> DefaultValues)
+{
+	FString Value;
+	if (!FParse::Value(*Params, Name, Value, false)) return DefaultValues;
+	TArray<FString> Entries;
+	Value.ParseIntoArray(Entries, TEXT(","));
+	TArray<int> Values;
+	for (const FString& Entry : Entries) {
+		if (Entry.TrimStartAndEnd().IsNumeric()) Values.Add(FCString::Atoi(*Entry.TrimStartAndEnd()));
+	}
+	return Values.Num() > 0 ? Values : DefaultValues;
+}
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "BenchmarkProceduralTilesCommandlet.generated.h"
+
+/**
+ * Result of a single benchmark measurement.
+ */
+struct FProceduralBenchmarkMetric
+{
+	//Unique name of the measurement, e.g. Tile.R64.MsPerTile
+	FString Name;
+
+	double Value = 0.0;
+
+	FString Unit;
+
+	//Is a larger value an improvement (throughput) or a regression (time, allocations)
+	bool bHigherIsBetter = false;
+};
+
+/**
+ * Measures the throughput and the allocations of the noise, the tile mesh generation and the foliage placement.
+ *
+ * Usage: -run=BenchmarkProceduralTiles [-Generator=<class>] [-Iterations=N] [-Output=<file.csv|file.json>] [-Baseline=<file.csv|file.json>] [-Tolerance=0.1]
+ *                                      [-SpawnCounts=50,200,800,5000] [-MaxTries=10,100] -nullrhi
+ *
+ * -Generator the class whose defaults provide the noise and foliage configuration, ATileGenerator if it is not set
+ * -Iterations number of measured generations per tile resolution and foliage configuration
+ * -Output the report, written as JSON if the extension is .json and as CSV otherwise. Defaults to Saved/Benchmarks
+ * -Baseline a previous report, every metric that got worse by more than the tolerance is reported and the commandlet fails
+ * -Tolerance allowed relative regression against the baseline
+ * -SpawnCounts, -MaxTries the foliage configurations to measure, every combination is measured. Trees and bushes are measured
+ *                        with the random and the poisson-disk placement
+ */
+UCLASS()
+class PROCEDURALLANDSCAPE_API UBenchmarkProceduralTilesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBenchmarkProceduralTilesCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	//All measurements of the current run
+	TArray<FProceduralBenchmarkMetric> Metrics;
+
+	/**
+	 * Measures the evaluations per second of the noise kernel and the samples per second of the fractal noise.
+	 *
+	 * \param Iterations the number of measured tiles worth of samples
+	 */
+	void BenchmarkNoise(int Iterations);
+
+	/**
+	 * Evaluates the fractal noise for Iterations tiles worth of rows.
+	 *
+	 * \param FractalParams the parameters of the fractal
+	 * \param Iterations the number of measured tiles worth of samples
+	 * \param YPositions the Y positions of a row
+	 * \param ZOffsets receives the samples of a row, same size as YPositions
+	 * \param Checksum accumulates samples so the evaluation is not optimized away
+	 * \return the elapsed seconds
+	 */
+	static double TimeFractalNoise(const struct FTileFractalParams& FractalParams, int Iterations, const TArray<double>& YPositions, TArray<float>& ZOffsets, float& Checksum);
+
+	/**
+	 * Measures the time and allocations of the mesh generation for all power of two resolutions from 2 to 256.
+	 *
+	 * \param Generator the generator that provides the noise configuration
+	 * \param Iterations the number of measured generations per resolution
+	 */
+	void BenchmarkTiles(const class ATileGenerator* Generator, int Iterations);
+
+	/**
+	 * Measures the placements per second and allocations of the foliage generation on a tile in a transient world.
+	 *
+	 * \param Generator the generator that provides the foliage configuration
+	 * \param Iterations the number of measured generations per configuration
+	 * \param SpawnCounts the SpawnCount values to measure
+	 * \param MaxTries the MaxTries values to measure
+	 */
+	void BenchmarkFoliage(const class ATileGenerator* Generator, int Iterations, const TArray<int>& SpawnCounts, const TArray<int>& MaxTries);
+
+	void AddMetric(const FString& Name, double Value, const TCHAR* Unit, bool bHigherIsBetter);
+
+	/**
+	 * Writes all metrics to a CSV or JSON file.
+	 *
+	 * \param Path the file to write, the format is chosen by the extension
+	 * \return true if the file was written
+	 */
+	bool WriteReport(const FString& Path) const;
+
+	/**
+	 * Reads the metrics of a previous report.
+	 *
+	 * \param Path the file to read, the format is chosen by the extension
+	 * \param Metrics_Out receives the metrics by name
+	 * \return true if the file could be read
+	 */
+	static bool ReadReport(const FString& Path, TMap<FString, FProceduralBenchmarkMetric>& Metrics_Out);
+
+	/**
+	 * Compares the metrics against a baseline and logs every regression.
+	 *
+	 * \param Baseline the metrics of a previous report by name
+	 * \param Tolerance the allowed relative regression
+	 * \return the number of regressions
+	 */
+	int CompareAgainstBaseline(const TMap<FString, FProceduralBenchmarkMetric>& Baseline, double Tolerance) const;
+
+	/**
+	 * Parses a comma separated list of integers.
+	 */
+	static TArray<int> ParseIntList(const FString& Params, const TCHAR* Name, TArray<int> DefaultValues);
+};
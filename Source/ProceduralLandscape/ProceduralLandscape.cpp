@@ -4,3 +4,34 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ProceduralLandscape, "ProceduralLandscape" );
+
+DEFINE_LOG_CATEGORY(LogProceduralLandscape);
+
+CSV_DEFINE_CATEGORY_MODULE(PROCEDURALLANDSCAPE_API, ProceduralLandscape, true);
+
+DEFINE_STAT(STAT_ProceduralLandscape_UpdateTiles);
+DEFINE_STAT(STAT_ProceduralLandscape_UpdateQuadtree);
+DEFINE_STAT(STAT_ProceduralLandscape_PrefetchTiles);
+DEFINE_STAT(STAT_ProceduralLandscape_RunScheduledWork);
+DEFINE_STAT(STAT_ProceduralLandscape_SpawnTile);
+DEFINE_STAT(STAT_ProceduralLandscape_FinishPendingTiles);
+DEFINE_STAT(STAT_ProceduralLandscape_BuildMeshData);
+DEFINE_STAT(STAT_ProceduralLandscape_ApplyMeshData);
+DEFINE_STAT(STAT_ProceduralLandscape_StartFoliageGeneration);
+DEFINE_STAT(STAT_ProceduralLandscape_UpdateFoliageJobs);
+DEFINE_STAT(STAT_ProceduralLandscape_GenerateFoliage);
+DEFINE_STAT(STAT_ProceduralLandscape_SpawnNewFoliage);
+DEFINE_STAT(STAT_ProceduralLandscape_UpdateFoliage);
+DEFINE_STAT(STAT_ProceduralLandscape_DeleteSingleTile);
+
+DEFINE_STAT(STAT_ProceduralLandscape_Tiles);
+DEFINE_STAT(STAT_ProceduralLandscape_TilesPendingMesh);
+DEFINE_STAT(STAT_ProceduralLandscape_TilesToGenerate);
+DEFINE_STAT(STAT_ProceduralLandscape_TilesToDelete);
+DEFINE_STAT(STAT_ProceduralLandscape_PooledTiles);
+DEFINE_STAT(STAT_ProceduralLandscape_FoliageJobsPending);
+DEFINE_STAT(STAT_ProceduralLandscape_FoliageJobsRunning);
+DEFINE_STAT(STAT_ProceduralLandscape_FoliageComponentsToUpdate);
+
+DEFINE_STAT(STAT_ProceduralLandscape_FoliageInstancesSpawned);
+DEFINE_STAT(STAT_ProceduralLandscape_FoliageInstances);
@@ -3,4 +3,56 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogProceduralLandscape, Log, All);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(PROCEDURALLANDSCAPE_API, ProceduralLandscape);
+
+DECLARE_STATS_GROUP(TEXT("ProceduralLandscape"), STATGROUP_ProceduralLandscape, STATCAT_Advanced);
+
+//Stages of the streaming pipeline
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Tiles"), STAT_ProceduralLandscape_UpdateTiles, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Quadtree"), STAT_ProceduralLandscape_UpdateQuadtree, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Prefetch Tiles"), STAT_ProceduralLandscape_PrefetchTiles, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Run Scheduled Work"), STAT_ProceduralLandscape_RunScheduledWork, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn Tile"), STAT_ProceduralLandscape_SpawnTile, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Finish Pending Tiles"), STAT_ProceduralLandscape_FinishPendingTiles, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build Mesh Data"), STAT_ProceduralLandscape_BuildMeshData, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Apply Mesh Data"), STAT_ProceduralLandscape_ApplyMeshData, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Start Foliage Generation"), STAT_ProceduralLandscape_StartFoliageGeneration, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Foliage Jobs"), STAT_ProceduralLandscape_UpdateFoliageJobs, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Foliage"), STAT_ProceduralLandscape_GenerateFoliage, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn New Foliage"), STAT_ProceduralLandscape_SpawnNewFoliage, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Foliage"), STAT_ProceduralLandscape_UpdateFoliage, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Delete Single Tile"), STAT_ProceduralLandscape_DeleteSingleTile, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+
+//Queue depths, set once per frame by the tile generator
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Tiles"), STAT_ProceduralLandscape_Tiles, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Tiles Pending Mesh"), STAT_ProceduralLandscape_TilesPendingMesh, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Tiles To Generate"), STAT_ProceduralLandscape_TilesToGenerate, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Tiles To Delete"), STAT_ProceduralLandscape_TilesToDelete, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pooled Tiles"), STAT_ProceduralLandscape_PooledTiles, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Foliage Jobs Pending"), STAT_ProceduralLandscape_FoliageJobsPending, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Foliage Jobs Running"), STAT_ProceduralLandscape_FoliageJobsRunning, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Foliage Components To Update"), STAT_ProceduralLandscape_FoliageComponentsToUpdate, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+
+//Foliage instances
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Foliage Instances Spawned"), STAT_ProceduralLandscape_FoliageInstancesSpawned, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Foliage Instances"), STAT_ProceduralLandscape_FoliageInstances, STATGROUP_ProceduralLandscape, PROCEDURALLANDSCAPE_API);
+
+/**
+ * Measures the enclosing scope with a cycle counter of STATGROUP_ProceduralLandscape and a CSV profiler timing stat.
+ * Cycle counters already emit Unreal Insights events, builds without stats get a plain trace scope instead.
+ */
+#if STATS
+#define PROCEDURAL_LANDSCAPE_SCOPE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_ProceduralLandscape_##Name); \
+	CSV_SCOPED_TIMING_STAT(ProceduralLandscape, Name)
+#else
+#define PROCEDURAL_LANDSCAPE_SCOPE(Name) \
+	TRACE_CPUPROFILER_EVENT_SCOPE(ProceduralLandscape_##Name); \
+	CSV_SCOPED_TIMING_STAT(ProceduralLandscape, Name)
+#endif
@@ -3,3 +3,23 @@
 
 #include "FoliageDataAsset.h"
 
+#include "Curves/CurveFloat.h"
+
+FFoliageDescriptor UFoliageDataAsset::MakeDescriptor() const
+{
+	FFoliageDescriptor Descriptor;
+	Descriptor.Radius = Radius;
+	Descriptor.bIsTree = bIsTree;
+	if (GrowthCurve) {
+		Descriptor.GrowthCurve = MakeShared<TFunction<float(float)>, ESPMode::ThreadSafe>([FloatCurve = GrowthCurve->FloatCurve](float Value) {
+			return FloatCurve.Eval(Value);
+		});
+	}
+	Descriptor.bUniformScale = bUniformScale;
+	Descriptor.ScaleUniform = ScaleUniform;
+	Descriptor.ScaleRandomDeviationUniform = ScaleRandomDiviationUniform;
+	Descriptor.Scale = Scale;
+	Descriptor.ScaleRandomDeviation = ScaleRandomDiviation;
+	Descriptor.MaxSlope = MaxSlope;
+	return Descriptor;
+}
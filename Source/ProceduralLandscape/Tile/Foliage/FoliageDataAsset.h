@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Engine/DataAsset.h"
+#include "FoliagePlacement.h"
 #include "FoliageDataAsset.generated.h"
 
 /**
@@ -51,4 +52,16 @@ public:
 	UPROPERTY(EditAnywhere, meta = (EditCondition = "!bUniformScale"))
 	FVector ScaleRandomDiviation;
 
+	//Steepest slope of the ground in degrees this foliage type grows on, 90 allows any slope
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0", ClampMax = "90"))
+	float MaxSlope = 90.f;
+
+	/**
+	 * Copies the settings into a plain descriptor that can be used on any thread.
+	 * The growth curve is copied as well, so the descriptor does not reference this asset.
+	 *
+	 * \return the descriptor of this foliage type
+	 */
+	FFoliageDescriptor MakeDescriptor() const;
+
 };
@@ -3,12 +3,12 @@
 
 #include "FoliageGenerationComponent.h"
 
+#include "../../ProceduralLandscape.h"
 #include "FoliageDataAsset.h"
+#include "../TileDiskCache.h"
 
 #include "Components/HierarchicalInstancedStaticMeshComponent.h"
 
-#define COLLISION_GROUND ECC_GameTraceChannel1
-
 // Sets default values for this component's properties
 UFoliageGenerationComponent::UFoliageGenerationComponent()
 {
@@ -16,7 +16,7 @@ UFoliageGenerationComponent::UFoliageGenerationComponent()
 	
 }
 
-void UFoliageGenerationComponent::SetupFoliageGeneration(FTileIndex TileIndex_In, TArray<class UFoliageDataAsset*> FoliageData_In, int SpawnCount_In, int MaxTries_In, int BatchSize_In, int RandomSeed_In, bool bAffectsLight, bool bUseCulling, float CullDistance, bool bCollisionEnabled)
+void UFoliageGenerationComponent::SetupFoliageGeneration(FTileIndex TileIndex_In, TArray<class UFoliageDataAsset*> FoliageData_In, int SpawnCount_In, int MaxTries_In, int BatchSize_In, int RandomSeed_In, bool bAffectsLight, bool bUseCulling, float CullDistance, bool bCollisionEnabled, FTileDiskCachePtr DiskCache_In, EFoliagePlacementType PlacementType_In)
 {
 	TileIndex = TileIndex_In;
 	FoliageData = FoliageData_In;
@@ -24,12 +24,33 @@ void UFoliageGenerationComponent::SetupFoliageGeneration(FTileIndex TileIndex_In
 	MaxTries = MaxTries_In;
 	BatchSize = BatchSize_In;
 	RandomSeed = RandomSeed_In;
+	PlacementType = PlacementType_In;
+	DiskCache = DiskCache_In;
+	bIsGenerationFinished = false;
+	Lock.Lock();
+	InstancesToSpawn.Empty();
+	Lock.Unlock();
+	if (DiskCache.IsValid()) CacheRecordName = MakeCacheRecordName(GetName(), FoliageData, SpawnCount, MaxTries, RandomSeed, PlacementType);
+
+	//Components of a recycled tile keep their HISM components, they are cleared and reused in the same order
+	TArray<UHierarchicalInstancedStaticMeshComponent*> ExistingHISMComponents = MoveTemp(HISMComponents);
+	HISMComponents.Reset();
+	FoliageDescriptors.Reset();
 	for (UFoliageDataAsset* FoliageDatum : FoliageData) {
 		if (!FoliageDatum || !FoliageDatum->FoliageMesh) continue;
+		FoliageDescriptors.Add(FoliageDatum->MakeDescriptor());
+		if (ExistingHISMComponents.IsValidIndex(HISMComponents.Num())) {
+			UHierarchicalInstancedStaticMeshComponent* ExistingHISMComponent = ExistingHISMComponents[HISMComponents.Num()];
+			DEC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstances, ExistingHISMComponent->GetInstanceCount());
+			ExistingHISMComponent->ClearInstances();
+			ExistingHISMComponent->SetStaticMesh(FoliageDatum->FoliageMesh);
+			HISMComponents.Add(ExistingHISMComponent);
+			continue;
+		}
 		FString CurrentComponentName = FString::Printf(TEXT("HISMComponent_%s"), *FoliageDatum->FoliageMesh->GetName());
-		UHierarchicalInstancedStaticMeshComponent* CurrentHISMComponent = NewObject<UHierarchicalInstancedStaticMeshComponent>(this, UHierarchicalInstancedStaticMeshComponent::StaticClass(), FName(CurrentComponentName));
-		CurrentHISMComponent->SetWorldLocation(FVector(0, 0, 0));
-		CurrentHISMComponent->AttachToComponent(this, FAttachmentTransformRules::KeepWorldTransform);
+		UHierarchicalInstancedStaticMeshComponent* CurrentHISMComponent = NewObject<UHierarchicalInstancedStaticMeshComponent>(this, UHierarchicalInstancedStaticMeshComponent::StaticClass(), MakeUniqueObjectName(this, UHierarchicalInstancedStaticMeshComponent::StaticClass(), FName(CurrentComponentName)));
+		//Instances are placed relative to the tile center, so the components move with a recycled or rebased tile
+		CurrentHISMComponent->AttachToComponent(this, FAttachmentTransformRules::SnapToTargetIncludingScale);
 		CurrentHISMComponent->SetStaticMesh(FoliageDatum->FoliageMesh); 
 		if (!bAffectsLight) {
 			CurrentHISMComponent->bAffectDynamicIndirectLighting = false;
@@ -46,11 +67,27 @@ void UFoliageGenerationComponent::SetupFoliageGeneration(FTileIndex TileIndex_In
 		CurrentHISMComponent->RegisterComponent();
 		HISMComponents.Add(CurrentHISMComponent);
 	}
+	for (int i = HISMComponents.Num(); i < ExistingHISMComponents.Num(); ++i) {
+		DEC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstances, ExistingHISMComponents[i]->GetInstanceCount());
+		ExistingHISMComponents[i]->DestroyComponent();
+	}
 }
 
-void UFoliageGenerationComponent::GenerateFoliage(TArray<FGeneratedFoliageInfo>& FoliageInfos, bool bSpawnDirect, int TileSize, float TraceZStart, float TraceZEnd, bool bDrawDebug)
+void UFoliageGenerationComponent::OnComponentDestroyed(bool bDestroyingHierarchy)
 {
-	Lock.Lock();
+	for (UHierarchicalInstancedStaticMeshComponent* HISMComponent : HISMComponents) {
+		if (!HISMComponent) continue;
+		DEC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstances, HISMComponent->GetInstanceCount());
+		HISMComponent->DestroyComponent();
+	}
+	HISMComponents.Empty();
+	Super::OnComponentDestroyed(bDestroyingHierarchy);
+}
+
+void UFoliageGenerationComponent::GenerateFoliage(TArray<FGeneratedFoliageInfo>& FoliageInfos, bool bSpawnDirect, int TileSize, TFunctionRef<const FTileHeightfield&()> GetHeightfield, bool bDrawDebug)
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(GenerateFoliage);
+	FScopeLock ScopeLock(&Lock);
 	InstancesToSpawn.Empty();
 
 	for (UHierarchicalInstancedStaticMeshComponent* HISMComponent : HISMComponents) {
@@ -59,87 +96,119 @@ void UFoliageGenerationComponent::GenerateFoliage(TArray<FGeneratedFoliageInfo>&
 
 
 	if (HISMComponents.Num() == 0) return;
-	FRandomStream RandomStream((TileIndex.X * 10000 + TileIndex.Y) * RandomSeed + RandomSeed);
-	TArray<FTileBounds> TileBounds = InitializeBounds(TileSize);
-	int Count = 0;
-	int Tries = 0;
-
-	while (Count < SpawnCount && Tries < MaxTries) {
-		int HISMComponentIndex;
-		FVector Location;
-		GenerateRandomInstance(TileBounds, RandomStream, TraceZStart, TraceZEnd, HISMComponentIndex, Location);
-
-		float Distance;
-		float ClosestRadius;
-		UCurveFloat* GrowthCurve = nullptr;
-		bool bDoesOverlap = DoesOverlap(Location, FoliageInfos, FoliageData[HISMComponentIndex]->Radius, Distance, ClosestRadius, GrowthCurve);
-
-		float GrowthFactor = 1;
-		if (bDoesOverlap && GrowthCurve) {
-			float NormalizedDistance = Distance / ClosestRadius;
-			GrowthFactor = GrowthCurve->GetFloatValue(NormalizedDistance);
-		}		
-
-		if (bDoesOverlap && (!GrowthCurve || FoliageData[HISMComponentIndex]->bIsTree)) {
-			Tries += 1;
+	if (!bSpawnDirect && LoadCachedFoliage(FoliageInfos)) return;
+
+	TArray<FFoliageInstance> Instances;
+	PlaceFoliage(MakePlacementParams(TileIndex, TileSize, SpawnCount, MaxTries, RandomSeed, PlacementType), FoliageDescriptors, GetHeightfield(), FoliageInfos, Instances);
+
+	for (const FFoliageInstance& Instance : Instances) {
+		int HISMComponentIndex = Instance.DescriptorIndex;
+		if (bDrawDebug) {
+			UWorld* World = GetWorld();
+			FVector TileCenter = FVector(TileIndex.GetCenter(TileSize), 0) - FVector(World->OriginLocation);
+			float HalfHeight = HISMComponents[HISMComponentIndex]->GetStaticMesh()->GetBounds().GetSphere().W / 2;
+			FVector Location = TileCenter + Instance.Transform.GetLocation();
+			DrawDebugCylinder(World, Location, Location + FVector::UpVector * HalfHeight * 2, FoliageDescriptors[HISMComponentIndex].Radius, 8, FColor::Red, false, 10, 0, 2);
+		}
+		if (bSpawnDirect) {
+			HISMComponents[HISMComponentIndex]->AddInstance(Instance.Transform);
+			INC_DWORD_STAT(STAT_ProceduralLandscape_FoliageInstancesSpawned);
+			INC_DWORD_STAT(STAT_ProceduralLandscape_FoliageInstances);
 		}
 		else {
-			FTransform Transform;
-			float HalfHeight = FoliageData[HISMComponentIndex]->FoliageMesh->GetBounds().GetSphere().W / 2;
-			FVector Scale;
-			if (FoliageData[HISMComponentIndex]->bUniformScale) {
-				float Rand = RandomStream.FRandRange(-FoliageData[HISMComponentIndex]->ScaleRandomDiviationUniform, FoliageData[HISMComponentIndex]->ScaleRandomDiviationUniform);
-				Scale = FVector(FoliageData[HISMComponentIndex]->ScaleUniform + Rand);
-			}
-			else {
-				float ScaleX = RandomStream.FRandRange(FoliageData[HISMComponentIndex]->Scale.X - FoliageData[HISMComponentIndex]->ScaleRandomDiviation.X, FoliageData[HISMComponentIndex]->Scale.X + FoliageData[HISMComponentIndex]->ScaleRandomDiviation.X);
-				float ScaleY = RandomStream.FRandRange(FoliageData[HISMComponentIndex]->Scale.Y - FoliageData[HISMComponentIndex]->ScaleRandomDiviation.Y, FoliageData[HISMComponentIndex]->Scale.Y + FoliageData[HISMComponentIndex]->ScaleRandomDiviation.Y);
-				float ScaleZ = RandomStream.FRandRange(FoliageData[HISMComponentIndex]->Scale.Z - FoliageData[HISMComponentIndex]->ScaleRandomDiviation.Z, FoliageData[HISMComponentIndex]->Scale.Z + FoliageData[HISMComponentIndex]->ScaleRandomDiviation.Z);
-				Scale = FVector(ScaleX, ScaleY, ScaleZ);
-			}
-			
-			Transform.MultiplyScale3D(Scale * GrowthFactor);
-			Transform.SetLocation(Location);
-			FRotator Rotation;
-			Rotation.Yaw = RandomStream.FRandRange(-180, 180);
-			Transform.SetRotation(Rotation.Quaternion());
-			if (bDrawDebug) DrawDebugCylinder(GetWorld(), Transform.GetLocation(), Transform.GetLocation() + Transform.Rotator().Vector().UpVector * HalfHeight * 2, FoliageData[HISMComponentIndex]->Radius, 8, FColor::Red, false, 10, 0, 2);
+			InstancesToSpawn[HISMComponentIndex].Add(Instance.Transform);
+		}
+	}
+	if (!bSpawnDirect && DiskCache.IsValid()) DiskCache->SaveFoliage(TileIndex, CacheRecordName, InstancesToSpawn);
+}
+
+FString UFoliageGenerationComponent::MakeCacheRecordName(const FString& ComponentName, const TArray<UFoliageDataAsset*>& FoliageData, int SpawnCount, int MaxTries, int RandomSeed, EFoliagePlacementType PlacementType)
+{
+	uint32 Hash = HashCombine(GetTypeHash(SpawnCount), HashCombine(GetTypeHash(MaxTries), GetTypeHash(RandomSeed)));
+	Hash = HashCombine(Hash, GetTypeHash(PlacementType));
+	for (UFoliageDataAsset* FoliageDatum : FoliageData) {
+		if (!FoliageDatum) continue;
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->GetPathName()));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->FoliageMesh ? FoliageDatum->FoliageMesh->GetPathName() : FString()));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->GrowthCurve ? FoliageDatum->GrowthCurve->GetPathName() : FString()));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->Radius));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->bIsTree));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->bUniformScale));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->ScaleUniform));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->ScaleRandomDiviationUniform));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->Scale));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->ScaleRandomDiviation));
+		Hash = HashCombine(Hash, GetTypeHash(FoliageDatum->MaxSlope));
+	}
+	return FString::Printf(TEXT("%s_%08x"), *ComponentName, Hash);
+}
+
+FFoliagePlacementParams UFoliageGenerationComponent::MakePlacementParams(FTileIndex TileIndex, int TileSize, int SpawnCount, int MaxTries, int RandomSeed, EFoliagePlacementType PlacementType)
+{
+	FFoliagePlacementParams PlacementParams;
+	PlacementParams.Mode = PlacementType == EFoliagePlacementType::PoissonDisk ? EFoliagePlacementMode::PoissonDisk : EFoliagePlacementMode::Random;
+	PlacementParams.TileSize = TileSize;
+	PlacementParams.SpawnCount = SpawnCount;
+	PlacementParams.MaxTries = MaxTries;
+	PlacementParams.Seed = int32((TileIndex.X * 10000 + TileIndex.Y) * RandomSeed + RandomSeed);
+	return PlacementParams;
+}
+
+void UFoliageGenerationComponent::PlaceFoliage(const FFoliagePlacementParams& PlacementParams, const TArray<FFoliageDescriptor>& FoliageDescriptors, const FTileHeightfield& Heightfield, TArray<FGeneratedFoliageInfo>& FoliageInfos, TArray<FFoliageInstance>& Instances_Out)
+{
+	//The placement and the heightfield both work relative to the tile center, so the ground is a plain lookup on any thread
+	bool bHasGround = Heightfield.Heights.Num() > 0;
+	auto SampleGround = [&Heightfield, bHasGround](float XPos, float YPos, float& Z_Out, FVector& Normal_Out) {
+		if (!bHasGround) return false;
+		//Slightly below the surface, so the instances do not float above the triangles of the mesh
+		Z_Out = FTileTerrain::SampleHeight(Heightfield, XPos, YPos, &Normal_Out) - 1;
+		return true;
+	};
+	FFoliagePlacement::PlaceFoliage(PlacementParams, FoliageDescriptors, SampleGround, FoliageInfos, Instances_Out);
+}
+
+void UFoliageGenerationComponent::AddFoliageInfos(const TArray<FTransformArrayA2>& Instances, const TArray<FFoliageDescriptor>& FoliageDescriptors, TArray<FGeneratedFoliageInfo>& FoliageInfos)
+{
+	for (int i = 0; i < Instances.Num(); ++i) {
+		for (const FTransform& Transform : Instances[i]) {
 			FGeneratedFoliageInfo GeneratedFoliageInfo;
-			GeneratedFoliageInfo.Location = Location;
-			GeneratedFoliageInfo.Radius = FoliageData[HISMComponentIndex]->Radius;
-			GeneratedFoliageInfo.GrowthCurve = FoliageData[HISMComponentIndex]->GrowthCurve;
-			GeneratedFoliageInfo.bIsTree = FoliageData[HISMComponentIndex]->bIsTree;
+			GeneratedFoliageInfo.Location = Transform.GetLocation();
+			GeneratedFoliageInfo.Radius = FoliageDescriptors[i].Radius;
+			GeneratedFoliageInfo.GrowthCurve = FoliageDescriptors[i].GrowthCurve;
+			GeneratedFoliageInfo.bIsTree = FoliageDescriptors[i].bIsTree;
 			FoliageInfos.Add(GeneratedFoliageInfo);
-			
-			if (bSpawnDirect) {
-				HISMComponents[HISMComponentIndex]->AddInstance(Transform);
-			}
-			else {
-				InstancesToSpawn[HISMComponentIndex].Add(Transform);
-			}
-
-			Tries = 0;
-			Count += 1;
 		}
 	}
-	Lock.Unlock();
+}
+
+bool UFoliageGenerationComponent::LoadCachedFoliage(TArray<FGeneratedFoliageInfo>& FoliageInfos)
+{
+	if (!DiskCache.IsValid() || !DiskCache->LoadFoliage(TileIndex, CacheRecordName, InstancesToSpawn)) return false;
+
+	//Later components of the tile avoid the loaded instances, just like they avoid freshly generated ones
+	AddFoliageInfos(InstancesToSpawn, FoliageDescriptors, FoliageInfos);
+	return true;
 }
 
 void UFoliageGenerationComponent::ClearFoliage()
 {
 	for (UHierarchicalInstancedStaticMeshComponent* HISMComponent : HISMComponents) {
+		DEC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstances, HISMComponent->GetInstanceCount());
 		HISMComponent->ClearInstances();
 	}
 }
 
 bool UFoliageGenerationComponent::UpdateFoliage()
 {
+	PROCEDURAL_LANDSCAPE_SCOPE(UpdateFoliage);
 	bool bSuccess = true;
 	if (Lock.TryLock()) {
 		for (int i = 0; i < InstancesToSpawn.Num(); ++i) {
 			if (InstancesToSpawn[i].Num() > 0) {
 				if (InstancesToSpawn[i].Num() <= BatchSize) {
 					HISMComponents[i]->AddInstances(InstancesToSpawn[i], false, true);
+					INC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstancesSpawned, InstancesToSpawn[i].Num());
+					INC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstances, InstancesToSpawn[i].Num());
 					InstancesToSpawn[i].Empty();
 				}
 				else {
@@ -149,6 +218,8 @@ bool UFoliageGenerationComponent::UpdateFoliage()
 						InstancesToSpawn[i].RemoveAt(0);
 					}
 					HISMComponents[i]->AddInstances(CurrentBatch, false, true);
+					INC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstancesSpawned, CurrentBatch.Num());
+					INC_DWORD_STAT_BY(STAT_ProceduralLandscape_FoliageInstances, CurrentBatch.Num());
 					bSuccess = false;
 				}
 			}
@@ -161,60 +232,3 @@ bool UFoliageGenerationComponent::UpdateFoliage()
 	bIsGenerationFinished = bSuccess;
 	return bSuccess;
 }
-
-bool UFoliageGenerationComponent::DoesOverlap(FVector NewLocation, TArray<FGeneratedFoliageInfo> FoliageInfos, float CurrentFoliageRadius, float& Distance, float& ClosestRadius, UCurveFloat*& GrowthCurve)
-{
-	bool bDoesOverlap = false;
-	float CurrentDistance;
-	Distance = TNumericLimits<float>::Max();
-	for (FGeneratedFoliageInfo& CurrentFoliageInfo : FoliageInfos) {
-		CurrentDistance = FMath::Abs(FVector::Dist(CurrentFoliageInfo.Location, NewLocation));
-		if (CurrentDistance < FMath::Max(CurrentFoliageRadius, CurrentFoliageInfo.Radius)) {
-			bDoesOverlap = true;
-			if (CurrentDistance < Distance && CurrentFoliageInfo.bIsTree) {
-				Distance = CurrentDistance;
-				ClosestRadius = CurrentFoliageInfo.Radius;
-				GrowthCurve = CurrentFoliageInfo.GrowthCurve;
-			}
-		}
-	}
-	return bDoesOverlap;
-}
-
-TArray<FTileBounds> UFoliageGenerationComponent::InitializeBounds(int TileSize)
-{
-	TArray<FTileBounds> TileBounds;
-
-	for (UFoliageDataAsset* FoliageDatum : FoliageData) {
-		FTileBounds NewEntry;
-		NewEntry.XMin = TileIndex.X * TileSize - TileSize / 2 + FoliageDatum->Radius / 2;
-		NewEntry.XMax = TileIndex.X * TileSize + TileSize / 2 - FoliageDatum->Radius / 2;
-		NewEntry.YMin = TileIndex.Y * TileSize - TileSize / 2 + FoliageDatum->Radius / 2;
-		NewEntry.YMax = TileIndex.Y * TileSize + TileSize / 2 - FoliageDatum->Radius / 2;
-
-		TileBounds.Add(NewEntry);
-	}
-
-	return TileBounds;
-}
-
-void UFoliageGenerationComponent::GenerateRandomInstance(TArray<FTileBounds> TileBounds, FRandomStream& RandomStream, float TraceZStart, float TraceZEnd, int& HISMComponentIndex, FVector& Location)
-{
-	HISMComponentIndex = RandomStream.RandRange(0, HISMComponents.Num() - 1);
-	UHierarchicalInstancedStaticMeshComponent* HISMComponent = HISMComponents[HISMComponentIndex];
-	FTileBounds CurrentBounds = TileBounds[HISMComponentIndex];
-
-	float XPos = RandomStream.FRandRange(CurrentBounds.XMin, CurrentBounds.XMax);
-	float YPos = RandomStream.FRandRange(CurrentBounds.YMin, CurrentBounds.YMax);
-	Location = FVector(XPos, YPos, 0);
-	FHitResult HitResult;
-	FVector Start(XPos, YPos, TraceZStart);
-	FVector End(XPos, YPos, TraceZEnd);
-	if (GetWorld()->LineTraceSingleByChannel(HitResult, Start, End, COLLISION_GROUND)) {
-		HitResult.Location.Z -= 1;
-		Location = HitResult.Location;
-	}
-}
-
-
-
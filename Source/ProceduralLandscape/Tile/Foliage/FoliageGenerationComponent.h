@@ -5,20 +5,17 @@
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
 #include "../ProceduralTile.h"
+#include "FoliagePlacement.h"
 #include "FoliageGenerationComponent.generated.h"
 
-struct FTileBounds {
-	float XMin;
-	float XMax;
-	float YMin;
-	float YMax;
-};
+UENUM()
+enum class EFoliagePlacementType : uint8
+{
+	//Random locations on the whole tile, stops after MaxTries consecutive rejected locations
+	Random,
 
-struct FGeneratedFoliageInfo {
-	FVector Location;
-	UCurveFloat* GrowthCurve;
-	float Radius;
-	bool bIsTree;
+	//Poisson-disk sampling around the placed instances, fills the tile evenly, MaxTries is the number of candidates per instance
+	PoissonDisk
 };
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
@@ -31,7 +28,7 @@ public:
 	UFoliageGenerationComponent();
 
 	/**
-	 * Sets up the membervariables and creates the HISMComponents
+	 * Sets up the membervariables and creates the HISMComponents, existing HISMComponents are cleared and reused
 	 *
 	 * \param TileIndex_In the index of the tile with which this component is associated
 	 * \param FoliageData_In The relevant data for the different foliage types
@@ -43,20 +40,25 @@ public:
 	 * \param bUseCulling If culling should be applied to the HISM components
 	 * \param CullDistance the end point distance for culling
 	 * \param bCollisionEnabled If collision should be applied to the foliage instances
+	 * \param DiskCache_In cache to load the generated transforms from and to store them in, can be null
+	 * \param PlacementType_In how the locations of the instances are chosen
 	 */
-	void SetupFoliageGeneration(FTileIndex TileIndex_In, TArray<class UFoliageDataAsset*> FoliageData_In, int SpawnCount_In, int MaxTries_In, int BatchSize_In, int RandomSeed_In, bool bAffectsLight, bool bUseCulling, float CullDistance, bool bCollisionEnabled);
+	void SetupFoliageGeneration(FTileIndex TileIndex_In, TArray<class UFoliageDataAsset*> FoliageData_In, int SpawnCount_In, int MaxTries_In, int BatchSize_In, int RandomSeed_In, bool bAffectsLight, bool bUseCulling, float CullDistance, bool bCollisionEnabled, FTileDiskCachePtr DiskCache_In = nullptr, EFoliagePlacementType PlacementType_In = EFoliagePlacementType::Random);
+
+	virtual void OnComponentDestroyed(bool bDestroyingHierarchy) override;
 
 	/**
-	 * Generates randomly placed foliage locations or spawns them directly
+	 * Generates randomly placed foliage locations or spawns them directly.
+	 * The ground is sampled from the heightfield of the tile, so the generation does not touch the world unless bDrawDebug is set
 	 *
 	 * \param ExistingFoliageInfos Information about existing foliage on this tile
 	 * \param bSpawnDirect If the instance should be spawned directly
 	 * \param TileSize the size of a tile
-	 * \param TraceZStart the z value where the line trace to find the ground should start
-	 * \param TraceZEnd the z value where the line trace  to find the ground should start
+	 * \param GetHeightfield returns the heights of the tile at full resolution, regardless of the LOD ring the mesh of the tile is in.
+	 * It is only called if the foliage is not loaded from the cache
 	 * \param bDrawDebug if the radius of the foliage instance should be visualized
 	 */
-	void GenerateFoliage(TArray<FGeneratedFoliageInfo>& ExistingFoliageInfos, bool bSpawnDirect, int TileSize, float TraceZStart, float TraceZEnd, bool bDrawDebug = false);
+	void GenerateFoliage(TArray<FGeneratedFoliageInfo>& ExistingFoliageInfos, bool bSpawnDirect, int TileSize, TFunctionRef<const FTileHeightfield&()> GetHeightfield, bool bDrawDebug = false);
 
 	/**
 	 * Removes all instances of all HISM components.
@@ -71,6 +73,51 @@ public:
 	 */
 	bool UpdateFoliage();
 
+	/**
+	 * Builds the name of the cache record of a foliage generation component, the foliage can be baked without spawning a component.
+	 *
+	 * \param ComponentName the name of the component, see AProceduralTile::TreeGenerationComponentName
+	 * \param FoliageData the foliage types of the component
+	 * \param SpawnCount the max amount of foliage to be spawned
+	 * \param MaxTries the max number of tries to generate a new location
+	 * \param RandomSeed the random seed of the landscape
+	 * \param PlacementType how the locations of the instances are chosen
+	 * \return the name of the record, contains a hash of all settings that change the generated transforms
+	 */
+	static FString MakeCacheRecordName(const FString& ComponentName, const TArray<class UFoliageDataAsset*>& FoliageData, int SpawnCount, int MaxTries, int RandomSeed, EFoliagePlacementType PlacementType);
+
+	/**
+	 * Builds the placement parameters of a foliage generation component.
+	 *
+	 * \param TileIndex the index of the tile, the random stream of the placement is seeded with it
+	 * \param TileSize the size of a tile
+	 * \param SpawnCount the max amount of foliage to be spawned
+	 * \param MaxTries the max number of tries to generate a new location
+	 * \param RandomSeed the random seed of the landscape
+	 * \param PlacementType how the locations of the instances are chosen
+	 */
+	static FFoliagePlacementParams MakePlacementParams(FTileIndex TileIndex, int TileSize, int SpawnCount, int MaxTries, int RandomSeed, EFoliagePlacementType PlacementType);
+
+	/**
+	 * Places foliage on the ground of a tile, does not touch any object and can run on any thread.
+	 *
+	 * \param PlacementParams the parameters of the placement, see MakePlacementParams
+	 * \param FoliageDescriptors the foliage types that are placed
+	 * \param Heightfield the heights of the tile at full resolution, nothing is placed if it is empty
+	 * \param FoliageInfos information about existing foliage on this tile, receives the placed instances
+	 * \param Instances_Out receives the placed instances
+	 */
+	static void PlaceFoliage(const FFoliagePlacementParams& PlacementParams, const TArray<FFoliageDescriptor>& FoliageDescriptors, const FTileHeightfield& Heightfield, TArray<FGeneratedFoliageInfo>& FoliageInfos, TArray<FFoliageInstance>& Instances_Out);
+
+	/**
+	 * Adds instances that were loaded from the cache to the existing foliage, so later components avoid them.
+	 *
+	 * \param Instances the transforms per foliage type
+	 * \param FoliageDescriptors the foliage types, aligned with Instances
+	 * \param FoliageInfos information about existing foliage on this tile
+	 */
+	static void AddFoliageInfos(const TArray<FTransformArrayA2>& Instances, const TArray<FFoliageDescriptor>& FoliageDescriptors, TArray<FGeneratedFoliageInfo>& FoliageInfos);
+
 	bool GetIsGenerationFinished() {
 		return bIsGenerationFinished;
 	}
@@ -104,9 +151,16 @@ private:
 	UPROPERTY()
 	int RandomSeed;
 
+	//How the locations of the instances are chosen
+	UPROPERTY()
+	EFoliagePlacementType PlacementType = EFoliagePlacementType::Random;
+
 	//Information about all foliage types to use
 	UPROPERTY()
 	TArray<UFoliageDataAsset*> FoliageData; 
+
+	//Plain copies of the foliage types that have a mesh, aligned with HISMComponents
+	TArray<FFoliageDescriptor> FoliageDescriptors;
 	
 	//The lock to regulate access to the InstancesToSpawn array
 	FCriticalSection Lock;
@@ -119,38 +173,19 @@ private:
 
 	//If all foliage was already spawned
 	bool bIsGenerationFinished = false;
-	
-	/**
-	 * Checks if NewLocation overlaps with any location in GeneratedLocations
-	 *
-	 * \param NewLocation The new location to check if it is valid
-	 * \param FoliageInfos The already existing foliage instances
-	 * \param Distance the distance to the closest instance 
-	 * \param ClosestRadius the radius of the closest instance
-	 * \param GrowthCurve the GrowthCurve of the clostest instance
-	 * \return true if the locations is inside the Radius of an existing tree, false otherwise
-	 */
-	virtual bool DoesOverlap(FVector NewLocation, TArray<FGeneratedFoliageInfo> FoliageInfos, float CurrentFoliageRadius, float& Distance, float& ClosestRadius, UCurveFloat*& GrowthCurve);
 
-	/**
-	 * Initializes the landscape bounds for each HISM component.
-	 *
-	 * \param TileIndex the current tile index
-	 * \param TileSize the size of the tile
-	 * \return TArray with the bounds for each HISM component
-	 */
-	TArray<FTileBounds> InitializeBounds(int TileSize);
+	//Cache of previously generated transforms
+	FTileDiskCachePtr DiskCache;
+
+	//Name of the cache record, contains a hash of all settings that change the generated transforms
+	FString CacheRecordName;
 
 	/**
-	 * Generates a random location for a random HISM Component for a new instace.
+	 * Tries to fill InstancesToSpawn from the cache and adds the loaded instances to FoliageInfos, InstancesToSpawn has to be locked.
 	 *
-	 * \param TileBounds Bounds for all hism components concerning the current tile
-	 * \param RandomStream the random stream previously created
-	 * \param TraceZStart start of the trace to determine Z location
-	 * \param TraceZEnd end of the trace to determine Z location
-	 * \param HISMComponentIndex the inds of the HISM component for which the location was generated
-	 * \param Location the generated location
+	 * \param FoliageInfos information about existing foliage on this tile
+	 * \return true if the transforms were loaded
 	 */
-	void GenerateRandomInstance(TArray<FTileBounds> TileBounds, FRandomStream& RandomStream, float TraceZStart, float TraceZEnd, int& HISMComponentIndex, FVector& Location);
-		
+	bool LoadCachedFoliage(TArray<FGeneratedFoliageInfo>& FoliageInfos);
+
 };
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FoliageGenerationJob.h"
+
+#include "FoliageGenerationComponent.h"
+#include "../ProceduralTile.h"
+
+#include "Async/Async.h"
+
+FFoliageGenerationJob::FFoliageGenerationJob(AProceduralTile* Tile_In, FTileIndex TileIndex_In, TArray<UFoliageGenerationComponent*> FoliageGenerationComponents_In, int TileSize_In, FTerrainTileParams GroundParams_In, FTileHeightfieldPtr Heightfield_In)
+{
+	Tile = Tile_In;
+	FoliageGenerationComponents = FoliageGenerationComponents_In;
+	TileIndex = TileIndex_In;
+	TileSize = TileSize_In;
+	GroundParams = GroundParams_In;
+	Heightfield = Heightfield_In;
+}
+
+void FFoliageGenerationJob::Start()
+{
+	check(!Task.IsValid());
+	//The components are not touched by the game thread until the task is finished, the tile is only deleted afterwards
+	Task = Async(EAsyncExecution::ThreadPool, [FoliageGenerationComponents = FoliageGenerationComponents, TileSize = TileSize, GroundParams = GroundParams, Heightfield = Heightfield]() {
+		//Tiles in coarser LOD rings only have a few heights, their ground is generated at full resolution here.
+		//It is only generated once the first component misses the cache, cached foliage does not evaluate any noise
+		FTileHeightfield GeneratedHeightfield;
+		auto GetGround = [&Heightfield, &GroundParams, &GeneratedHeightfield]() -> const FTileHeightfield& {
+			if (Heightfield.IsValid()) return *Heightfield;
+			if (GeneratedHeightfield.Heights.Num() == 0) FTileTerrain::GenerateHeightfield(GroundParams, GeneratedHeightfield);
+			return GeneratedHeightfield;
+		};
+		TArray<FGeneratedFoliageInfo> FoliageInfos;
+		for (UFoliageGenerationComponent* FoliageGenerationComponent : FoliageGenerationComponents) {
+			FoliageGenerationComponent->GenerateFoliage(FoliageInfos, false, TileSize, GetGround);
+		}
+	});
+}
+
+void FFoliageGenerationJob::Wait()
+{
+	if (Task.IsValid()) Task.Wait();
+}
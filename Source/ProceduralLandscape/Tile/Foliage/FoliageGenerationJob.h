@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "../ProceduralTile.h"
+#include "FoliageGenerationComponent.h"
+
+#include "Async/Future.h"
+
+/**
+ * Generates the foliage of all components of a tile on the shared thread pool.
+ * The components run one after another on the same worker, so every component avoids the foliage of the components before it.
+ * Jobs of different tiles are independent and run in parallel.
+ */
+class PROCEDURALLANDSCAPE_API FFoliageGenerationJob
+{
+public:
+	/**
+	 * \param Tile_In the tile that owns the components
+	 * \param TileIndex_In the index of the tile
+	 * \param FoliageGenerationComponents_In the components in the order they are generated, already set up
+	 * \param TileSize_In the size of a tile
+	 * \param GroundParams_In the parameters of the tile at full resolution
+	 * \param Heightfield_In the heights of the tile at full resolution, see AProceduralTile::GetGroundHeightfield. If null the job generates them from GroundParams_In
+	 */
+	FFoliageGenerationJob(AProceduralTile* Tile_In, FTileIndex TileIndex_In, TArray<UFoliageGenerationComponent*> FoliageGenerationComponents_In, int TileSize_In, FTerrainTileParams GroundParams_In, FTileHeightfieldPtr Heightfield_In);
+
+	/**
+	 * Queues the generation on the thread pool, must be called once.
+	 */
+	void Start();
+
+	/**
+	 * Blocks until a started job is finished.
+	 */
+	void Wait();
+
+	bool IsStarted() {
+		return Task.IsValid();
+	}
+
+	/**
+	 * Checks if a started job is finished, the result of the components can be spawned afterwards.
+	 *
+	 * \return true if the job was started and is finished
+	 */
+	bool IsFinished() {
+		return Task.IsValid() && Task.IsReady();
+	}
+
+	AProceduralTile* GetTile() {
+		return Tile;
+	}
+
+	const TArray<UFoliageGenerationComponent*>& GetFoliageGenerationComponents() {
+		return FoliageGenerationComponents;
+	}
+
+	FTileIndex GetTileIndex() {
+		return TileIndex;
+	}
+
+	/**
+	 * Flags a job whose tile was removed, a queued job is deleted instead of being started and the result of a started job is dropped.
+	 */
+	void Cancel() {
+		bIsCancelled = true;
+	}
+
+	bool IsCancelled() {
+		return bIsCancelled;
+	}
+
+private:
+	//Tile that owns the components
+	AProceduralTile* Tile;
+
+	//Components that are generated, in this order
+	TArray<UFoliageGenerationComponent*> FoliageGenerationComponents;
+
+	//Index of the tile to generate foliage for
+	FTileIndex TileIndex;
+
+	//The size of the tile
+	int TileSize;
+
+	//Parameters to generate the ground at full resolution from
+	FTerrainTileParams GroundParams;
+
+	//Heights of the tile the foliage is placed on, null if they are generated by the job
+	FTileHeightfieldPtr Heightfield;
+
+	//Task on the thread pool, invalid until the job is started
+	TFuture<void> Task;
+
+	//Was the tile of this job removed
+	bool bIsCancelled = false;
+};
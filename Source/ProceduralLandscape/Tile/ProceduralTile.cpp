@@ -3,14 +3,23 @@
 
 #include "ProceduralTile.h"
 
+#include "../ProceduralLandscape.h"
 #include "ProceduralMeshComponent.h"
+#include "TileDiskCache.h"
 #include "TileGenerator.h"
+#include "TileIndexBufferCache.h"
+#include "TileMeshBufferPool.h"
 
+#include "Async/Async.h"
 #include "Components/BoxComponent.h"
 #include "GameFramework/Character.h"
 
 #define COLLISION_GROUND ECC_GameTraceChannel1
 
+const TCHAR* const AProceduralTile::TreeGenerationComponentName = TEXT("TreeGenerationComponent");
+const TCHAR* const AProceduralTile::GrassGenerationComponentName = TEXT("GrassGenerationComponent");
+const TCHAR* const AProceduralTile::BushGenerationComponentName = TEXT("BushGenerationComponent");
+
 AProceduralTile::AProceduralTile()
 {
 	ProceduralMeshComponent = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("PorceduralMeshComponent"));
@@ -18,12 +27,15 @@ AProceduralTile::AProceduralTile()
 	ProceduralMeshComponent->bAffectDistanceFieldLighting = true;
 	ProceduralMeshComponent->bAffectDynamicIndirectLighting = true;
 	ProceduralMeshComponent->SetCollisionResponseToChannel(COLLISION_GROUND, ECollisionResponse::ECR_Block);
+	ProceduralMeshComponent->bUseComplexAsSimpleCollision = true;
+	ProceduralMeshComponent->bUseAsyncCooking = true;
 	SetRootComponent(ProceduralMeshComponent);
-	ProceduralMeshComponent->SetMobility(EComponentMobility::Static);
+	//Pooled tiles are moved to the index they are recycled for, static components would refuse the move
+	ProceduralMeshComponent->SetMobility(EComponentMobility::Movable);
 
 	BoxComponent = CreateDefaultSubobject<UBoxComponent>(TEXT("BoxComponent"));
 	BoxComponent->SetupAttachment(RootComponent);
-	BoxComponent->SetMobility(EComponentMobility::Static);
+	BoxComponent->SetMobility(EComponentMobility::Movable);
 }
 
 
@@ -32,8 +44,11 @@ void AProceduralTile::Setup(ATileGenerator* Tilegenerator_In, TSubclassOf<AChara
 {	
 	TileGenerator = Tilegenerator_In;
 	PlayerClass = PlayerClass_In.Get();
+	bMarkedToDelete = false;
+	SetActorEnableCollision(true);
 	if (ProceduralMeshComponent) ProceduralMeshComponent->SetMaterial(0, Material);
-	if(BoxComponent) BoxComponent->OnComponentBeginOverlap.AddDynamic(this, &AProceduralTile::OnBeginOverlap);
+	//Setup is called again for recycled tiles
+	if(BoxComponent) BoxComponent->OnComponentBeginOverlap.AddUniqueDynamic(this, &AProceduralTile::OnBeginOverlap);
 	SetupFoliageComponents(bGenerateTrees, bGenerateGrass, bGenerateBushes);
 }
 
@@ -41,181 +56,268 @@ void AProceduralTile::Setup(ATileGenerator* Tilegenerator_In, TSubclassOf<AChara
 void AProceduralTile::OnBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
 	if (OtherActor->IsA(PlayerClass.Get())) {
-		UE_LOG(LogTemp, Warning, TEXT("Overlap"));
+		UE_LOG(LogProceduralLandscape, Verbose, TEXT("Player entered tile %lld,%lld"), TileIndex.X, TileIndex.Y);
 		if (TileGenerator)
 		{
 			TileGenerator->UpdateTiles(TileIndex);
 		}
-		else UE_LOG(LogTemp, Warning, TEXT("No TileGenerator"));
+		else UE_LOG(LogProceduralLandscape, Warning, TEXT("Tile %lld,%lld has no TileGenerator"), TileIndex.X, TileIndex.Y);
 	}
 }
 
-void AProceduralTile::GenerateTile(FTileGenerationParams TileGenerationParams, bool bIsUpdate) {
-	TArray<FVector> Vertices;
-	TArray<int32> Triangles;
-	TArray<FVector> Normals;
-	TArray<FVector2D> UV0;
-	TArray<FColor> VertexColor;
+void AProceduralTile::GenerateTile(FTileGenerationParams TileGenerationParams, bool bIsUpdate, FTileMeshBufferPoolPtr MeshBufferPool, FTileDiskCachePtr DiskCache) {
+	DiscardPendingMeshGeneration();
+	FTileMeshDataPtr MeshData = AcquireMeshData(MeshBufferPool, TileGenerationParams.TileResolution);
+
+	TileIndex = TileGenerationParams.TileIndex;
+	bIsUpdate = PrepareMeshLayout(TileGenerationParams, bIsUpdate);
+	BuildMeshData(TileGenerationParams, bIsUpdate, *MeshData, DiskCache);
+	ApplyMeshData(*MeshData, bIsUpdate);
+	if (MeshBufferPool.IsValid()) MeshBufferPool->Release(MeshData);
+}
 
+void AProceduralTile::GenerateTileAsync(FTileGenerationParams TileGenerationParams, bool bIsUpdate, FTileMeshBufferPoolPtr MeshBufferPool, FTileDiskCachePtr DiskCache)
+{
+	//A previous task can not be cancelled, its result is simply dropped
+	DiscardPendingMeshGeneration();
 	TileIndex = TileGenerationParams.TileIndex;
-	if (bIsUpdate) SetupParamsUpdate(TileGenerationParams, Vertices, Normals, UV0, VertexColor);
-	else SetupParamsCreation(TileGenerationParams, Vertices, Triangles, Normals, UV0, VertexColor);
+	if (!bIsUpdate) SetActorHiddenInGame(true);
+	bIsUpdate = PrepareMeshLayout(TileGenerationParams, bIsUpdate);
+	bIsPendingUpdate = bIsUpdate;
+
+	FTileMeshDataPtr MeshData = AcquireMeshData(MeshBufferPool, TileGenerationParams.TileResolution);
+	PendingMeshData = MeshData;
+	PendingMeshBufferPool = MeshBufferPool;
+	MeshGenerationTask = Async(EAsyncExecution::ThreadPool, [TileGenerationParams, bIsUpdate, MeshData, DiskCache]() {
+		BuildMeshData(TileGenerationParams, bIsUpdate, *MeshData, DiskCache);
+	});
+}
+
+bool AProceduralTile::TryFinishMeshGeneration()
+{
+	ReleaseAbandonedMeshData();
+	if (!MeshGenerationTask.IsValid()) return true;
+	if (!MeshGenerationTask.IsReady()) return false;
+
+	MeshGenerationTask.Reset();
+	ApplyMeshData(*PendingMeshData, bIsPendingUpdate);
+	if (PendingMeshBufferPool.IsValid()) PendingMeshBufferPool->Release(PendingMeshData);
+	PendingMeshData.Reset();
+	PendingMeshBufferPool.Reset();
+	return true;
+}
+
+void AProceduralTile::DiscardPendingMeshGeneration()
+{
+	if (MeshGenerationTask.IsValid() && PendingMeshBufferPool.IsValid()) {
+		FAbandonedMeshGeneration& AbandonedMeshGeneration = AbandonedMeshGenerations.AddDefaulted_GetRef();
+		AbandonedMeshGeneration.Task = MoveTemp(MeshGenerationTask);
+		AbandonedMeshGeneration.MeshData = PendingMeshData;
+		AbandonedMeshGeneration.MeshBufferPool = PendingMeshBufferPool;
+	}
+	MeshGenerationTask.Reset();
+	PendingMeshData.Reset();
+	PendingMeshBufferPool.Reset();
+	ReleaseAbandonedMeshData();
+}
+
+void AProceduralTile::ReleaseAbandonedMeshData()
+{
+	AbandonedMeshGenerations.RemoveAllSwap([](FAbandonedMeshGeneration& AbandonedMeshGeneration) {
+		if (!AbandonedMeshGeneration.Task.IsReady()) return false;
+		AbandonedMeshGeneration.MeshBufferPool->Release(AbandonedMeshGeneration.MeshData);
+		return true;
+	});
+}
+
+bool AProceduralTile::PrepareMeshLayout(FTileGenerationParams TileGenerationParams, bool bIsUpdate)
+{
+	//UpdateMeshSection requires the same vertex count, a new resolution (e.g. a new LOD ring) recreates the section.
+	//The vertex count also tells grids with and without skirts apart, so the index buffer of the section matches as well
+	int VertexCount = TileGenerationParams.TileResolution * TileGenerationParams.TileResolution;
+	if (TileGenerationParams.bGenerateSkirts) VertexCount += FTileIndexBufferCache::GetPerimeterCount(TileGenerationParams.TileResolution);
+	FProcMeshSection* Section = ProceduralMeshComponent ? ProceduralMeshComponent->GetProcMeshSection(0) : nullptr;
+	bool bCanUpdate = bIsUpdate && Section && Section->ProcVertexBuffer.Num() == VertexCount;
+	MeshResolution = TileGenerationParams.TileResolution;
+	LODScale = TileGenerationParams.LODScale;
+	return bCanUpdate;
+}
+
+FTileMeshDataPtr AProceduralTile::AcquireMeshData(FTileMeshBufferPoolPtr MeshBufferPool, int TileResolution)
+{
+	if (MeshBufferPool.IsValid()) return MeshBufferPool->Acquire(TileResolution);
+	return MakeShared<FTileMeshData, ESPMode::ThreadSafe>();
+}
+
+void AProceduralTile::ApplyMeshData(FTileMeshData& MeshData, bool bIsUpdate)
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(ApplyMeshData);
+	ApplyHeightfieldBounds(MeshData.Heightfield, MeshData.TileSize);
 
 	if (ProceduralMeshComponent) {
 		if (bIsUpdate) {
-			ProceduralMeshComponent->UpdateMeshSection(0, Vertices, Normals, UV0, VertexColor, TArray<FProcMeshTangent>());
-			ProceduralMeshComponent->AddCollisionConvexMesh(Vertices);
+			ProceduralMeshComponent->UpdateMeshSection(0, MeshData.Vertices, MeshData.Normals, MeshData.UV0, MeshData.VertexColor, TArray<FProcMeshTangent>());
+			//UpdateMeshSection does not recook the triangle mesh, clearing the (unused) convex elements rebuilds the collision from the section
+			if (bHasMeshCollision) ProceduralMeshComponent->ClearCollisionConvexMeshes();
 		}
 		else {
-			ProceduralMeshComponent->CreateMeshSection(0, Vertices, Triangles, Normals, UV0, VertexColor, TArray<FProcMeshTangent>(), true);
-			ProceduralMeshComponent->AddCollisionConvexMesh(Vertices);
+			ProceduralMeshComponent->CreateMeshSection(0, MeshData.Vertices, *MeshData.Triangles, MeshData.Normals, MeshData.UV0, MeshData.VertexColor, TArray<FProcMeshTangent>(), bHasMeshCollision);
 		}
 	}
+	//Swapping hands the previous heights of this tile back to the buffer, so neither side has to allocate
+	Swap(Heightfield, MeshData.Heightfield);
+	GroundHeightfield.Reset();
+	SetActorHiddenInGame(false);
 }
 
-void AProceduralTile::SetupFoliageComponents(bool bGenerateTrees, bool bGenerateGrass, bool bGenerateBushes)
+void AProceduralTile::BuildMeshData(FTileGenerationParams TileGenerationParams, bool bIsUpdate, FTileMeshData& MeshData, FTileDiskCachePtr DiskCache)
 {
-	if (bGenerateTrees) {
-		TreeGenerationComponent = NewObject<UFoliageGenerationComponent>(this, TEXT("TreeGenerationComponent"));
-		TreeGenerationComponent->SetMobility(EComponentMobility::Static);
-		TreeGenerationComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
-	}
-	if (bGenerateGrass) {
-		GrassGenerationComponent = NewObject<UFoliageGenerationComponent>(this, TEXT("GrassGenerationComponent"));
-		GrassGenerationComponent->SetMobility(EComponentMobility::Static);
-		GrassGenerationComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
-	}
-	if (bGenerateBushes) {
-		BushGenerationComponent = NewObject<UFoliageGenerationComponent>(this, TEXT("BushGenerationComponent"));
-		BushGenerationComponent->SetMobility(EComponentMobility::Static);
-		BushGenerationComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
+	PROCEDURAL_LANDSCAPE_SCOPE(BuildMeshData);
+	int VertexCount = TileGenerationParams.TileResolution * TileGenerationParams.TileResolution;
+	if (TileGenerationParams.bGenerateSkirts) VertexCount += FTileIndexBufferCache::GetPerimeterCount(TileGenerationParams.TileResolution);
+	MeshData.TileSize = TileGenerationParams.TileSize * TileGenerationParams.LODScale;
+	MeshData.Vertices.SetNumUninitialized(VertexCount, false);
+	MeshData.Normals.SetNumUninitialized(VertexCount, false);
+	MeshData.UV0.SetNumUninitialized(VertexCount, false);
+	MeshData.VertexColor.SetNumUninitialized(VertexCount, false);
+
+	//The grid normals are stored in front of the skirt normals, so a cached record is copied straight into the buffer
+	bool bIsCached = DiskCache.IsValid() && DiskCache->LoadHeightfield(TileGenerationParams, MeshData.Heightfield, MeshData.Normals.GetData());
+	if (!bIsCached) FTileTerrain::GenerateHeightfield(TileGenerationParams.GetTerrainTileParams(), MeshData.Heightfield);
+	if (bIsUpdate) SetupParamsUpdate(TileGenerationParams, MeshData, bIsCached);
+	else SetupParamsCreation(TileGenerationParams, MeshData, bIsCached);
+	if (DiskCache.IsValid() && !bIsCached) DiskCache->SaveHeightfield(TileGenerationParams, MeshData.Heightfield, MeshData.Normals.GetData());
+	if (TileGenerationParams.bGenerateSkirts) GenerateSkirtVertices(MeshData, TileGenerationParams);
+}
+
+void AProceduralTile::GenerateSkirtVertices(FTileMeshData& MeshData, FTileGenerationParams TileGenerationParams)
+{
+	int FirstSkirtVertex = TileGenerationParams.TileResolution * TileGenerationParams.TileResolution;
+	int PerimeterCount = FTileIndexBufferCache::GetPerimeterCount(TileGenerationParams.TileResolution);
+	for (int PerimeterIndex = 0; PerimeterIndex < PerimeterCount; ++PerimeterIndex) {
+		int BorderVertex = FTileIndexBufferCache::GetPerimeterVertex(TileGenerationParams.TileResolution, PerimeterIndex);
+		int SkirtVertex = FirstSkirtVertex + PerimeterIndex;
+		MeshData.Vertices[SkirtVertex] = MeshData.Vertices[BorderVertex] - FVector(0, 0, TileGenerationParams.SkirtDepth);
+		MeshData.Normals[SkirtVertex] = MeshData.Normals[BorderVertex];
+		MeshData.UV0[SkirtVertex] = MeshData.UV0[BorderVertex];
+		MeshData.VertexColor[SkirtVertex] = MeshData.VertexColor[BorderVertex];
 	}
 }
 
-void AProceduralTile::SetupParamsCreation(FTileGenerationParams TileGenerationParams, TArray<FVector>& Vertices, TArray<int32>& Triangles, TArray<FVector>& Normals, TArray<FVector2D>& UV0, TArray<FColor>& VertexColor) {
-	float StartOffset = float(TileGenerationParams.TileSize) / 2;
-	float DistanceBetweenVertices = float(TileGenerationParams.TileSize) / (TileGenerationParams.TileResolution - 1);
+void AProceduralTile::SetupFoliageComponents(bool bGenerateTrees, bool bGenerateGrass, bool bGenerateBushes)
+{
+	SetupFoliageComponent(TreeGenerationComponent, bGenerateTrees, TreeGenerationComponentName);
+	SetupFoliageComponent(GrassGenerationComponent, bGenerateGrass, GrassGenerationComponentName);
+	SetupFoliageComponent(BushGenerationComponent, bGenerateBushes, BushGenerationComponentName);
+}
 
-	float MaxZOffset = 0;
-	float MinZOffset = 0;
+void AProceduralTile::SetupFoliageComponent(UFoliageGenerationComponent*& FoliageGenerationComponent, bool bIsNeeded, const TCHAR* ComponentName)
+{
+	//Recycled tiles keep their components, they are only created once and removed if they are not needed anymore
+	if (!bIsNeeded) {
+		if (FoliageGenerationComponent) {
+			//The name is part of the cache record of the foliage, so it is freed for the next component of this tile.
+			//The destroyed component is not collected yet and would be replaced in place by a new object with the same name
+			FoliageGenerationComponent->DestroyComponent();
+			FoliageGenerationComponent->Rename(nullptr, GetTransientPackage(), REN_DontCreateRedirectors | REN_ForceNoResetLoaders);
+			FoliageGenerationComponent = nullptr;
+		}
+		return;
+	}
+	if (FoliageGenerationComponent) return;
+	FoliageGenerationComponent = NewObject<UFoliageGenerationComponent>(this, ComponentName);
+	FoliageGenerationComponent->SetMobility(EComponentMobility::Movable);
+	FoliageGenerationComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
+}
 
+void AProceduralTile::SetupParamsCreation(const FTileGenerationParams& TileGenerationParams, FTileMeshData& MeshData, bool bHasNormals) {
+	//Built once, the terrain params hold a shared pointer to the terrain program that must not be copied per vertex
+	FTerrainTileParams TerrainTileParams = TileGenerationParams.GetTerrainTileParams();
+	float HalfMeshSize = TerrainTileParams.GetMeshSize() / 2;
 	for (int Row = 0; Row < TileGenerationParams.TileResolution; ++Row) {
 		for (int Column = 0; Column < TileGenerationParams.TileResolution; ++Column) {
-			GenerateVertexInformation(Vertices, Normals, UV0, VertexColor, MinZOffset, MaxZOffset, TileGenerationParams, Row, Column, DistanceBetweenVertices);
-			if (Row < TileGenerationParams.TileResolution - 1 && Column < TileGenerationParams.TileResolution - 1) {
-				GenerateTriangles(Triangles, Row, Column, TileGenerationParams.TileResolution);
-			}
+			GenerateVertexInformation(MeshData, TerrainTileParams, HalfMeshSize, TileGenerationParams.TileResolution, Row, Column, bHasNormals);
 		}
 	}
-	float ZBoxExtent = (MaxZOffset - MinZOffset) / 2 + 10;
-	float XYBoxExtent = TileGenerationParams.TileSize / 2 - 10;
-	if (BoxComponent) BoxComponent->SetBoxExtent(FVector(XYBoxExtent, XYBoxExtent, ZBoxExtent));
-	MaxZPosition = MaxZOffset;
-	MinZPosition = MinZOffset;
+	MeshData.Triangles = FTileIndexBufferCache::Get(TileGenerationParams.TileResolution, TileGenerationParams.bGenerateSkirts);
 }
 
-void AProceduralTile::SetupParamsUpdate(FTileGenerationParams TileGenerationParams, TArray<FVector>& Vertices, TArray<FVector>& Normals, TArray<FVector2D>& UV0, TArray<FColor>& VertexColor) {
-	float StartOffset = float(TileGenerationParams.TileSize) / 2;
-	float DistanceBetweenVertices = float(TileGenerationParams.TileSize) / (TileGenerationParams.TileResolution - 1);
-
-	float MaxZOffset = 0;
-	float MinZOffset = 0;
-
+void AProceduralTile::SetupParamsUpdate(const FTileGenerationParams& TileGenerationParams, FTileMeshData& MeshData, bool bHasNormals) {
+	FTerrainTileParams TerrainTileParams = TileGenerationParams.GetTerrainTileParams();
+	float HalfMeshSize = TerrainTileParams.GetMeshSize() / 2;
 	for (int Row = 0; Row < TileGenerationParams.TileResolution; ++Row) {
 		for (int Column = 0; Column < TileGenerationParams.TileResolution; ++Column) {
-			GenerateVertexInformation(Vertices, Normals, UV0, VertexColor, MinZOffset, MaxZOffset, TileGenerationParams, Row, Column, DistanceBetweenVertices);
+			GenerateVertexInformation(MeshData, TerrainTileParams, HalfMeshSize, TileGenerationParams.TileResolution, Row, Column, bHasNormals);
 		}
 	}
-	float ZBoxExtent = (MaxZOffset - MinZOffset) / 2 + 10;
-	float XYBoxExtent = TileGenerationParams.TileSize / 2 - 10;
-	if (BoxComponent) BoxComponent->SetBoxExtent(FVector(XYBoxExtent, XYBoxExtent, ZBoxExtent));
-	MaxZPosition = MaxZOffset;
-	MinZPosition = MinZOffset;
 }
 
-void AProceduralTile::GenerateVertexInformation(TArray<FVector>& Vertices, TArray<FVector>& Normals, TArray<FVector2D>& UV0, TArray<FColor>& VertexColor, float& MinZOffset, float& MaxZOffset, FTileGenerationParams TileGenerationParams, int Row, int Column, float DistanceBetweenVertices)
+void AProceduralTile::GenerateVertexInformation(FTileMeshData& MeshData, const FTerrainTileParams& TerrainTileParams, float HalfMeshSize, int TileResolution, int Row, int Column, bool bHasNormals)
 {
-	float CurrentXOffset = float(TileGenerationParams.TileSize) / 2 - DistanceBetweenVertices * Row;
-	float CurrentYOffset = float(TileGenerationParams.TileSize) / 2 - DistanceBetweenVertices * Column;
-
-	float UPos = MapToUV(CurrentXOffset + TileGenerationParams.TileIndex.X * TileGenerationParams.TileSize, TileGenerationParams.TileSize);
-	float VPos = MapToUV(CurrentYOffset + TileGenerationParams.TileIndex.Y * TileGenerationParams.TileSize, TileGenerationParams.TileSize);
-
-	float MicroZOffset = GetZOffset(UPos, VPos, TileGenerationParams.MinorNoiseScale, TileGenerationParams.MinorNoiseOffset, TileGenerationParams.MinorNoiseStrength);
-	float LargeZOffset = GetZOffset(UPos, VPos, TileGenerationParams.MajorNoiseScale, TileGenerationParams.MajorNoiseOffset, TileGenerationParams.MajorNoiseStrength);
-	float CurrentZOffset = LargeZOffset + MicroZOffset;
+	const FTileHeightfield& Heightfield_In = MeshData.Heightfield;
+	float CurrentXOffset = HalfMeshSize - Heightfield_In.DistanceBetweenVertices * Row;
+	float CurrentYOffset = HalfMeshSize - Heightfield_In.DistanceBetweenVertices * Column;
 
-	if (CurrentZOffset < MinZOffset) MinZOffset = CurrentZOffset;
-	if (CurrentZOffset > MaxZOffset) MaxZOffset = CurrentZOffset;
-
-	FVector CurrentLocation(CurrentXOffset, CurrentYOffset, CurrentZOffset);
-	Vertices.Add(CurrentLocation);
-
-	Normals.Add(CalculateVertexNormal(CurrentXOffset + TileGenerationParams.TileIndex.X * TileGenerationParams.TileSize, CurrentYOffset + TileGenerationParams.TileIndex.Y * TileGenerationParams.TileSize, DistanceBetweenVertices, TileGenerationParams));
-	UV0.Add(FVector2D(UPos, VPos));
-	VertexColor.Add(FColor(CurrentZOffset, 1 - CurrentZOffset, MicroZOffset));
-}
+	float UPos = FTileTerrain::MapToUV(TerrainTileParams.TileX, TerrainTileParams.GetNoiseX(CurrentXOffset));
+	float VPos = FTileTerrain::MapToUV(TerrainTileParams.TileY, TerrainTileParams.GetNoiseY(CurrentYOffset));
 
+	float MicroZOffset = Heightfield_In.GetMinorHeight(Row, Column);
+	float CurrentZOffset = Heightfield_In.GetHeight(Row, Column);
 
-void AProceduralTile::GenerateTriangles(TArray<int32>& Triangles, int CurrentRow, int CurrentColumn, int TileResolution) {
-	int Current = (CurrentRow * TileResolution) + CurrentColumn;
-	int Right = Current + 1;
-	int Lower = Current + TileResolution;
-	int LowerRight = Lower + 1;
-	AddTriangle(Triangles, Right, LowerRight, Current);
-	AddTriangle(Triangles, Lower, Current, LowerRight);
+	int VertexIndex = Row * TileResolution + Column;
+	MeshData.Vertices[VertexIndex] = FVector(CurrentXOffset, CurrentYOffset, CurrentZOffset);
+	if (!bHasNormals) MeshData.Normals[VertexIndex] = FTileTerrain::CalculateVertexNormal(Heightfield_In, Row, Column);
+	MeshData.UV0[VertexIndex] = FVector2D(UPos, VPos);
+	MeshData.VertexColor[VertexIndex] = FColor(CurrentZOffset, 1 - CurrentZOffset, MicroZOffset);
 }
 
-void AProceduralTile::AddTriangle(TArray<int32>& Triangles, int32 V1, int32 V2, int32 V3) {
-	Triangles.Add(V1);
-	Triangles.Add(V2);
-	Triangles.Add(V3);
+void AProceduralTile::ApplyHeightfieldBounds(const FTileHeightfield& Heightfield_In, int TileSize)
+{
+	float ZBoxExtent = (Heightfield_In.MaxZ - Heightfield_In.MinZ) / 2 + 10;
+	float XYBoxExtent = TileSize / 2 - 10;
+	if (BoxComponent) BoxComponent->SetBoxExtent(FVector(XYBoxExtent, XYBoxExtent, ZBoxExtent));
+	MaxZPosition = Heightfield_In.MaxZ;
+	MinZPosition = Heightfield_In.MinZ;
 }
 
-FVector AProceduralTile::CalculateVertexNormal(float XPos, float YPos, float DistanceBetweenVertices, FTileGenerationParams TileGenerationParams) {
-	float Top = MapToUV(YPos + DistanceBetweenVertices, TileGenerationParams.TileSize);
-	float Bottom = MapToUV(YPos - DistanceBetweenVertices,  TileGenerationParams.TileSize);
-	float Right = MapToUV(XPos + DistanceBetweenVertices, TileGenerationParams.TileSize);
-	float Left = MapToUV(XPos - DistanceBetweenVertices, TileGenerationParams.TileSize);
-
-	float ZTopLeftMajor = GetZOffset(Left, Top, TileGenerationParams.MajorNoiseScale, TileGenerationParams.MajorNoiseOffset, TileGenerationParams.MajorNoiseStrength);
-	float ZTopLeftMinor = GetZOffset(Left, Top, TileGenerationParams.MinorNoiseScale, TileGenerationParams.MinorNoiseOffset, TileGenerationParams.MinorNoiseStrength);
-	float ZTopLeft = ZTopLeftMajor + ZTopLeftMinor;
-	
-	float ZTopRightMajor = GetZOffset(Right, Top, TileGenerationParams.MajorNoiseScale, TileGenerationParams.MajorNoiseOffset, TileGenerationParams.MajorNoiseStrength);
-	float ZTopRightMinor = GetZOffset(Right, Top, TileGenerationParams.MinorNoiseScale, TileGenerationParams.MinorNoiseOffset, TileGenerationParams.MinorNoiseStrength);
-	float ZTopRight = ZTopRightMajor + ZTopRightMinor;
-	
-	float ZBottomLeftMajor = GetZOffset(Left, Bottom, TileGenerationParams.MajorNoiseScale, TileGenerationParams.MajorNoiseOffset, TileGenerationParams.MajorNoiseStrength);
-	float ZBottomLeftMinor = GetZOffset(Left, Bottom, TileGenerationParams.MinorNoiseScale, TileGenerationParams.MinorNoiseOffset, TileGenerationParams.MinorNoiseStrength);
-	float ZBottomLeft = ZBottomLeftMajor + ZBottomLeftMinor;
-	
-	float ZBottomRightMajor = GetZOffset(Right, Bottom, TileGenerationParams.MajorNoiseScale, TileGenerationParams.MajorNoiseOffset, TileGenerationParams.MajorNoiseStrength);
-	float ZBottomRightMinor = GetZOffset(Right, Bottom, TileGenerationParams.MinorNoiseScale, TileGenerationParams.MinorNoiseOffset, TileGenerationParams.MinorNoiseStrength);
-	float ZBottomRight = ZBottomRightMajor + ZBottomRightMinor;
-
-	FVector TopLeftLocation(XPos - DistanceBetweenVertices, YPos + DistanceBetweenVertices, ZTopLeft);
-	FVector TopRightLocation(XPos + DistanceBetweenVertices, YPos + DistanceBetweenVertices, ZTopRight);
-	FVector BottomLeftLocation(XPos - DistanceBetweenVertices, YPos - DistanceBetweenVertices, ZBottomLeft);
-	FVector BottomRightLocation(XPos + DistanceBetweenVertices, YPos - DistanceBetweenVertices, ZBottomRight);
 
-
-	FVector Normal_01 = FVector::CrossProduct((BottomLeftLocation - TopLeftLocation), (TopRightLocation - TopLeftLocation));
-	FVector Normal_02 = FVector::CrossProduct((BottomRightLocation - BottomLeftLocation), (TopRightLocation - BottomLeftLocation));
-	return (Normal_02 + Normal_01 / 2).GetSafeNormal();
+void AProceduralTile::SetMeshCollisionEnabled(bool bEnabled)
+{
+	if (bHasMeshCollision == bEnabled) return;
+	bHasMeshCollision = bEnabled;
+	if (!ProceduralMeshComponent) return;
+
+	FProcMeshSection* Section = ProceduralMeshComponent->GetProcMeshSection(0);
+	if (Section && Section->ProcVertexBuffer.Num() > 0) {
+		Section->bEnableCollision = bEnabled;
+		ProceduralMeshComponent->SetProcMeshSection(0, *Section);
+	}
 }
 
-float AProceduralTile::GetZOffset(float XPos, float YPos, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength) {
-
-	float ScaledXPos = MapToRange(XPos, 0, 1, 0, NoiseScale.X);
-	float ScaledYPos = MapToRange(YPos, 0, 1, 0, NoiseScale.Y);
-
-	float ZOffset = FMath::PerlinNoise2D(FVector2D(ScaledXPos + NoiseOffset.X, ScaledYPos + NoiseOffset.Y)) * NoiseStrength;
-	return ZOffset;
+FTileHeightfieldPtr AProceduralTile::GetGroundHeightfield()
+{
+	//Heightfield is swapped with pooled buffers by the next upload, so the workers get their own copy of the heights
+	if (!GroundHeightfield.IsValid()) {
+		TSharedRef<FTileHeightfield, ESPMode::ThreadSafe> HeightfieldCopy = MakeShared<FTileHeightfield, ESPMode::ThreadSafe>();
+		HeightfieldCopy->SampleCount = Heightfield.SampleCount;
+		HeightfieldCopy->DistanceBetweenVertices = Heightfield.DistanceBetweenVertices;
+		HeightfieldCopy->Heights = Heightfield.Heights;
+		HeightfieldCopy->MaxZ = Heightfield.MaxZ;
+		HeightfieldCopy->MinZ = Heightfield.MinZ;
+		GroundHeightfield = HeightfieldCopy;
+	}
+	return GroundHeightfield;
 }
 
-float AProceduralTile::MapToUV(float Value, int TileSize) {
-	return (Value + (float(TileSize) / 2)) / TileSize;
+void AProceduralTile::Recycle()
+{
+	DiscardPendingMeshGeneration();
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	GroundHeightfield.Reset();
+	if (TreeGenerationComponent) TreeGenerationComponent->ClearFoliage();
+	if (GrassGenerationComponent) GrassGenerationComponent->ClearFoliage();
+	if (BushGenerationComponent) BushGenerationComponent->ClearFoliage();
 }
 
 bool AProceduralTile::IsGenerationFinished()
@@ -227,8 +329,3 @@ bool AProceduralTile::IsGenerationFinished()
 	if (BushGenerationComponent) bIsFinished &= BushGenerationComponent->GetIsGenerationFinished();
 	return bIsFinished;
 }
-
-float AProceduralTile::MapToRange(float Value, float MinPrev, float MaxPrev, float MinNew, float MaxNew) {
-	return MinNew + (Value - MinPrev) * (MaxNew - MinNew) / (MaxPrev - MinPrev);
-}
-
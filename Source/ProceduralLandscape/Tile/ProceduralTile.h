@@ -4,22 +4,29 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Async/Future.h"
+#include "TerrainProgram.h"
+#include "TileHeightfield.h"
+#include "TileMeshData.h"
 #include "ProceduralTile.generated.h"
 
+/**
+ * Index of a tile on the infinite grid. 64-bit, so the index never overflows however far the player travels.
+ */
 USTRUCT()
 struct FTileIndex
 {
 	GENERATED_BODY()
 
 	UPROPERTY(EditAnywhere)
-	int X;
+	int64 X;
 
 	UPROPERTY(EditAnywhere)
-	int Y;
+	int64 Y;
 
 	FTileIndex() : X(0), Y(0) {};
 
-	FTileIndex(int X, int Y) : X(X), Y(Y) {};
+	FTileIndex(int64 X, int64 Y) : X(X), Y(Y) {};
 
 	FTileIndex(const FTileIndex& Other) : FTileIndex(Other.X, Other.Y) {};
 
@@ -37,17 +44,43 @@ struct FTileIndex
 		return X == Other.X && Y == Other.Y;
 	}
 
+	/**
+	 * Location of the tile center in world space without origin rebasing, in double precision.
+	 *
+	 * \param TileSize the size of a tile
+	 */
+	FORCEINLINE FVector2D GetCenter(int TileSize) const
+	{
+		return FVector2D(double(X) * TileSize, double(Y) * TileSize);
+	}
+
+	/**
+	 * Index of the tile that contains a location in world space without origin rebasing.
+	 *
+	 * \param Location the location, in double precision
+	 * \param TileSize the size of a tile
+	 */
+	static FORCEINLINE FTileIndex FromLocation(const FVector& Location, int TileSize)
+	{
+		return FTileIndex(int64(FMath::FloorToDouble(Location.X / TileSize + 0.5)), int64(FMath::FloorToDouble(Location.Y / TileSize + 0.5)));
+	}
 };
 
-#if UE_BUILD_DEBUG
-uint32 GetTypeHash(const FTileIndex& Thing);
-#else // optimize by inlining in shipping and development builds
+//Mixes both coordinates instead of running a CRC over the raw bytes, the tile maps are hashed every tick
 FORCEINLINE uint32 GetTypeHash(const FTileIndex& Thing)
 {
-	uint32 Hash = FCrc::MemCrc32(&Thing, sizeof(FTileIndex));
-	return Hash;
+	return HashCombine(GetTypeHash(Thing.X), GetTypeHash(Thing.Y));
+}
+
+UENUM()
+enum class EDetailNoiseType : uint8
+{
+	//Sum of the octaves, rolling hills
+	Fbm,
+
+	//Inverted octaves, sharp ridges
+	Ridged
 };
-#endif
 
 USTRUCT()
 struct FTileGenerationParams
@@ -81,8 +114,106 @@ struct FTileGenerationParams
 	UPROPERTY()
 	float MinorNoiseStrength;
 
+	//Number of octaves of the detail noise, the detail noise is disabled if it is 0
+	UPROPERTY()
+	int DetailNoiseOctaves = 0;
+
+	UPROPERTY()
+	EDetailNoiseType DetailNoiseType = EDetailNoiseType::Fbm;
+
+	UPROPERTY()
+	FVector2D DetailNoiseScale = FVector2D::ZeroVector;
+
+	UPROPERTY()
+	FVector2D DetailNoiseOffset = FVector2D::ZeroVector;
+
+	UPROPERTY()
+	float DetailNoiseStrength = 0.f;
+
+	UPROPERTY()
+	float DetailNoiseLacunarity = 2.f;
+
+	UPROPERTY()
+	float DetailNoiseGain = 0.5f;
+
+	UPROPERTY()
+	float DetailNoiseWarpStrength = 0.f;
+
+	UPROPERTY()
+	FVector2D DetailNoiseWarpScale = FVector2D::ZeroVector;
+
+	//Compiled terrain graph, replaces the major, minor and detail noise if it is set
+	FTerrainProgramPtr TerrainProgram;
+
+	//Should a skirt be added below the border of the tile to hide cracks to neighbours with a different resolution
+	UPROPERTY()
+	bool bGenerateSkirts = false;
+
+	UPROPERTY()
+	float SkirtDepth = 0.f;
+
+	//Number of tiles the mesh spans on each axis, TileIndex is the tile in the corner with the smallest index
+	UPROPERTY()
+	int LODScale = 1;
+
+	/**
+	 * Converts the parameters to the plain parameters of the terrain math.
+	 */
+	FTerrainTileParams GetTerrainTileParams() const
+	{
+		FTerrainTileParams TerrainTileParams;
+		TerrainTileParams.MajorNoiseScale = MajorNoiseScale;
+		TerrainTileParams.MajorNoiseOffset = MajorNoiseOffset;
+		TerrainTileParams.MinorNoiseScale = MinorNoiseScale;
+		TerrainTileParams.MinorNoiseOffset = MinorNoiseOffset;
+		TerrainTileParams.MajorNoiseStrength = MajorNoiseStrength;
+		TerrainTileParams.MinorNoiseStrength = MinorNoiseStrength;
+		TerrainTileParams.DetailNoise.OctaveCount = DetailNoiseOctaves;
+		TerrainTileParams.DetailNoise.Type = DetailNoiseType == EDetailNoiseType::Ridged ? ETileFractalType::Ridged : ETileFractalType::Fbm;
+		TerrainTileParams.DetailNoise.Scale = DetailNoiseScale;
+		TerrainTileParams.DetailNoise.Offset = DetailNoiseOffset;
+		TerrainTileParams.DetailNoise.Strength = DetailNoiseStrength;
+		TerrainTileParams.DetailNoise.Lacunarity = DetailNoiseLacunarity;
+		TerrainTileParams.DetailNoise.Gain = DetailNoiseGain;
+		TerrainTileParams.DetailNoise.WarpStrength = DetailNoiseWarpStrength;
+		TerrainTileParams.DetailNoise.WarpScale = DetailNoiseWarpScale;
+		TerrainTileParams.TerrainProgram = TerrainProgram;
+		TerrainTileParams.TileX = TileIndex.X;
+		TerrainTileParams.TileY = TileIndex.Y;
+		TerrainTileParams.TileSize = TileSize;
+		TerrainTileParams.TileResolution = TileResolution;
+		TerrainTileParams.LODScale = LODScale;
+		return TerrainTileParams;
+	}
+
+	/**
+	 * Width of the generated mesh, the distance between the vertices grows with the LODScale.
+	 */
+	FORCEINLINE float GetMeshSize() const
+	{
+		return GetTerrainTileParams().GetMeshSize();
+	}
+
+	/**
+	 * Location of the mesh center on the X-axis.
+	 */
+	FORCEINLINE double GetMeshCenterX() const
+	{
+		return GetTerrainTileParams().GetMeshCenterX();
+	}
+
+	/**
+	 * Location of the mesh center on the Y-axis.
+	 */
+	FORCEINLINE double GetMeshCenterY() const
+	{
+		return GetTerrainTileParams().GetMeshCenterY();
+	}
+
 };
 
+typedef TSharedPtr<class FTileDiskCache, ESPMode::ThreadSafe> FTileDiskCachePtr;
+
 UCLASS()
 class PROCEDURALLANDSCAPE_API AProceduralTile : public AActor
 {
@@ -92,6 +223,11 @@ public:
 	// Sets default values for this actor's properties
 	AProceduralTile();
 
+	//Names of the foliage generation components, the names are part of the cache records of their foliage
+	static const TCHAR* const TreeGenerationComponentName;
+	static const TCHAR* const GrassGenerationComponentName;
+	static const TCHAR* const BushGenerationComponentName;
+
 	UFUNCTION()
 	void OnBeginOverlap (UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
 	
@@ -112,8 +248,47 @@ public:
 	 * 
 	 * \param TileGenerationParams the parameters needed to generate a tile
 	 * \param bIsUpdate if the tile should be updated or created
+	 * \param MeshBufferPool pool to borrow the mesh buffers from, new buffers are allocated if it is not set
+	 * \param DiskCache cache to load the heightfield from and to store it in, the heightfield is always generated if it is not set
 	 */
-	void GenerateTile(FTileGenerationParams TileGenerationParams, bool bIsUpdate = false);
+	void GenerateTile(FTileGenerationParams TileGenerationParams, bool bIsUpdate = false, FTileMeshBufferPoolPtr MeshBufferPool = nullptr, FTileDiskCachePtr DiskCache = nullptr);
+
+	/**
+	 * Generates the mesh data of the tile on a worker thread, the result is uploaded by TryFinishMeshGeneration.
+	 * A newly created tile stays hidden until its mesh is uploaded, an updated tile keeps showing its previous mesh.
+	 * 
+	 * \param TileGenerationParams the parameters needed to generate a tile
+	 * \param bIsUpdate if the tile should be updated or created
+	 * \param MeshBufferPool pool to borrow the mesh buffers from, new buffers are allocated if it is not set
+	 * \param DiskCache cache to load the heightfield from and to store it in, the heightfield is always generated if it is not set
+	 */
+	void GenerateTileAsync(FTileGenerationParams TileGenerationParams, bool bIsUpdate = false, FTileMeshBufferPoolPtr MeshBufferPool = nullptr, FTileDiskCachePtr DiskCache = nullptr);
+
+	/**
+	 * Uploads the asynchronously generated mesh data if it is ready, must be called on the game thread.
+	 * 
+	 * \return true if no mesh generation is pending anymore
+	 */
+	bool TryFinishMeshGeneration();
+
+	bool IsMeshGenerationPending() {
+		return MeshGenerationTask.IsValid();
+	}
+
+	/**
+	 * Enables or disables the collision of the landscape mesh, the collision is cooked asynchronously.
+	 * 
+	 * \param bEnabled if the tile should have collision
+	 */
+	void SetMeshCollisionEnabled(bool bEnabled);
+
+	/**
+	 * Shares the heights of the uploaded mesh with worker threads, the foliage samples its ground from them.
+	 * The copy is made once per mesh and reused by all foliage jobs of the tile.
+	 * 
+	 * \return the heights of the tile, empty if the tile has no mesh yet
+	 */
+	FTileHeightfieldPtr GetGroundHeightfield();
 
 	/**
 	 * Checks if the generation of locations for all foliage components is finished.
@@ -122,6 +297,22 @@ public:
 	 */
 	bool IsGenerationFinished();
 
+	/**
+	 * Fills the mesh data for a tile, does not touch the tile itself and can run on any thread.
+	 * 
+	 * \param TileGenerationParams the parameters that are needed for the generation of a new tile
+	 * \param bIsUpdate if only the data for updating an existing mesh is needed
+	 * \param MeshData reference to the mesh data to fill
+	 * \param DiskCache cache of previously generated heightfields, can be null
+	 */
+	static void BuildMeshData(FTileGenerationParams TileGenerationParams, bool bIsUpdate, FTileMeshData& MeshData, FTileDiskCachePtr DiskCache);
+
+	/**
+	 * Hides the tile, disables its collision and clears its foliage so it can be reused for another index.
+	 * The tile is activated again by Setup.
+	 */
+	void Recycle();
+
 	class UFoliageGenerationComponent* GetTreeGenerationComponent() {
 		return TreeGenerationComponent;
 	}
@@ -147,10 +338,22 @@ public:
 		return MinZPosition;
 	}
 
+	int GetMeshResolution() {
+		return MeshResolution;
+	}
+
+	int GetLODScale() {
+		return LODScale;
+	}
+
 	void MarkToDelete() {
 		bMarkedToDelete = true;
 	}
 
+	bool IsMarkedToDelete() {
+		return bMarkedToDelete;
+	}
+
 private:
 	//Component to procedurally create a tile
 	UPROPERTY(VisibleAnywhere)
@@ -196,6 +399,59 @@ private:
 	UPROPERTY()
 	bool bMarkedToDelete;
 
+	//Heights of the last generation of this tile
+	FTileHeightfield Heightfield;
+
+	//Copy of Heightfield that is shared with worker threads, created on demand and dropped whenever Heightfield changes
+	FTileHeightfieldPtr GroundHeightfield;
+
+	//Should the landscape mesh have collision
+	bool bHasMeshCollision = true;
+
+	//Resolution of the current (or pending) mesh section, 0 if the tile has no mesh yet
+	int MeshResolution = 0;
+
+	//Number of tiles the mesh spans on each axis
+	int LODScale = 1;
+
+	//Mesh data that is generated asynchronously for this tile
+	FTileMeshDataPtr PendingMeshData;
+
+	//Pool the pending mesh data is returned to
+	FTileMeshBufferPoolPtr PendingMeshBufferPool;
+
+	//Task that fills PendingMeshData
+	TFuture<void> MeshGenerationTask;
+
+	//If the pending mesh data updates the existing mesh section
+	bool bIsPendingUpdate = false;
+
+	/**
+	 * Mesh generation whose result is not needed anymore, its buffer goes back to the pool once the task is finished.
+	 */
+	struct FAbandonedMeshGeneration
+	{
+		TFuture<void> Task;
+
+		FTileMeshDataPtr MeshData;
+
+		FTileMeshBufferPoolPtr MeshBufferPool;
+	};
+
+	//Superseded mesh generations whose buffers are still used by a worker thread
+	TArray<FAbandonedMeshGeneration> AbandonedMeshGenerations;
+
+	/**
+	 * Drops the result of a mesh generation that is still running, the worker thread finishes on its own buffers.
+	 * Pooled buffers are returned by ReleaseAbandonedMeshData once the worker is done with them.
+	 */
+	void DiscardPendingMeshGeneration();
+
+	/**
+	 * Returns the buffers of all abandoned mesh generations whose task is finished to their pool.
+	 */
+	void ReleaseAbandonedMeshData();
+
 	/**
 	 * Sets up all desired foliage generation components.
 	 * 
@@ -206,105 +462,88 @@ private:
 	void SetupFoliageComponents(bool bGenerateTrees, bool bGenerateGrass, bool bGenerateBushes);
 
 	/**
-	 * Generates the triangles for the vertex at postion CurrentRow, CurrentColumn
+	 * Creates, keeps or removes a single foliage generation component.
 	 * 
-	 * \param Triangles the reference to the triangles array
-	 * \param CurrentRow the current row
-	 * \param CurrentColumn the current column
-	 * \param TileResolution the resolution of a tile
+	 * \param FoliageGenerationComponent the member that holds the component
+	 * \param bIsNeeded should the tile have this component
+	 * \param ComponentName the name of the component
 	 */
-	void GenerateTriangles(TArray<int32>& Triangles, int CurrentRow, int CurrentColumn, int TileResolution);
+	void SetupFoliageComponent(class UFoliageGenerationComponent*& FoliageGenerationComponent, bool bIsNeeded, const TCHAR* ComponentName);
 
 	/**
-	 * Sets up the Parameters for creating a new mesh
+	 * Borrows mesh data from the pool or allocates new mesh data if there is no pool.
 	 * 
-	 * \param TileGenerationParams the parameters that are needed for the generation of a new tile
-	 * \param Vertices reference to the array that stores the vertices
-	 * \param Triangles reference to the array that stores the triangles
-	 * \param Normals reference to the array that stores the normals
-	 * \param UV0 reference to the array that stores the uvs
-	 * \param VertexColor reference to the array that stores the vertex colors
+	 * \param MeshBufferPool the pool to borrow from, can be null
+	 * \param TileResolution the resolution of the tile that will be generated
+	 * \return the mesh data
 	 */
-	void SetupParamsCreation(FTileGenerationParams TileGenerationParams, TArray<FVector>& Vertices, TArray<int32>& Triangles, TArray<FVector>& Normals, TArray<FVector2D>& UV0, TArray<FColor>& VertexColor);
-	
+	static FTileMeshDataPtr AcquireMeshData(FTileMeshBufferPoolPtr MeshBufferPool, int TileResolution);
+
 	/**
-	 * Sets up the Parameters for updating an existing mesh
+	 * Uploads generated mesh data to the ProceduralMeshComponent, must be called on the game thread.
 	 * 
-	 * \param TileGenerationParams the parameters that are needed for the generation of a new tile
-	 * \param Vertices reference to the array that stores the vertices
-	 * \param Normals  reference to the array that stores the normals
-	 * \param UV0 reference to the array that stores the uvs
-	 * \param VertexColor reference to the array that stores the vertex colors
+	 * \param MeshData the generated mesh data
+	 * \param bIsUpdate if the mesh section should be updated or created
 	 */
-	void SetupParamsUpdate(FTileGenerationParams TileGenerationParams, TArray<FVector>& Vertices, TArray<FVector>& Normals, TArray<FVector2D>& UV0, TArray<FColor>& VertexColor);
-	
+	void ApplyMeshData(FTileMeshData& MeshData, bool bIsUpdate);
+
 	/**
-	 * Generates the information that is related to the vertices
+	 * Checks if the uploaded mesh section can be updated in place with the provided parameters or if it has to be recreated,
+	 * and remembers the layout of the new mesh. Only the latest request is ever uploaded, so comparing against the uploaded section is enough.
 	 * 
-	 * \param Vertices reference to the array that stores the vertices
-	 * \param Normals  reference to the array that stores the normals
-	 * \param UV0 reference to the array that stores the uvs
-	 * \param VertexColor reference to the array that stores the vertex colors
-	 * \param MinZOffset refernce that will store the smallest Z value
-	 * \param MaxZOffset reference that will store the highest Z value
-	 * \param TileGenerationParams the parameters that are needed for the generation of a new tile
-	 * \param Row current row
-	 * \param Column current column
-	 * \param DistanceBetweenVertices the distance between two vertices
+	 * \param TileGenerationParams the parameters of the new mesh
+	 * \param bIsUpdate if the caller wants to update the existing mesh
+	 * \return true if the existing mesh section can be updated
 	 */
-	void GenerateVertexInformation(TArray<FVector>& Vertices, TArray<FVector>& Normals, TArray<FVector2D>& UV0, TArray<FColor>& VertexColor, float& MinZOffset, float& MaxZOffset, FTileGenerationParams TileGenerationParams, int Row, int Column, float DistanceBetweenVertices);
+	bool PrepareMeshLayout(FTileGenerationParams TileGenerationParams, bool bIsUpdate);
 
 	/**
-	 * Adds a triangle for the Vertices V1, V2, V3
+	 * Adds a skirt vertex below every border vertex of the tile.
 	 * 
-	 * \param Triangles reference to the array that stores the triangles
-	 * \param V1 index of the first bertex
-	 * \param V2 index of the second vertex
-	 * \param V3 index of the third vertex
+	 * \param MeshData reference to the mesh data whose grid vertices are already generated
+	 * \param TileGenerationParams the parameters that are needed for the generation of a new tile
 	 */
-	void AddTriangle(TArray<int32>& Triangles, int32 V1, int32 V2, int32 V3);
+	static void GenerateSkirtVertices(FTileMeshData& MeshData, FTileGenerationParams TileGenerationParams);
 
 	/**
-	 * Calculates the normal of vertex at Position (XPos, YPos)
+	 * Sets up the Parameters for creating a new mesh
 	 * 
-	 * \param XPos location on the X-axis
-	 * \param YPos location on the Y-axis
-	 * \param DistanceBetweenVertices the distance between two vertices
 	 * \param TileGenerationParams the parameters that are needed for the generation of a new tile
-	 * \return the normal vector of this vertex
+	 * \param MeshData reference to the mesh data that stores vertices, triangles, normals, uvs and vertex colors, the heightfield has to be filled
+	 * \param bHasNormals if the normals of the grid vertices were already loaded
 	 */
-	FVector CalculateVertexNormal(float XPos, float YPos, float DistanceBetweenVertices, FTileGenerationParams TileGenerationParams);
-
+	static void SetupParamsCreation(const FTileGenerationParams& TileGenerationParams, FTileMeshData& MeshData, bool bHasNormals);
+	
 	/**
-	 * Caclulates the Z-Offset at Position(XPos,YPos) using the perlin noise function
+	 * Sets up the Parameters for updating an existing mesh
 	 * 
-	 * \param XPos location on the X-axis
-	 * \param YPos location on the Y-axis
-	 * \param NoiseScale scale of the the PerlineNoise
-	 * \param NoiseOffset offset of the PerlineNoise
-	 * \param NoiseStrength strength of the PerlineNoise
-	 * \return the Z-Position of a vertex
+	 * \param TileGenerationParams the parameters that are needed for the generation of a new tile
+	 * \param MeshData reference to the mesh data that stores vertices, normals, uvs and vertex colors, the heightfield has to be filled
+	 * \param bHasNormals if the normals of the grid vertices were already loaded
 	 */
-	float GetZOffset(float XPos, float YPos, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength);
+	static void SetupParamsUpdate(const FTileGenerationParams& TileGenerationParams, FTileMeshData& MeshData, bool bHasNormals);
+	
 
 	/**
-	 * Maps a value from range (MinPrev,MaxPrev) to the value in the new range (MinNew, MaxNew)
+	 * Generates the information that is related to the vertices
 	 * 
-	 * \param Value current value
-	 * \param MinPrev smallest value of the previous range
-	 * \param MaxPrev highest value of the previous range
-	 * \param MinNew smallest value of the new range
-	 * \param MaxNew highest value of the new range
-	 * \return Value mapped to the the new range 
+	 * \param MeshData reference to the mesh data that stores vertices, normals, uvs and vertex colors
+	 * \param TerrainTileParams the terrain parameters of the tile, built once per mesh
+	 * \param HalfMeshSize half the size of the mesh, the offset of the first row and column
+	 * \param TileResolution the number of vertices per row
+	 * \param Row current row
+	 * \param Column current column
+	 * \param bHasNormals if the normal of the vertex was already loaded
 	 */
-	float MapToRange(float Value, float MinPrev, float MaxPrev, float MinNew, float MaxNew);
+	static void GenerateVertexInformation(FTileMeshData& MeshData, const FTerrainTileParams& TerrainTileParams, float HalfMeshSize, int TileResolution, int Row, int Column, bool bHasNormals);
 
 	/**
-	 * Maps a Value to the UV-Space
+	 * Sets the extent of the trigger box and the Z bounds of the tile from the heightfield
 	 * 
-	 * \param Value value to map to UV space
-	 * \param TileSize The size of a tile
-	 * \return mapped Value to UV-Space
+	 * \param Heightfield_In the previously sampled heights of this tile
+	 * \param TileSize the size of a tile
 	 */
-	float MapToUV(float Value, int TileSize);
+	void ApplyHeightfieldBounds(const FTileHeightfield& Heightfield_In, int TileSize);
+
+
 };
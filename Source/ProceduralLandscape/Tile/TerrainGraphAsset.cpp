@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainGraphAsset.h"
+
+#include "../ProceduralLandscape.h"
+
+#include "Curves/CurveFloat.h"
+
+void UTerrainGraphAsset::PostLoad()
+{
+	Super::PostLoad();
+	GetProgram();
+}
+
+#if WITH_EDITOR
+void UTerrainGraphAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	bIsCompiled = false;
+	CompiledProgram.Reset();
+}
+#endif
+
+FTerrainProgramPtr UTerrainGraphAsset::GetProgram()
+{
+	if (!bIsCompiled) {
+		CompiledProgram = Compile();
+		bIsCompiled = true;
+	}
+	return CompiledProgram;
+}
+
+FTerrainProgramPtr UTerrainGraphAsset::Compile() const
+{
+	TMap<FName, int> NodeIndices;
+	for (int i = 0; i < Nodes.Num(); ++i) {
+		if (Nodes[i].Name.IsNone()) continue;
+		if (NodeIndices.Contains(Nodes[i].Name)) {
+			UE_LOG(LogProceduralLandscape, Error, TEXT("TerrainGraph %s: the node name %s is used more than once"), *GetName(), *Nodes[i].Name.ToString());
+			return nullptr;
+		}
+		NodeIndices.Add(Nodes[i].Name, i);
+	}
+
+	const int* HeightNodeIndex = NodeIndices.Find(HeightNode);
+	if (!HeightNodeIndex) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("TerrainGraph %s: the height node %s does not exist"), *GetName(), *HeightNode.ToString());
+		return nullptr;
+	}
+	const int* ColorNodeIndex = NodeIndices.Find(ColorNode);
+	if (!ColorNode.IsNone() && !ColorNodeIndex) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("TerrainGraph %s: the color node %s does not exist"), *GetName(), *ColorNode.ToString());
+		return nullptr;
+	}
+
+	//Nodes that neither the height nor the color depend on are never emitted
+	TSharedRef<FTerrainProgram, ESPMode::ThreadSafe> Program = MakeShared<FTerrainProgram, ESPMode::ThreadSafe>();
+	TArray<uint8> VisitStates;
+	VisitStates.SetNumZeroed(Nodes.Num());
+	if (!EmitNode(*HeightNodeIndex, NodeIndices, VisitStates, *Program)) return nullptr;
+	if (ColorNodeIndex && !EmitNode(*ColorNodeIndex, NodeIndices, VisitStates, *Program)) return nullptr;
+	Program->HeightRegister = *HeightNodeIndex;
+	Program->ColorRegister = ColorNodeIndex ? *ColorNodeIndex : -1;
+	Program->Finalize();
+	if (!Program->IsValid()) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("TerrainGraph %s: a node is missing one of its inputs"), *GetName());
+		return nullptr;
+	}
+	UE_LOG(LogProceduralLandscape, Log, TEXT("TerrainGraph %s: compiled %d nodes into %d instructions with %d registers"), *GetName(), Nodes.Num(), Program->Instructions.Num(), Program->GetRegisterCount());
+	return Program;
+}
+
+bool UTerrainGraphAsset::EmitNode(int NodeIndex, const TMap<FName, int>& NodeIndices, TArray<uint8>& VisitStates, FTerrainProgram& Program) const
+{
+	if (VisitStates[NodeIndex] == 2) return true;
+	const FTerrainGraphNode& Node = Nodes[NodeIndex];
+	if (VisitStates[NodeIndex] == 1) {
+		UE_LOG(LogProceduralLandscape, Error, TEXT("TerrainGraph %s: the node %s depends on itself"), *GetName(), *Node.Name.ToString());
+		return false;
+	}
+	VisitStates[NodeIndex] = 1;
+
+	int Inputs[3] = { -1, -1, -1 };
+	FName InputNames[3] = { Node.InputA, Node.InputB, Node.InputC };
+	for (int i = 0; i < 3; ++i) {
+		if (InputNames[i].IsNone()) continue;
+		const int* InputIndex = NodeIndices.Find(InputNames[i]);
+		if (!InputIndex) {
+			UE_LOG(LogProceduralLandscape, Error, TEXT("TerrainGraph %s: the input %s of the node %s does not exist"), *GetName(), *InputNames[i].ToString(), *Node.Name.ToString());
+			return false;
+		}
+		if (!EmitNode(*InputIndex, NodeIndices, VisitStates, Program)) return false;
+		Inputs[i] = *InputIndex;
+	}
+
+	FTerrainInstruction Instruction;
+	Instruction.Output = NodeIndex;
+	Instruction.InputA = Inputs[0];
+	Instruction.InputB = Inputs[1];
+	Instruction.InputC = Inputs[2];
+	Instruction.Value = Node.Value;
+	Instruction.MinValue = Node.MinValue;
+	Instruction.MaxValue = Node.MaxValue;
+	switch (Node.Type) {
+	case ETerrainGraphNodeType::Constant: Instruction.Op = ETerrainOp::Constant; break;
+	case ETerrainGraphNodeType::Noise:
+		Instruction.Op = ETerrainOp::Noise;
+		Instruction.Scale = Node.NoiseScale;
+		Instruction.Offset = Node.NoiseOffset;
+		Instruction.Strength = Node.NoiseStrength;
+		break;
+	case ETerrainGraphNodeType::Fractal:
+		Instruction.Op = ETerrainOp::Fractal;
+		Instruction.Fractal.OctaveCount = Node.Octaves;
+		Instruction.Fractal.Type = Node.FractalType == EDetailNoiseType::Ridged ? ETileFractalType::Ridged : ETileFractalType::Fbm;
+		Instruction.Fractal.Scale = Node.NoiseScale;
+		Instruction.Fractal.Offset = Node.NoiseOffset;
+		Instruction.Fractal.Strength = Node.NoiseStrength;
+		Instruction.Fractal.Lacunarity = Node.Lacunarity;
+		Instruction.Fractal.Gain = Node.Gain;
+		Instruction.Fractal.WarpStrength = Node.WarpStrength;
+		Instruction.Fractal.WarpScale = Node.WarpScale;
+		break;
+	case ETerrainGraphNodeType::Add: Instruction.Op = ETerrainOp::Add; break;
+	case ETerrainGraphNodeType::Multiply: Instruction.Op = ETerrainOp::Multiply; break;
+	case ETerrainGraphNodeType::Min: Instruction.Op = ETerrainOp::Min; break;
+	case ETerrainGraphNodeType::Max: Instruction.Op = ETerrainOp::Max; break;
+	case ETerrainGraphNodeType::Clamp: Instruction.Op = ETerrainOp::Clamp; break;
+	case ETerrainGraphNodeType::Curve: {
+		if (!Node.Curve) {
+			UE_LOG(LogProceduralLandscape, Error, TEXT("TerrainGraph %s: the curve node %s has no curve"), *GetName(), *Node.Name.ToString());
+			return false;
+		}
+		//The curve is baked, so the program neither references the asset nor evaluates its keys per sample
+		Instruction.Op = ETerrainOp::Curve;
+		Instruction.CurveStart = Program.CurveSamples.Num();
+		Instruction.CurveCount = FMath::Max(CurveSampleCount, 2);
+		for (int i = 0; i < Instruction.CurveCount; ++i) {
+			float Alpha = float(i) / (Instruction.CurveCount - 1);
+			Program.CurveSamples.Add(Node.Curve->FloatCurve.Eval(FMath::Lerp(Node.MinValue, Node.MaxValue, Alpha)));
+		}
+		break;
+	}
+	case ETerrainGraphNodeType::Mask: Instruction.Op = ETerrainOp::Mask; break;
+	case ETerrainGraphNodeType::Select: Instruction.Op = ETerrainOp::Select; break;
+	}
+	Program.Instructions.Add(Instruction);
+	VisitStates[NodeIndex] = 2;
+	return true;
+}
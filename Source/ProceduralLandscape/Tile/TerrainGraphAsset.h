@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "ProceduralTile.h"
+#include "TerrainProgram.h"
+#include "TerrainGraphAsset.generated.h"
+
+UENUM()
+enum class ETerrainGraphNodeType : uint8
+{
+	//A constant value
+	Constant,
+
+	//Perlin noise
+	Noise,
+
+	//Multi-octave fractal noise
+	Fractal,
+
+	//InputA + InputB
+	Add,
+
+	//InputA * InputB
+	Multiply,
+
+	//Smaller value of InputA and InputB
+	Min,
+
+	//Larger value of InputA and InputB
+	Max,
+
+	//InputA clamped to [MinValue, MaxValue]
+	Clamp,
+
+	//Curve evaluated at InputA, the curve is sampled between MinValue and MaxValue
+	Curve,
+
+	//Smooth step of InputA from MinValue to MaxValue, the result is in [0, 1]
+	Mask,
+
+	//Blends from InputA to InputB by InputC, InputC is usually a mask
+	Select
+};
+
+/**
+ * A single height operation of a terrain graph.
+ */
+USTRUCT()
+struct FTerrainGraphNode
+{
+	GENERATED_BODY()
+
+	//Name that other nodes use to reference this node
+	UPROPERTY(EditAnywhere)
+	FName Name;
+
+	UPROPERTY(EditAnywhere)
+	ETerrainGraphNodeType Type = ETerrainGraphNodeType::Constant;
+
+	//Names of the operand nodes
+	UPROPERTY(EditAnywhere)
+	FName InputA;
+
+	UPROPERTY(EditAnywhere)
+	FName InputB;
+
+	UPROPERTY(EditAnywhere)
+	FName InputC;
+
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Constant", EditConditionHides))
+	float Value = 0.0f;
+
+	//Range of Clamp, Curve and Mask
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Clamp || Type == ETerrainGraphNodeType::Curve || Type == ETerrainGraphNodeType::Mask", EditConditionHides))
+	float MinValue = 0.0f;
+
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Clamp || Type == ETerrainGraphNodeType::Curve || Type == ETerrainGraphNodeType::Mask", EditConditionHides))
+	float MaxValue = 1.0f;
+
+	//X and Y scale of the noise, of the first octave for fractals
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Noise || Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	FVector2D NoiseScale = FVector2D(1.0f, 1.0f);
+
+	//X and Y offset of the noise, of the first octave for fractals
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Noise || Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	FVector2D NoiseOffset = FVector2D::ZeroVector;
+
+	//The influence of the noise, of the first octave for fractals
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Noise || Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	float NoiseStrength = 1.0f;
+
+	UPROPERTY(EditAnywhere, meta = (UIMin = 1, UIMax = 12, EditCondition = "Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	int Octaves = 4;
+
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	EDetailNoiseType FractalType = EDetailNoiseType::Fbm;
+
+	UPROPERTY(EditAnywhere, meta = (UIMin = 1, UIMax = 4, EditCondition = "Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	float Lacunarity = 2.0f;
+
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0, UIMax = 1, EditCondition = "Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	float Gain = 0.5f;
+
+	//Distance in tiles the fractal is displaced by, 0 disables the domain warping
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0, EditCondition = "Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	float WarpStrength = 0.0f;
+
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Fractal", EditConditionHides))
+	FVector2D WarpScale = FVector2D(0.25f, 0.25f);
+
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Type == ETerrainGraphNodeType::Curve", EditConditionHides))
+	UCurveFloat* Curve = nullptr;
+};
+
+/**
+ * Graph of height operations that replaces the fixed major and minor noise of the tile generator.
+ * The graph is compiled into a flat FTerrainProgram when it is loaded or edited, tiles only ever run the program.
+ */
+UCLASS()
+class PROCEDURALLANDSCAPE_API UTerrainGraphAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	//All nodes of the graph, in any order
+	UPROPERTY(EditAnywhere)
+	TArray<FTerrainGraphNode> Nodes;
+
+	//Node that produces the height of the terrain
+	UPROPERTY(EditAnywhere)
+	FName HeightNode;
+
+	//Node that drives the blue channel of the vertex colors, like the minor noise does without a graph. Can be none
+	UPROPERTY(EditAnywhere)
+	FName ColorNode;
+
+	//Number of samples a curve is baked into
+	UPROPERTY(EditAnywhere, meta = (UIMin = 2, UIMax = 1024))
+	int CurveSampleCount = 64;
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	/**
+	 * Returns the compiled program, the graph is compiled on the first call after it was loaded or edited.
+	 *
+	 * \return the program, null if the graph is invalid
+	 */
+	FTerrainProgramPtr GetProgram();
+
+	/**
+	 * Compiles the nodes that the height and color nodes depend on into a flat program. Errors are logged.
+	 *
+	 * \return the program, null if the graph is invalid
+	 */
+	FTerrainProgramPtr Compile() const;
+
+private:
+	//Result of the last compilation
+	FTerrainProgramPtr CompiledProgram;
+
+	//If CompiledProgram belongs to the current nodes
+	bool bIsCompiled = false;
+
+	/**
+	 * Appends the instruction of a node after the instructions of its operands. The node index is used as its register.
+	 *
+	 * \param NodeIndex the index of the node
+	 * \param NodeIndices the index of every node name
+	 * \param VisitStates 0 for unvisited nodes, 1 for nodes whose operands are emitted, 2 for emitted nodes
+	 * \param Program the program the instructions are appended to
+	 * \return false if an operand is missing or the graph has a cycle
+	 */
+	bool EmitNode(int NodeIndex, const TMap<FName, int>& NodeIndices, TArray<uint8>& VisitStates, FTerrainProgram& Program) const;
+};
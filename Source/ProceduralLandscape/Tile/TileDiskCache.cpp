@@ -0,0 +1,287 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileDiskCache.h"
+
+#include "../ProceduralLandscape.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/Guid.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	//"PLTC" in little endian
+	constexpr uint32 CacheMagic = 0x43544C50;
+
+	//Has to be increased whenever the layout of a record or the generation of its content changes
+	constexpr uint32 CacheVersion = 3;
+
+	//Sections start at multiples of this size, so they can be mapped without touching the pages of other sections
+	constexpr int64 CachePageSize = 4096;
+
+	struct FCacheSection
+	{
+		int64 Offset;
+		int64 Size;
+	};
+
+	struct FCacheHeader
+	{
+		uint32 Magic = CacheMagic;
+		uint32 Version = CacheVersion;
+		int32 TileResolution = 0;
+		int32 SampleCount = 0;
+		float DistanceBetweenVertices = 0.f;
+		float MinZ = 0.f;
+		float MaxZ = 0.f;
+		int32 SectionCount = 0;
+	};
+
+	//The section table follows the header and has to fit into the header page
+	constexpr int MaxSectionCount = (CachePageSize - sizeof(FCacheHeader)) / sizeof(FCacheSection);
+
+	struct FCacheSectionData
+	{
+		const void* Data;
+		int64 Size;
+	};
+
+	/**
+	 * Writes a record to a temporary file and moves it to its final path.
+	 */
+	bool WriteRecord(const FString& Path, FCacheHeader Header, const TArray<FCacheSectionData, TInlineAllocator<8>>& Sections)
+	{
+		if (Sections.Num() > MaxSectionCount) return false;
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		if (!PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Path))) return false;
+
+		TArray<uint8> HeaderPage;
+		HeaderPage.SetNumZeroed(CachePageSize);
+		Header.SectionCount = Sections.Num();
+		FMemory::Memcpy(HeaderPage.GetData(), &Header, sizeof(FCacheHeader));
+		FCacheSection* SectionTable = reinterpret_cast<FCacheSection*>(HeaderPage.GetData() + sizeof(FCacheHeader));
+		int64 Offset = CachePageSize;
+		for (int i = 0; i < Sections.Num(); ++i) {
+			SectionTable[i].Offset = Offset;
+			SectionTable[i].Size = Sections[i].Size;
+			Offset = Align(Offset + Sections[i].Size, CachePageSize);
+		}
+
+		FString TempPath = FString::Printf(TEXT("%s.%s.tmp"), *Path, *FGuid::NewGuid().ToString());
+		{
+			TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*TempPath));
+			if (!File) return false;
+			static const uint8 Padding[CachePageSize] = {};
+			bool bSuccess = File->Write(HeaderPage.GetData(), CachePageSize);
+			for (const FCacheSectionData& Section : Sections) {
+				if (Section.Size <= 0) continue;
+				bSuccess &= File->Write(static_cast<const uint8*>(Section.Data), Section.Size);
+				int64 PaddingSize = Align(Section.Size, CachePageSize) - Section.Size;
+				if (PaddingSize > 0) bSuccess &= File->Write(Padding, PaddingSize);
+			}
+			if (!bSuccess) {
+				File.Reset();
+				PlatformFile.DeleteFile(*TempPath);
+				return false;
+			}
+		}
+		//Records are only written if they are missing, invalid or forced, so an existing record is always replaced.
+		//MoveFile does not overwrite on every platform, the old record is deleted first if the move fails.
+		//Another thread or session may have written the same record in the meantime, the content is identical
+		bool bIsMoved = PlatformFile.MoveFile(*Path, *TempPath);
+		if (!bIsMoved && PlatformFile.FileExists(*Path)) {
+			PlatformFile.DeleteFile(*Path);
+			bIsMoved = PlatformFile.MoveFile(*Path, *TempPath);
+		}
+		if (!bIsMoved) {
+			UE_LOG(LogProceduralLandscape, Warning, TEXT("TileDiskCache: could not move %s to %s"), *TempPath, *Path);
+			PlatformFile.DeleteFile(*TempPath);
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Memory-mapped record whose header and section table are validated on open.
+	 */
+	class FMappedRecord
+	{
+	public:
+		FCacheHeader Header;
+
+		bool Open(const FString& Path)
+		{
+			IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+			Handle.Reset(PlatformFile.OpenMapped(*Path));
+			if (!Handle || Handle->GetFileSize() < CachePageSize) return false;
+			Region.Reset(Handle->MapRegion(0, Handle->GetFileSize()));
+			if (!Region) return false;
+
+			const uint8* Data = Region->GetMappedPtr();
+			FMemory::Memcpy(&Header, Data, sizeof(FCacheHeader));
+			if (Header.Magic != CacheMagic || Header.Version != CacheVersion) return false;
+			if (Header.SectionCount < 0 || Header.SectionCount > MaxSectionCount) return false;
+			Sections = reinterpret_cast<const FCacheSection*>(Data + sizeof(FCacheHeader));
+			for (int i = 0; i < Header.SectionCount; ++i) {
+				if (Sections[i].Offset < CachePageSize || Sections[i].Size < 0) return false;
+				if (Sections[i].Offset + Sections[i].Size > Region->GetMappedSize()) return false;
+			}
+			return true;
+		}
+
+		const void* GetSectionData(int SectionIndex) const
+		{
+			return Region->GetMappedPtr() + Sections[SectionIndex].Offset;
+		}
+
+		int64 GetSectionSize(int SectionIndex) const
+		{
+			return Sections[SectionIndex].Size;
+		}
+
+	private:
+		//Declared before the region, so the region is unmapped before the file is closed
+		TUniquePtr<IMappedFileHandle> Handle;
+
+		TUniquePtr<IMappedFileRegion> Region;
+
+		const FCacheSection* Sections = nullptr;
+	};
+}
+
+FTileDiskCache::FTileDiskCache(const FString& CacheDirectory_In)
+	: CacheDirectory(CacheDirectory_In)
+{
+}
+
+FString FTileDiskCache::GetCacheDirectory(const FTileGenerationParams& TileGenerationParams, int RandomSeed)
+{
+	TArray<uint8> Buffer;
+	FMemoryWriter Writer(Buffer);
+	uint32 Version = CacheVersion;
+	int32 Seed = RandomSeed;
+	int32 TileSize = TileGenerationParams.TileSize;
+	FVector2D MajorNoiseScale = TileGenerationParams.MajorNoiseScale;
+	FVector2D MajorNoiseOffset = TileGenerationParams.MajorNoiseOffset;
+	FVector2D MinorNoiseScale = TileGenerationParams.MinorNoiseScale;
+	FVector2D MinorNoiseOffset = TileGenerationParams.MinorNoiseOffset;
+	float MajorNoiseStrength = TileGenerationParams.MajorNoiseStrength;
+	float MinorNoiseStrength = TileGenerationParams.MinorNoiseStrength;
+	Writer << Version << Seed << TileSize;
+	Writer << MajorNoiseScale << MajorNoiseOffset << MajorNoiseStrength;
+	Writer << MinorNoiseScale << MinorNoiseOffset << MinorNoiseStrength;
+	//Only hashed if enabled, so the caches of landscapes without detail noise stay valid
+	int32 DetailNoiseOctaves = TileGenerationParams.DetailNoiseOctaves;
+	if (DetailNoiseOctaves > 0) {
+		Writer << DetailNoiseOctaves;
+		uint8 DetailNoiseType = uint8(TileGenerationParams.DetailNoiseType);
+		FVector2D DetailNoiseScale = TileGenerationParams.DetailNoiseScale;
+		FVector2D DetailNoiseOffset = TileGenerationParams.DetailNoiseOffset;
+		FVector2D DetailNoiseWarpScale = TileGenerationParams.DetailNoiseWarpScale;
+		float DetailNoiseStrength = TileGenerationParams.DetailNoiseStrength;
+		float DetailNoiseLacunarity = TileGenerationParams.DetailNoiseLacunarity;
+		float DetailNoiseGain = TileGenerationParams.DetailNoiseGain;
+		float DetailNoiseWarpStrength = TileGenerationParams.DetailNoiseWarpStrength;
+		Writer << DetailNoiseType << DetailNoiseScale << DetailNoiseOffset << DetailNoiseStrength << DetailNoiseLacunarity << DetailNoiseGain;
+		Writer << DetailNoiseWarpScale << DetailNoiseWarpStrength;
+	}
+	if (TileGenerationParams.TerrainProgram.IsValid()) {
+		uint64 TerrainProgramHash = TileGenerationParams.TerrainProgram->GetHash();
+		Writer << TerrainProgramHash;
+	}
+
+	uint64 Hash = CityHash64(reinterpret_cast<const char*>(Buffer.GetData()), Buffer.Num());
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("TileCache"), FString::Printf(TEXT("%016llx"), Hash));
+}
+
+bool FTileDiskCache::LoadHeightfield(const FTileGenerationParams& TileGenerationParams, FTileHeightfield& Heightfield_Out, FVector* Normals_Out)
+{
+	int TileResolution = TileGenerationParams.TileResolution;
+	int SampleCount = TileResolution + 2;
+	int64 SampleBytes = int64(SampleCount) * SampleCount * sizeof(float);
+	int64 NormalBytes = int64(TileResolution) * TileResolution * sizeof(FVector);
+
+	FMappedRecord Record;
+	bool bIsValid = Record.Open(GetHeightfieldPath(TileGenerationParams))
+		&& Record.Header.TileResolution == TileResolution && Record.Header.SampleCount == SampleCount && Record.Header.SectionCount == 3
+		&& Record.GetSectionSize(0) == SampleBytes && Record.GetSectionSize(1) == SampleBytes && Record.GetSectionSize(2) == NormalBytes;
+	if (!bIsValid) {
+		++MissCount;
+		return false;
+	}
+
+	Heightfield_Out.SampleCount = SampleCount;
+	Heightfield_Out.DistanceBetweenVertices = Record.Header.DistanceBetweenVertices;
+	Heightfield_Out.MinZ = Record.Header.MinZ;
+	Heightfield_Out.MaxZ = Record.Header.MaxZ;
+	Heightfield_Out.Heights.SetNumUninitialized(SampleCount * SampleCount, false);
+	Heightfield_Out.MinorHeights.SetNumUninitialized(SampleCount * SampleCount, false);
+	FMemory::Memcpy(Heightfield_Out.Heights.GetData(), Record.GetSectionData(0), SampleBytes);
+	FMemory::Memcpy(Heightfield_Out.MinorHeights.GetData(), Record.GetSectionData(1), SampleBytes);
+	FMemory::Memcpy(Normals_Out, Record.GetSectionData(2), NormalBytes);
+	++HitCount;
+	return true;
+}
+
+void FTileDiskCache::SaveHeightfield(const FTileGenerationParams& TileGenerationParams, const FTileHeightfield& Heightfield_In, const FVector* Normals_In)
+{
+	FCacheHeader Header;
+	Header.TileResolution = TileGenerationParams.TileResolution;
+	Header.SampleCount = Heightfield_In.SampleCount;
+	Header.DistanceBetweenVertices = Heightfield_In.DistanceBetweenVertices;
+	Header.MinZ = Heightfield_In.MinZ;
+	Header.MaxZ = Heightfield_In.MaxZ;
+
+	TArray<FCacheSectionData, TInlineAllocator<8>> Sections;
+	Sections.Add({ Heightfield_In.Heights.GetData(), Heightfield_In.Heights.Num() * int64(sizeof(float)) });
+	Sections.Add({ Heightfield_In.MinorHeights.GetData(), Heightfield_In.MinorHeights.Num() * int64(sizeof(float)) });
+	Sections.Add({ Normals_In, int64(TileGenerationParams.TileResolution) * TileGenerationParams.TileResolution * sizeof(FVector) });
+	WriteRecord(GetHeightfieldPath(TileGenerationParams), Header, Sections);
+}
+
+bool FTileDiskCache::LoadFoliage(FTileIndex TileIndex, const FString& FoliageName, TArray<FTransformArrayA2>& Instances_Out)
+{
+	FMappedRecord Record;
+	bool bIsValid = Record.Open(GetFoliagePath(TileIndex, FoliageName)) && Record.Header.SectionCount == Instances_Out.Num();
+	for (int i = 0; bIsValid && i < Instances_Out.Num(); ++i) {
+		bIsValid = Record.GetSectionSize(i) % sizeof(FTransform) == 0;
+	}
+	if (!bIsValid) {
+		++MissCount;
+		return false;
+	}
+
+	for (int i = 0; i < Instances_Out.Num(); ++i) {
+		int InstanceCount = Record.GetSectionSize(i) / sizeof(FTransform);
+		Instances_Out[i].SetNumUninitialized(InstanceCount, false);
+		FMemory::Memcpy(Instances_Out[i].GetData(), Record.GetSectionData(i), Record.GetSectionSize(i));
+	}
+	++HitCount;
+	return true;
+}
+
+void FTileDiskCache::SaveFoliage(FTileIndex TileIndex, const FString& FoliageName, const TArray<FTransformArrayA2>& Instances_In)
+{
+	TArray<FCacheSectionData, TInlineAllocator<8>> Sections;
+	for (const FTransformArrayA2& Instances : Instances_In) {
+		Sections.Add({ Instances.GetData(), Instances.Num() * int64(sizeof(FTransform)) });
+	}
+	WriteRecord(GetFoliagePath(TileIndex, FoliageName), FCacheHeader(), Sections);
+}
+
+FString FTileDiskCache::GetHeightfieldPath(const FTileGenerationParams& TileGenerationParams) const
+{
+	FTileIndex TileIndex = TileGenerationParams.TileIndex;
+	FString FileName = FString::Printf(TEXT("Tile_%lld_%lld_R%d_S%d.height"), TileIndex.X, TileIndex.Y, TileGenerationParams.TileResolution, TileGenerationParams.LODScale);
+	return FPaths::Combine(CacheDirectory, FileName);
+}
+
+FString FTileDiskCache::GetFoliagePath(FTileIndex TileIndex, const FString& FoliageName) const
+{
+	FString FileName = FString::Printf(TEXT("Tile_%lld_%lld_%s.foliage"), TileIndex.X, TileIndex.Y, *FoliageName);
+	return FPaths::Combine(CacheDirectory, FileName);
+}
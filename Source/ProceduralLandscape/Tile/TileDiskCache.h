@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralTile.h"
+
+#include <atomic>
+
+/**
+ * Persistent cache for generated tile data in Saved/TileCache.
+ *
+ * Every configuration of the noise gets its own directory, every tile its own record file. A record starts with a
+ * header page that holds the section table, every section starts at a page boundary. Records are memory-mapped
+ * and their sections are copied straight into the destination buffers, nothing is parsed or converted.
+ * Records are written to a temporary file first and then renamed, so concurrent writers and aborted sessions
+ * never leave a partial record behind.
+ */
+class PROCEDURALLANDSCAPE_API FTileDiskCache
+{
+public:
+	/**
+	 * Creates a cache that reads and writes the records in the provided directory.
+	 *
+	 * \param CacheDirectory_In directory of the records, is created on the first write
+	 */
+	explicit FTileDiskCache(const FString& CacheDirectory_In);
+
+	/**
+	 * Calculates the cache directory for a configuration of the noise. The tile index, resolution, scale and skirts
+	 * do not change the terrain, so they are not part of the directory but of the record names.
+	 *
+	 * \param TileGenerationParams the parameters shared by all tiles
+	 * \param RandomSeed the global random seed of the landscape
+	 * \return the directory in Saved/TileCache
+	 */
+	static FString GetCacheDirectory(const FTileGenerationParams& TileGenerationParams, int RandomSeed);
+
+	/**
+	 * Loads the heightfield and the normals of the grid vertices of a tile.
+	 *
+	 * \param TileGenerationParams the parameters of the tile
+	 * \param Heightfield_Out receives the heights, its buffers are reused
+	 * \param Normals_Out receives TileResolution * TileResolution normals, must be large enough
+	 * \return true if the record exists and matches the parameters
+	 */
+	bool LoadHeightfield(const FTileGenerationParams& TileGenerationParams, FTileHeightfield& Heightfield_Out, FVector* Normals_Out);
+
+	/**
+	 * Stores the heightfield and the normals of the grid vertices of a tile.
+	 *
+	 * \param TileGenerationParams the parameters of the tile
+	 * \param Heightfield_In the generated heights
+	 * \param Normals_In TileResolution * TileResolution generated normals
+	 */
+	void SaveHeightfield(const FTileGenerationParams& TileGenerationParams, const FTileHeightfield& Heightfield_In, const FVector* Normals_In);
+
+	/**
+	 * Loads the foliage transforms of a single foliage generation component.
+	 *
+	 * \param TileIndex the index of the tile
+	 * \param FoliageName name of the foliage record, includes the hash of the foliage settings
+	 * \param Instances_Out receives one array of transforms per HISM component, must already have the right number of arrays
+	 * \return true if the record exists and matches the number of HISM components
+	 */
+	bool LoadFoliage(FTileIndex TileIndex, const FString& FoliageName, TArray<FTransformArrayA2>& Instances_Out);
+
+	/**
+	 * Stores the foliage transforms of a single foliage generation component.
+	 *
+	 * \param TileIndex the index of the tile
+	 * \param FoliageName name of the foliage record, includes the hash of the foliage settings
+	 * \param Instances_In one array of transforms per HISM component
+	 */
+	void SaveFoliage(FTileIndex TileIndex, const FString& FoliageName, const TArray<FTransformArrayA2>& Instances_In);
+
+	/**
+	 * Number of records that were loaded since the cache was created.
+	 */
+	int GetHitCount() const {
+		return HitCount.load();
+	}
+
+	/**
+	 * Number of records that were requested but did not exist or did not match.
+	 */
+	int GetMissCount() const {
+		return MissCount.load();
+	}
+
+private:
+	//Directory of all records of this cache
+	FString CacheDirectory;
+
+	//Number of loaded records
+	std::atomic<int> HitCount{ 0 };
+
+	//Number of requested records that could not be loaded
+	std::atomic<int> MissCount{ 0 };
+
+	/**
+	 * Builds the path of the heightfield record of a tile.
+	 */
+	FString GetHeightfieldPath(const FTileGenerationParams& TileGenerationParams) const;
+
+	/**
+	 * Builds the path of a foliage record of a tile.
+	 */
+	FString GetFoliagePath(FTileIndex TileIndex, const FString& FoliageName) const;
+};
@@ -3,14 +3,23 @@
 
 #include "TileGenerator.h"
 
+#include "../ProceduralLandscape.h"
+#include "TerrainGraphAsset.h"
+#include "TileDiskCache.h"
+#include "TileMeshBufferPool.h"
 #include "Foliage/FoliageGenerationComponent.h"
+#include "Algo/StableSort.h"
 #include "Math/RandomStream.h"
-#include "HAL/RunnableThread.h"
+#include "Misc/QueuedThreadPool.h"
+#include "GameFramework/Pawn.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/WorldSettings.h"
 
 
 ATileGenerator::ATileGenerator()
 {
 	PrimaryActorTick.bCanEverTick = true;
+	MeshBufferPool = MakeShared<FTileMeshBufferPool, ESPMode::ThreadSafe>();
 }
 
 void ATileGenerator::OnConstruction(const FTransform& Transform) {
@@ -22,176 +31,730 @@ void ATileGenerator::OnConstruction(const FTransform& Transform) {
 void ATileGenerator::BeginPlay()
 {
 	Super::BeginPlay();
-	LastTileIndex = FTileIndex(0, 0);
-	LastGeneratedFoliageInfos = TArray<FGeneratedFoliageInfo>();
 	CenterTileIndex.X = 0;
 	CenterTileIndex.Y = 0;
+	AWorldSettings* WorldSettings = GetWorld()->GetWorldSettings();
+	if (bRebaseWorldOrigin && WorldSettings && !WorldSettings->bEnableWorldOriginRebasing) {
+		UE_LOG(LogProceduralLandscape, Warning, TEXT("%s rebases the world origin, but bEnableWorldOriginRebasing is disabled in the world settings"), *GetName());
+	}
 	InitializeTiles();
 }
 
 void ATileGenerator::Tick(float DeltaSeconds)
 {
 	CurrentUpdateTime += DeltaSeconds;
-	SpawnNewFoliage();
-	DeleteSingleTile();
+	RebaseWorldOrigin();
+	if (FrameBudgetMilliseconds > 0) {
+		if (bUseQuadtree) UpdateQuadtree(QuadtreeNodeBudget);
+		else if (bPrefetchTiles) PrefetchTiles();
+		RunScheduledWork();
+	}
+	else {
+		FinishPendingTiles();
+		if (bUseQuadtree) UpdateQuadtree(QuadtreeNodeBudget);
+		else if (bPrefetchTiles) PrefetchTiles();
+		SpawnNewFoliage();
+		DeleteSingleTile();
+	}
 
-	if (!bIsFoliageThreadFinished) return;
-	InitializeFoliageThread();
+	UpdateFoliageJobs();
+	UpdateStats();
+}
+
+void ATileGenerator::UpdateStats()
+{
+	SET_DWORD_STAT(STAT_ProceduralLandscape_Tiles, Tiles.Num() + QuadtreeNodes.Num());
+	SET_DWORD_STAT(STAT_ProceduralLandscape_TilesPendingMesh, TilesPendingMesh.Num() + TilesPendingMeshUpdate.Num());
+	SET_DWORD_STAT(STAT_ProceduralLandscape_TilesToGenerate, TilesToGenerate.Num());
+	SET_DWORD_STAT(STAT_ProceduralLandscape_TilesToDelete, TilesToDeleteCount);
+	SET_DWORD_STAT(STAT_ProceduralLandscape_PooledTiles, PooledTiles.Num());
+	SET_DWORD_STAT(STAT_ProceduralLandscape_FoliageJobsPending, QueuedFoliageJobs.Num());
+	SET_DWORD_STAT(STAT_ProceduralLandscape_FoliageJobsRunning, RunningFoliageJobs.Num());
+	SET_DWORD_STAT(STAT_ProceduralLandscape_FoliageComponentsToUpdate, FoliageComponentsToUpdate.Num());
+	CSV_CUSTOM_STAT(ProceduralLandscape, TilesPendingMesh, TilesPendingMesh.Num() + TilesPendingMeshUpdate.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ProceduralLandscape, TilesToDelete, TilesToDeleteCount, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ProceduralLandscape, FoliageJobsPending, QueuedFoliageJobs.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ProceduralLandscape, FoliageJobsRunning, RunningFoliageJobs.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ProceduralLandscape, FoliageComponentsToUpdate, FoliageComponentsToUpdate.Num(), ECsvCustomStatOp::Set);
+}
+
+void ATileGenerator::RunScheduledWork()
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(RunScheduledWork);
+	double EndTime = FPlatformTime::Seconds() + FrameBudgetMilliseconds / 1000.0;
+	if (FoliageComponentsToUpdate.Num() > 0) SortFoliageComponentsToUpdate();
+
+	//Every step does the most important piece of work that is available: holes in the landscape first, then missing tiles, foliage and finally the cleanup
+	bool bDidWork = true;
+	while (bDidWork && FPlatformTime::Seconds() < EndTime) {
+		bDidWork = FinishPendingTiles(1) > 0 || GenerateQueuedTile() || SpawnFoliageBatch() || DeleteSingleTile();
+	}
 }
 
 void ATileGenerator::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
-	if (CurrentFoliageThread && RunningThread) {
-		RunningThread->Kill(true);
-		RunningThread->WaitForCompletion();
-		delete CurrentFoliageThread;
+	//The running jobs write into the components of the tiles, so they are finished before the tiles go away
+	for (FFoliageGenerationJob* FoliageJob : RunningFoliageJobs) {
+		FoliageJob->Wait();
+		delete FoliageJob;
 	}
-
-	FFoliageGenerationThread* CurrentThread;
-	while (FoliageGenerationThreads.IsValidIndex(0)) {
-		CurrentThread = FoliageGenerationThreads[0];
-		FoliageGenerationThreads.RemoveAt(0);
-		delete CurrentThread;
+	RunningFoliageJobs.Empty();
+	for (FFoliageGenerationJob* FoliageJob : QueuedFoliageJobs) {
+		delete FoliageJob;
 	}
+	QueuedFoliageJobs.Empty();
+	QueuedFoliageJobsByTile.Empty();
 }
 
 void ATileGenerator::InitializeTiles()
 {
 	DeleteAllTiles();
+	Tiles.Reset(DrawDistance);
 	SetupTileGenerationParams();
-	for (int Row = CenterTileIndex.X - DrawDistance; Row <= CenterTileIndex.X + DrawDistance; ++Row) {
-		for (int Column = CenterTileIndex.Y - DrawDistance; Column <= CenterTileIndex.Y + DrawDistance; ++Column) {
+	DiskCache.Reset();
+	if (bUseDiskCache) DiskCache = MakeShared<FTileDiskCache, ESPMode::ThreadSafe>(FTileDiskCache::GetCacheDirectory(TileGenerationParams, RandomSeed));
+	if (bUseQuadtree) {
+		UpdateQuadtree(MAX_int32);
+		return;
+	}
+	for (int64 Row = CenterTileIndex.X - DrawDistance; Row <= CenterTileIndex.X + DrawDistance; ++Row) {
+		for (int64 Column = CenterTileIndex.Y - DrawDistance; Column <= CenterTileIndex.Y + DrawDistance; ++Column) {
 			FTileIndex CurrentTileIndex(Row, Column);
 			AProceduralTile* CurrentTile = GenerateTile(CurrentTileIndex);
-			GenerateFoliage(CurrentTileIndex, CurrentTile);
+			if (!CurrentTile->IsMeshGenerationPending()) GenerateFoliage(CurrentTileIndex, CurrentTile);
 		}
 	}
-	SortFoliageGenerationThreads();
+	SortFoliageJobs();
 }
 
 FTileGenerationParams ATileGenerator::SetupTileGenerationParams()
 {
-	FRandomStream RandomStream(RandomSeed);
-	TileGenerationParams.TileSize = TileSize;
-	TileGenerationParams.TileResolution = TileResolution;
+	TileGenerationParams = MakeTileGenerationParams(RandomSeed);
+	return TileGenerationParams;
+}
+
+FTileGenerationParams ATileGenerator::MakeTileGenerationParams(int Seed) const
+{
+	FRandomStream RandomStream(Seed);
+	FTileGenerationParams NewTileGenerationParams = TileGenerationParams;
+	NewTileGenerationParams.TileSize = TileSize;
+	NewTileGenerationParams.TileResolution = TileResolution;
+	NewTileGenerationParams.bGenerateSkirts = bUseLODRings;
+	NewTileGenerationParams.SkirtDepth = SkirtDepth;
 
-	TileGenerationParams.MajorNoiseStrength = RandomStream.FRandRange(MajorNoiseStrength - MajorNoiseStrengthDeviation, MajorNoiseStrength + MajorNoiseStrengthDeviation);
+	NewTileGenerationParams.MajorNoiseStrength = RandomStream.FRandRange(MajorNoiseStrength - MajorNoiseStrengthDeviation, MajorNoiseStrength + MajorNoiseStrengthDeviation);
 	float MajorNoiseOffsetX = RandomStream.FRandRange(MajorNoiseOffset.X - MajorNoiseOffsetDeviation, MajorNoiseOffset.X + MajorNoiseOffsetDeviation);
 	float MajorNoiseOffsetY = RandomStream.FRandRange(MajorNoiseOffset.Y - MajorNoiseOffsetDeviation, MajorNoiseOffset.Y + MajorNoiseOffsetDeviation);
-	TileGenerationParams.MinorNoiseOffset = FVector2D(MajorNoiseOffsetX, MajorNoiseOffsetY);
+	NewTileGenerationParams.MinorNoiseOffset = FVector2D(MajorNoiseOffsetX, MajorNoiseOffsetY);
 	float MajorNoiseScaleX = RandomStream.FRandRange(MajorNoiseScale.X - MajorNoiseScaleDeviation, MajorNoiseScale.X + MajorNoiseScaleDeviation);
 	float MajorNoiseScaleY = RandomStream.FRandRange(MajorNoiseScale.Y - MajorNoiseScaleDeviation, MajorNoiseScale.Y + MajorNoiseScaleDeviation);
-	TileGenerationParams.MajorNoiseScale = FVector2D(MajorNoiseScaleX, MajorNoiseScaleY);
+	NewTileGenerationParams.MajorNoiseScale = FVector2D(MajorNoiseScaleX, MajorNoiseScaleY);
 
-	TileGenerationParams.MinorNoiseStrength = RandomStream.FRandRange(MinorNoiseStrength - MinorNoiseStrengthDeviation, MinorNoiseStrength + MinorNoiseStrengthDeviation);
+	NewTileGenerationParams.MinorNoiseStrength = RandomStream.FRandRange(MinorNoiseStrength - MinorNoiseStrengthDeviation, MinorNoiseStrength + MinorNoiseStrengthDeviation);
 	float MinorNoiseOffsetX = RandomStream.FRandRange(MinorNoiseOffset.X - MinorNoiseOffsetDeviation, MinorNoiseOffset.X + MinorNoiseOffsetDeviation);
 	float MinorNoiseOffsetY = RandomStream.FRandRange(MinorNoiseOffset.Y - MinorNoiseOffsetDeviation, MinorNoiseOffset.Y + MinorNoiseOffsetDeviation);
-	TileGenerationParams.MinorNoiseOffset = FVector2D(MinorNoiseOffsetX, MinorNoiseOffsetY);
+	NewTileGenerationParams.MinorNoiseOffset = FVector2D(MinorNoiseOffsetX, MinorNoiseOffsetY);
 	float MinorNoiseScaleX = RandomStream.FRandRange(MinorNoiseScale.X - MinorNoiseScaleDeviation, MinorNoiseScale.X + MinorNoiseScaleDeviation);
 	float MinorNoiseScaleY = RandomStream.FRandRange(MinorNoiseScale.Y - MinorNoiseScaleDeviation, MinorNoiseScale.Y + MinorNoiseScaleDeviation);
-	TileGenerationParams.MinorNoiseScale = FVector2D(MinorNoiseScaleX, MinorNoiseScaleY);
+	NewTileGenerationParams.MinorNoiseScale = FVector2D(MinorNoiseScaleX, MinorNoiseScaleY);
 
-	return TileGenerationParams;
+	//Drawn after the major and minor noise, so enabling the detail noise does not change the other layers
+	NewTileGenerationParams.DetailNoiseOctaves = DetailNoiseOctaves;
+	NewTileGenerationParams.DetailNoiseType = DetailNoiseType;
+	NewTileGenerationParams.DetailNoiseStrength = DetailNoiseStrength;
+	float DetailNoiseOffsetX = RandomStream.FRandRange(DetailNoiseOffset.X - DetailNoiseOffsetDeviation, DetailNoiseOffset.X + DetailNoiseOffsetDeviation);
+	float DetailNoiseOffsetY = RandomStream.FRandRange(DetailNoiseOffset.Y - DetailNoiseOffsetDeviation, DetailNoiseOffset.Y + DetailNoiseOffsetDeviation);
+	NewTileGenerationParams.DetailNoiseOffset = FVector2D(DetailNoiseOffsetX, DetailNoiseOffsetY);
+	NewTileGenerationParams.DetailNoiseScale = DetailNoiseScale;
+	NewTileGenerationParams.DetailNoiseLacunarity = DetailNoiseLacunarity;
+	NewTileGenerationParams.DetailNoiseGain = DetailNoiseGain;
+	NewTileGenerationParams.DetailNoiseWarpStrength = DetailNoiseWarpStrength;
+	NewTileGenerationParams.DetailNoiseWarpScale = DetailNoiseWarpScale;
+	NewTileGenerationParams.TerrainProgram = TerrainGraph ? TerrainGraph->GetProgram() : nullptr;
+
+	return NewTileGenerationParams;
 }
 
 void ATileGenerator::UpdateTiles(FTileIndex NewCenterIndex)
 {
+	PROCEDURAL_LANDSCAPE_SCOPE(UpdateTiles);
+	//The quadtree follows the player location every tick instead of the overlapped tile
+	if (bUseQuadtree) return;
+	if (NewCenterIndex == CenterTileIndex) return;
+	FTileIndex OldCenterIndex = CenterTileIndex;
 	CenterTileIndex = NewCenterIndex;
-	TArray<FTileIndex> TilesToRemove;
-	TArray<FTileIndex> IndicesToGenerate;
-	Tiles.GetKeys(TilesToRemove);
 
-	for (int Row = CenterTileIndex.X - DrawDistance; Row <= CenterTileIndex.X + DrawDistance; ++Row) {
-		for (int Column = CenterTileIndex.Y - DrawDistance; Column <= CenterTileIndex.Y + DrawDistance; ++Column) {
+	//Only the rows and columns that leave or enter the draw distance are touched
+	TArray<FTileIndex> LeavingTileIndices;
+	TArray<FTileIndex> EnteringTileIndices;
+	CollectTilesOutsideSquare(OldCenterIndex, NewCenterIndex, LeavingTileIndices);
+	CollectTilesOutsideSquare(NewCenterIndex, OldCenterIndex, EnteringTileIndices);
+
+	for (FTileIndex& IndexToRemove : LeavingTileIndices) {
+		AProceduralTile* CurrentTile = nullptr;
+		if (Tiles.Remove(IndexToRemove, CurrentTile)) RemoveTile(CurrentTile);
+	}
+
+	TilesToGenerate.RemoveAll([this](const FTileIndex& QueuedTileIndex) {
+		return GetDistanceToCenter(QueuedTileIndex) > DrawDistance;
+	});
+	for (FTileIndex& IndexToAdd : EnteringTileIndices) {
+		if (Tiles.Contains(IndexToAdd)) continue;
+		if (PromotePrefetchedTile(IndexToAdd)) continue;
+		if (FrameBudgetMilliseconds > 0) {
+			TilesToGenerate.Add(IndexToAdd);
+			continue;
+		}
+		AProceduralTile* CurrentTile = GenerateTile(IndexToAdd);
+		if (!CurrentTile->IsMeshGenerationPending()) GenerateFoliage(IndexToAdd, CurrentTile);
+	}
+	TilesToGenerate.StableSort([this](const FTileIndex& A, const FTileIndex& B) {
+		return GetDistanceToCenter(A) < GetDistanceToCenter(B);
+	});
+
+	int Shift = int(FMath::Min<int64>(FMath::Max(FMath::Abs(NewCenterIndex.X - OldCenterIndex.X), FMath::Abs(NewCenterIndex.Y - OldCenterIndex.Y)), DrawDistance));
+	UpdateTilesNearCenter(Shift);
+	SortFoliageJobs();
+}
+
+void ATileGenerator::PrefetchTiles()
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(PrefetchTiles);
+	//Prefetched tiles are generated on worker threads only, a synchronous generation would stall the frame it is meant to relieve
+	if (!ShouldGenerateTilesAsync()) return;
+
+	for (TPair<FTileIndex, AProceduralTile*>& PrefetchedTile : PrefetchedTiles) {
+		//The upload shows the tile, it stays hidden until it enters the draw distance
+		if (PrefetchedTile.Value->IsMeshGenerationPending() && PrefetchedTile.Value->TryFinishMeshGeneration()) {
+			PrefetchedTile.Value->SetActorHiddenInGame(true);
+		}
+	}
+
+	APawn* Observer = UGameplayStatics::GetPlayerPawn(this, 0);
+	FVector Velocity = Observer ? Observer->GetVelocity() : FVector::ZeroVector;
+	Velocity.Z = 0;
+	//How many tiles the player crosses within PrefetchTime
+	int LookaheadDistance = FMath::CeilToInt(Velocity.Size() * PrefetchTime / TileSize);
+
+	//Tiles the player is not heading into anymore are released
+	TArray<FTileIndex> TilesToEvict;
+	for (TPair<FTileIndex, AProceduralTile*>& PrefetchedTile : PrefetchedTiles) {
+		if (GetDistanceToCenter(PrefetchedTile.Key) > DrawDistance + LookaheadDistance + 1) TilesToEvict.Add(PrefetchedTile.Key);
+	}
+	for (FTileIndex& IndexToEvict : TilesToEvict) {
+		AProceduralTile* CurrentTile = nullptr;
+		if (PrefetchedTiles.RemoveAndCopyValue(IndexToEvict, CurrentTile)) RemoveTile(CurrentTile);
+	}
+	if (LookaheadDistance == 0) return;
+
+	//The square around the predicted location, without the tiles that already are within the draw distance
+	FVector PredictedLocation = Observer->GetActorLocation() + Velocity * PrefetchTime;
+	FTileIndex PredictedTileIndex = FTileIndex::FromLocation(PredictedLocation + GetWorldOrigin(), TileSize);
+	TArray<FTileIndex> TileIndicesToPrefetch;
+	CollectTilesOutsideSquare(PredictedTileIndex, CenterTileIndex, TileIndicesToPrefetch);
+	//Tiles on the way are needed first, tiles of the same ring in front of the player before the ones to the side
+	FVector Facing = Observer->GetActorForwardVector();
+	auto GetFacingAlignment = [this, Facing](const FTileIndex& CurrentTileIndex) {
+		return (CurrentTileIndex.X - CenterTileIndex.X) * Facing.X + (CurrentTileIndex.Y - CenterTileIndex.Y) * Facing.Y;
+	};
+	Algo::StableSort(TileIndicesToPrefetch, [this, &GetFacingAlignment](const FTileIndex& A, const FTileIndex& B) {
+		int DistanceA = GetDistanceToCenter(A);
+		int DistanceB = GetDistanceToCenter(B);
+		if (DistanceA != DistanceB) return DistanceA < DistanceB;
+		return GetFacingAlignment(A) > GetFacingAlignment(B);
+	});
+
+	int PrefetchBudget = PrefetchTilesPerFrame;
+	for (FTileIndex& IndexToPrefetch : TileIndicesToPrefetch) {
+		if (PrefetchBudget <= 0 || PrefetchedTiles.Num() >= MaxPrefetchedTiles) break;
+		if (Tiles.Contains(IndexToPrefetch) || PrefetchedTiles.Contains(IndexToPrefetch)) continue;
+		AProceduralTile* CurrentTile = SpawnTile(GetTileGenerationParams(IndexToPrefetch), ShouldTileHaveCollision(IndexToPrefetch));
+		CurrentTile->SetActorHiddenInGame(true);
+		PrefetchedTiles.Add(IndexToPrefetch, CurrentTile);
+		--PrefetchBudget;
+	}
+}
+
+bool ATileGenerator::PromotePrefetchedTile(FTileIndex CurrentTileIndex)
+{
+	AProceduralTile* CurrentTile = nullptr;
+	if (!PrefetchedTiles.RemoveAndCopyValue(CurrentTileIndex, CurrentTile)) return false;
+	StoreTile(CurrentTileIndex, CurrentTile);
+	if (CurrentTile->IsMeshGenerationPending()) {
+		//Shown and given foliage by FinishPendingTiles like every other new tile
+		TilesPendingMesh.Add(CurrentTile);
+	}
+	else {
+		CurrentTile->SetActorHiddenInGame(false);
+		GenerateFoliage(CurrentTileIndex, CurrentTile);
+	}
+	return true;
+}
+
+void ATileGenerator::CollectTilesOutsideSquare(FTileIndex SquareCenterIndex, FTileIndex OtherCenterIndex, TArray<FTileIndex>& TileIndices_Out)
+{
+	int64 OtherMinY = OtherCenterIndex.Y - DrawDistance;
+	int64 OtherMaxY = OtherCenterIndex.Y + DrawDistance;
+	int64 MinY = SquareCenterIndex.Y - DrawDistance;
+	int64 MaxY = SquareCenterIndex.Y + DrawDistance;
+	for (int64 Row = SquareCenterIndex.X - DrawDistance; Row <= SquareCenterIndex.X + DrawDistance; ++Row) {
+		if (FMath::Abs(Row - OtherCenterIndex.X) > DrawDistance) {
+			for (int64 Column = MinY; Column <= MaxY; ++Column) {
+				TileIndices_Out.Add(FTileIndex(Row, Column));
+			}
+			continue;
+		}
+		//The row is shared, only the columns in front of and behind the other square are outside
+		for (int64 Column = MinY; Column <= FMath::Min(MaxY, OtherMinY - 1); ++Column) {
+			TileIndices_Out.Add(FTileIndex(Row, Column));
+		}
+		for (int64 Column = FMath::Max(MinY, OtherMaxY + 1); Column <= MaxY; ++Column) {
+			TileIndices_Out.Add(FTileIndex(Row, Column));
+		}
+	}
+}
+
+void ATileGenerator::UpdateTilesNearCenter(int Shift)
+{
+	//Collision and level of detail only change for tiles that are close to the old or the new center
+	int Radius = -1;
+	if (bLimitCollisionDistance) Radius = FMath::Max(Radius, CollisionDistance);
+	if (bUseLODRings) Radius = FMath::Max(Radius, FMath::Max(LODRingWidth, 1) * (FMath::Max(LODLevelCount, 1) - 1));
+	if (Radius < 0) return;
+	Radius = FMath::Min(Radius + Shift, DrawDistance);
+
+	for (int64 Row = CenterTileIndex.X - Radius; Row <= CenterTileIndex.X + Radius; ++Row) {
+		for (int64 Column = CenterTileIndex.Y - Radius; Column <= CenterTileIndex.Y + Radius; ++Column) {
 			FTileIndex CurrentTileIndex(Row, Column);
-			if (Tiles.Find(CurrentTileIndex)) {
-				TilesToRemove.Remove(CurrentTileIndex);
+			AProceduralTile* ExistingTile = Tiles.Find(CurrentTileIndex);
+			if (!ExistingTile) continue;
+			ExistingTile->SetMeshCollisionEnabled(ShouldTileHaveCollision(CurrentTileIndex));
+			if (ExistingTile->GetMeshResolution() != GetTileResolution(CurrentTileIndex)) {
+				UpdateTileMesh(ExistingTile);
 			}
-			else if(!Tiles.Find(CurrentTileIndex)) {
-				AProceduralTile* CurrentTile = GenerateTile(CurrentTileIndex);			
-				GenerateFoliage(CurrentTileIndex, CurrentTile);
+		}
+	}
+}
+
+int ATileGenerator::GetDistanceToCenter(FTileIndex CurrentTileIndex)
+{
+	//Tiles far away from the center are all equally far, the distance is only used to sort and to compare with the draw distance
+	return int(FMath::Min<int64>(FMath::Max(FMath::Abs(CurrentTileIndex.X - CenterTileIndex.X), FMath::Abs(CurrentTileIndex.Y - CenterTileIndex.Y)), MAX_int32));
+}
+
+void ATileGenerator::RemoveTile(AProceduralTile* CurrentTile)
+{
+	//Queued foliage jobs are only flagged here, they are deleted by the next SortFoliageJobs
+	FFoliageGenerationJob** QueuedFoliageJob = QueuedFoliageJobsByTile.Find(CurrentTile->GetTileIndex());
+	if (QueuedFoliageJob && (*QueuedFoliageJob)->GetTile() == CurrentTile) {
+		(*QueuedFoliageJob)->Cancel();
+		QueuedFoliageJobsByTile.Remove(CurrentTile->GetTileIndex());
+	}
+	//A running job finishes on its own, its result is dropped by UpdateFoliageJobs
+	for (FFoliageGenerationJob* FoliageJob : RunningFoliageJobs) {
+		if (FoliageJob->GetTile() == CurrentTile) FoliageJob->Cancel();
+	}
+	FoliageComponentsToUpdate.RemoveAll([CurrentTile](UFoliageGenerationComponent* Component) {
+		return Component->GetOwner() == CurrentTile;
+	});
+	TilesPendingMesh.Remove(CurrentTile);
+	TilesPendingMeshUpdate.Remove(CurrentTile);
+	CurrentTile->MarkToDelete();
+	TilesToDelete.Enqueue(CurrentTile);
+	++TilesToDeleteCount;
+}
+
+void ATileGenerator::UpdateQuadtree(int NodeBudget)
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(UpdateQuadtree);
+	FTileIndex ObserverTileIndex = GetObserverTileIndex();
+	if (ObserverTileIndex != CenterTileIndex) {
+		CenterTileIndex = ObserverTileIndex;
+		bIsQuadtreeDirty = true;
+	}
+
+	if (bIsQuadtreeDirty) {
+		bIsQuadtreeDirty = false;
+		VisibleQuadtreeNodes.Reset();
+		//Root nodes are aligned to multiples of their scale, so every node covers the same tiles no matter where the player is
+		int RootScale = 1 << QuadtreeDepth;
+		int64 RootX = (CenterTileIndex.X >> QuadtreeDepth) * RootScale;
+		int64 RootY = (CenterTileIndex.Y >> QuadtreeDepth) * RootScale;
+		for (int Row = -QuadtreeRootDistance; Row <= QuadtreeRootDistance; ++Row) {
+			for (int Column = -QuadtreeRootDistance; Column <= QuadtreeRootDistance; ++Column) {
+				FTileIndex RootTileIndex(RootX + Row * RootScale, RootY + Column * RootScale);
+				CollectVisibleQuadtreeNodes(FQuadtreeNodeKey(RootTileIndex, RootScale), VisibleQuadtreeNodes);
 			}
 		}
+		VisibleQuadtreeNodes.Sort([this](const FQuadtreeNodeKey& A, const FQuadtreeNodeKey& B) {
+			return GetQuadtreeNodeDistance(A) < GetQuadtreeNodeDistance(B);
+		});
+
+		//Only the smallest nodes have collision, the player is always located on one of them
+		for (TPair<FQuadtreeNodeKey, AProceduralTile*>& Node : QuadtreeNodes) {
+			Node.Value->SetMeshCollisionEnabled(Node.Key.Scale == 1 && ShouldTileHaveCollision(Node.Key.MinTileIndex));
+		}
+	}
+
+	bool bFoliageChanged = false;
+	int ExistingVisibleNodeCount = 0;
+	for (const FQuadtreeNodeKey& Node : VisibleQuadtreeNodes) {
+		if (QuadtreeNodes.Contains(Node)) {
+			++ExistingVisibleNodeCount;
+			continue;
+		}
+		if (NodeBudget <= 0) continue;
+		AProceduralTile* CurrentTile = GenerateQuadtreeNode(Node);
+		--NodeBudget;
+		++ExistingVisibleNodeCount;
+		if (Node.Scale == 1 && !CurrentTile->IsMeshGenerationPending()) {
+			GenerateFoliage(Node.MinTileIndex, CurrentTile);
+			bFoliageChanged = true;
+		}
 	}
-	for (FTileIndex& IndexToRemove : TilesToRemove) {
-		AProceduralTile* CurrentTile = *Tiles.Find(IndexToRemove);
-		int i = 0;
-		while (i < FoliageGenerationThreads.Num()) {
-			if (FoliageGenerationThreads[i]->GetTileIndex() == IndexToRemove) {
-				delete FoliageGenerationThreads[i];
-				FoliageGenerationThreads.RemoveAt(i);
-				continue;
+
+	//Nodes that are no longer visible are kept until every node that replaces them is uploaded, so no holes appear while splitting or merging
+	if (QuadtreeNodes.Num() > ExistingVisibleNodeCount) {
+		TArray<FQuadtreeNodeKey> NodesToRemove;
+		for (TPair<FQuadtreeNodeKey, AProceduralTile*>& Node : QuadtreeNodes) {
+			bool bIsReplaced = true;
+			for (const FQuadtreeNodeKey& VisibleNode : VisibleQuadtreeNodes) {
+				if (VisibleNode == Node.Key || (VisibleNode.Overlaps(Node.Key) && !IsQuadtreeNodeReady(VisibleNode))) {
+					bIsReplaced = false;
+					break;
+				}
 			}
-			++i;
+			if (bIsReplaced) NodesToRemove.Add(Node.Key);
+		}
+		for (FQuadtreeNodeKey& NodeToRemove : NodesToRemove) {
+			RemoveTile(*QuadtreeNodes.Find(NodeToRemove));
+			QuadtreeNodes.Remove(NodeToRemove);
+			bFoliageChanged = true;
+		}
+	}
+	if (bFoliageChanged) SortFoliageJobs();
+}
+
+void ATileGenerator::CollectVisibleQuadtreeNodes(FQuadtreeNodeKey Node, TArray<FQuadtreeNodeKey>& Nodes_Out)
+{
+	if (Node.Scale <= 1 || GetQuadtreeNodeDistance(Node) >= Node.Scale * QuadtreeSplitDistance) {
+		Nodes_Out.Add(Node);
+		return;
+	}
+	int ChildScale = Node.Scale / 2;
+	for (int Row = 0; Row < 2; ++Row) {
+		for (int Column = 0; Column < 2; ++Column) {
+			FTileIndex ChildTileIndex(Node.MinTileIndex.X + Row * ChildScale, Node.MinTileIndex.Y + Column * ChildScale);
+			CollectVisibleQuadtreeNodes(FQuadtreeNodeKey(ChildTileIndex, ChildScale), Nodes_Out);
 		}
-		CurrentTile->MarkToDelete();
-		TilesToDelete.Enqueue(CurrentTile);
-		Tiles.Remove(IndexToRemove);
 	}
-	SortFoliageGenerationThreads();
+}
+
+float ATileGenerator::GetQuadtreeNodeDistance(FQuadtreeNodeKey Node)
+{
+	int64 XDistance = FMath::Max3<int64>(Node.MinTileIndex.X - CenterTileIndex.X, CenterTileIndex.X - (Node.MinTileIndex.X + Node.Scale - 1), 0);
+	int64 YDistance = FMath::Max3<int64>(Node.MinTileIndex.Y - CenterTileIndex.Y, CenterTileIndex.Y - (Node.MinTileIndex.Y + Node.Scale - 1), 0);
+	return float(FMath::Sqrt(double(XDistance) * XDistance + double(YDistance) * YDistance));
+}
+
+AProceduralTile* ATileGenerator::GenerateQuadtreeNode(FQuadtreeNodeKey Node)
+{
+	FTileGenerationParams NodeGenerationParams = TileGenerationParams;
+	NodeGenerationParams.TileIndex = Node.MinTileIndex;
+	NodeGenerationParams.TileResolution = TileResolution;
+	NodeGenerationParams.LODScale = Node.Scale;
+	NodeGenerationParams.bGenerateSkirts = true;
+	//Larger nodes deviate further from the real terrain, so their skirts have to reach further down
+	NodeGenerationParams.SkirtDepth = SkirtDepth * Node.Scale;
+
+	AProceduralTile* CurrentTile = SpawnTile(NodeGenerationParams, Node.Scale == 1 && ShouldTileHaveCollision(Node.MinTileIndex));
+	if (CurrentTile->IsMeshGenerationPending()) TilesPendingMesh.Add(CurrentTile);
+	QuadtreeNodes.Add(Node, CurrentTile);
+	return CurrentTile;
+}
+
+bool ATileGenerator::IsQuadtreeNodeReady(FQuadtreeNodeKey Node)
+{
+	AProceduralTile** CurrentTile = QuadtreeNodes.Find(Node);
+	return CurrentTile && !(*CurrentTile)->IsMeshGenerationPending();
+}
+
+FVector ATileGenerator::GetWorldOrigin() const
+{
+	UWorld* World = GetWorld();
+	return World ? FVector(World->OriginLocation) : FVector::ZeroVector;
+}
+
+void ATileGenerator::RebaseWorldOrigin()
+{
+	//The foliage is placed relative to its tile on its own copy of the heights, running foliage jobs do not depend on the origin
+	if (!bRebaseWorldOrigin) return;
+	UWorld* World = GetWorld();
+	APawn* Observer = World && World->IsGameWorld() ? UGameplayStatics::GetPlayerPawn(this, 0) : nullptr;
+	if (!Observer) return;
+	AWorldSettings* WorldSettings = World->GetWorldSettings();
+	if (!WorldSettings || !WorldSettings->bEnableWorldOriginRebasing) return;
+
+	FVector ObserverLocation = Observer->GetActorLocation();
+	if (FVector2D(ObserverLocation).Size() < RebaseDistance) return;
+	//Only X and Y are rebased, the heights of the terrain stay in place. The origin itself is stored in 32 bits
+	FVector NewOrigin = FVector(World->OriginLocation) + FVector(ObserverLocation.X, ObserverLocation.Y, 0);
+	if (FMath::Abs(NewOrigin.X) >= MAX_int32 || FMath::Abs(NewOrigin.Y) >= MAX_int32) return;
+	FIntVector NewOriginLocation(FMath::RoundToInt(NewOrigin.X), FMath::RoundToInt(NewOrigin.Y), World->OriginLocation.Z);
+	if (!World->SetNewWorldOrigin(NewOriginLocation)) {
+		UE_LOG(LogProceduralLandscape, Verbose, TEXT("Rebasing the world origin to %s was deferred"), *NewOriginLocation.ToString());
+	}
+}
+
+FTileIndex ATileGenerator::GetObserverTileIndex()
+{
+	UWorld* World = GetWorld();
+	APawn* Observer = World && World->IsGameWorld() ? UGameplayStatics::GetPlayerPawn(this, 0) : nullptr;
+	if (!Observer) return CenterTileIndex;
+	//Tiles are centered on their index, the index is derived from the location before the origin was rebased
+	return FTileIndex::FromLocation(Observer->GetActorLocation() + GetWorldOrigin(), TileSize);
 }
 
 AProceduralTile* ATileGenerator::GenerateTile(FTileIndex CurrentTileIndex)
 {
-	TileGenerationParams.TileIndex = CurrentTileIndex;
-	FVector TileLocation(CurrentTileIndex.X * TileSize, CurrentTileIndex.Y * TileSize, 0);
-	FActorSpawnParameters SpawnParams;
-	AProceduralTile* CurrentTile = GetWorld()->SpawnActor<AProceduralTile>(TileLocation, GetActorRotation(), SpawnParams);
-	CurrentTile->Setup(this, PlayerClass, LandscapeMaterial, bGenerateTrees, bGenerateGrass, bGenerateBushes);
-	CurrentTile->GenerateTile(TileGenerationParams);
-	FString TileName = FString::Printf(TEXT("TILE %d,%d"), CurrentTileIndex.X, CurrentTileIndex.Y);
+	AProceduralTile* CurrentTile = SpawnTile(GetTileGenerationParams(CurrentTileIndex), ShouldTileHaveCollision(CurrentTileIndex));
+	if (CurrentTile->IsMeshGenerationPending()) TilesPendingMesh.Add(CurrentTile);
+	StoreTile(CurrentTileIndex, CurrentTile);
+	return CurrentTile;
+}
+
+void ATileGenerator::StoreTile(FTileIndex CurrentTileIndex, AProceduralTile* CurrentTile)
+{
+	//Only happens if a tile outside the draw distance was not removed, it would be unreachable otherwise
+	if (AProceduralTile* EvictedTile = Tiles.Add(CurrentTileIndex, CurrentTile)) RemoveTile(EvictedTile);
+	Tiles.UpdateFlags(CurrentTileIndex, CurrentTile->IsMeshGenerationPending() ? ETileSlotFlags::Meshing : ETileSlotFlags::Ready);
+}
+
+AProceduralTile* ATileGenerator::SpawnTile(FTileGenerationParams CurrentTileGenerationParams, bool bHasCollision)
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(SpawnTile);
+	FTileIndex CurrentTileIndex = CurrentTileGenerationParams.TileIndex;
+	//The mesh center is exact in double precision, the tile is placed relative to the current world origin
+	FVector TileLocation = FVector(CurrentTileGenerationParams.GetMeshCenterX(), CurrentTileGenerationParams.GetMeshCenterY(), 0) - GetWorldOrigin();
+	AProceduralTile* CurrentTile = nullptr;
+	//Recycled tiles still have a mesh section, it is updated in place if the vertex count did not change
+	bool bIsRecycled = PooledTiles.Num() > 0;
+	if (bIsRecycled) {
+		CurrentTile = PooledTiles.Pop(false);
+		if (!CurrentTile->SetActorLocation(TileLocation, false, nullptr, ETeleportType::TeleportPhysics)) {
+			UE_LOG(LogProceduralLandscape, Warning, TEXT("Could not move the pooled tile %s to %lld,%lld"), *CurrentTile->GetName(), CurrentTileIndex.X, CurrentTileIndex.Y);
+		}
+	}
+	else {
+		FActorSpawnParameters SpawnParams;
+		CurrentTile = GetWorld()->SpawnActor<AProceduralTile>(TileLocation, GetActorRotation(), SpawnParams);
+	}
+	//Foliage is only generated for tiles at full detail
+	bool bIsFullDetail = CurrentTileGenerationParams.LODScale == 1;
+	CurrentTile->Setup(this, PlayerClass, LandscapeMaterial, bGenerateTrees && bIsFullDetail, bGenerateGrass && bIsFullDetail, bGenerateBushes && bIsFullDetail);
+	CurrentTile->SetMeshCollisionEnabled(bHasCollision);
+	if (ShouldGenerateTilesAsync()) {
+		CurrentTile->GenerateTileAsync(CurrentTileGenerationParams, bIsRecycled, MeshBufferPool, DiskCache);
+	}
+	else {
+		CurrentTile->GenerateTile(CurrentTileGenerationParams, bIsRecycled, MeshBufferPool, DiskCache);
+	}
+	FString TileName = bIsFullDetail ? FString::Printf(TEXT("TILE %lld,%lld"), CurrentTileIndex.X, CurrentTileIndex.Y)
+		: FString::Printf(TEXT("NODE %lld,%lld x%d"), CurrentTileIndex.X, CurrentTileIndex.Y, CurrentTileGenerationParams.LODScale);
 	CurrentTile->SetActorLabel(TileName);
 	return CurrentTile;
 }
 
-void ATileGenerator::GenerateFoliage(FTileIndex CurrentTileIndex, AProceduralTile* CurrentTile)
+void ATileGenerator::UpdateTileMesh(AProceduralTile* CurrentTile)
 {
-	TArray <FGeneratedFoliageInfo> GeneratedFoliage;
-	if (bGenerateTrees) {
-		CurrentTile->GetTreeGenerationComponent()->SetupFoliageGeneration(CurrentTileIndex, TreeData, TreeSpawnCount, TreeMaxTries, TreeBatchSize, RandomSeed, true, bUseCulling, FoliageCullDistance, true);
-		FFoliageGenerationThread* NewThread = new FFoliageGenerationThread(CurrentTile->GetTreeGenerationComponent(), this, CurrentTileIndex, TileSize, CurrentTile->GetMaxZPosition(), CurrentTile->GetMinZPosition());
-		FoliageGenerationThreads.Add(NewThread);
+	FTileGenerationParams CurrentTileGenerationParams = GetTileGenerationParams(CurrentTile->GetTileIndex());
+	if (ShouldGenerateTilesAsync()) {
+		CurrentTile->GenerateTileAsync(CurrentTileGenerationParams, true, MeshBufferPool, DiskCache);
+		//New tiles that are still pending start their foliage once the latest mesh is uploaded
+		if (!EnumHasAnyFlags(Tiles.GetFlags(CurrentTile->GetTileIndex()), ETileSlotFlags::Meshing)) TilesPendingMeshUpdate.AddUnique(CurrentTile);
+	}
+	else {
+		CurrentTile->GenerateTile(CurrentTileGenerationParams, true, MeshBufferPool, DiskCache);
 	}
+}
 
-	if (bGenerateBushes) {
-		CurrentTile->GetBushGenerationComponent()->SetupFoliageGeneration(CurrentTileIndex, BushData, BushSpawnCount, BushMaxTries, BushBatchSize, RandomSeed, true, bUseCulling, FoliageCullDistance, false);
-		FFoliageGenerationThread* NewThread = new FFoliageGenerationThread(CurrentTile->GetBushGenerationComponent(), this, CurrentTileIndex, TileSize, CurrentTile->GetMaxZPosition(), CurrentTile->GetMinZPosition());
-		FoliageGenerationThreads.Add(NewThread);
+FTileGenerationParams ATileGenerator::GetTileGenerationParams(FTileIndex CurrentTileIndex)
+{
+	FTileGenerationParams CurrentTileGenerationParams = TileGenerationParams;
+	CurrentTileGenerationParams.TileIndex = CurrentTileIndex;
+	CurrentTileGenerationParams.TileResolution = GetTileResolution(CurrentTileIndex);
+	return CurrentTileGenerationParams;
+}
+
+int ATileGenerator::GetTileResolution(FTileIndex CurrentTileIndex)
+{
+	if (!bUseLODRings) return TileResolution;
+	int Ring = GetDistanceToCenter(CurrentTileIndex);
+	int LODLevel = FMath::Min(Ring / FMath::Max(LODRingWidth, 1), FMath::Max(LODLevelCount, 1) - 1);
+	return GetLODResolution(LODLevel);
+}
+
+int ATileGenerator::GetLODResolution(int LODLevel) const
+{
+	return FMath::Max(((TileResolution - 1) >> LODLevel) + 1, 2);
+}
+
+int ATileGenerator::FinishPendingTiles(int MaxTileCount)
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(FinishPendingTiles);
+	int FinishedTileCount = 0;
+	int j = 0;
+	while (j < TilesPendingMeshUpdate.Num() && FinishedTileCount < MaxTileCount) {
+		if (TilesPendingMeshUpdate[j]->TryFinishMeshGeneration()) {
+			TilesPendingMeshUpdate.RemoveAt(j);
+			++FinishedTileCount;
+			continue;
+		}
+		++j;
+	}
+
+	bool bStartedFoliage = false;
+	int i = 0;
+	while (i < TilesPendingMesh.Num() && FinishedTileCount < MaxTileCount) {
+		AProceduralTile* CurrentTile = TilesPendingMesh[i];
+		if (CurrentTile->TryFinishMeshGeneration()) {
+			TilesPendingMesh.RemoveAt(i);
+			++FinishedTileCount;
+			if (Tiles.Find(CurrentTile->GetTileIndex()) == CurrentTile) Tiles.UpdateFlags(CurrentTile->GetTileIndex(), ETileSlotFlags::Ready, ETileSlotFlags::Meshing);
+			if (CurrentTile->GetLODScale() == 1) {
+				GenerateFoliage(CurrentTile->GetTileIndex(), CurrentTile);
+				bStartedFoliage = true;
+			}
+			continue;
+		}
+		++i;
 	}
+	if (bStartedFoliage) SortFoliageJobs();
+	return FinishedTileCount;
+}
 
-	if (bGenerateGrass) {
-		CurrentTile->GetGrassGenerationComponent()->SetupFoliageGeneration(CurrentTileIndex, GrassData, GrassSpawnCount, GrassMaxTries, GrassBatchSize, RandomSeed, false, bUseCulling, FoliageCullDistance, false);
-		FFoliageGenerationThread* NewThread = new FFoliageGenerationThread(CurrentTile->GetGrassGenerationComponent(), this, CurrentTileIndex, TileSize, CurrentTile->GetMaxZPosition(), CurrentTile->GetMinZPosition());
-		FoliageGenerationThreads.Add(NewThread);
+bool ATileGenerator::GenerateQueuedTile()
+{
+	if (TilesToGenerate.Num() == 0) return false;
+	FTileIndex CurrentTileIndex = TilesToGenerate[0];
+	TilesToGenerate.RemoveAt(0);
+	AProceduralTile* CurrentTile = GenerateTile(CurrentTileIndex);
+	if (!CurrentTile->IsMeshGenerationPending()) {
+		GenerateFoliage(CurrentTileIndex, CurrentTile);
+		SortFoliageJobs();
 	}
-	Tiles.Add(CurrentTileIndex, CurrentTile);
+	return true;
+}
+
+int ATileGenerator::GetMeshBufferAllocationCount() const
+{
+	return MeshBufferPool->GetAllocationCount();
+}
+
+int ATileGenerator::GetDiskCacheHitCount() const
+{
+	return DiskCache.IsValid() ? DiskCache->GetHitCount() : 0;
 }
 
-void ATileGenerator::InitializeFoliageThread()
+int ATileGenerator::GetDiskCacheMissCount() const
 {
-	if (RunningThread && CurrentFoliageThread) {
-		UFoliageGenerationComponent* CurrentFoliageGenerationComponent = CurrentFoliageThread->GetFoliageGenerationComponent();
-		LastTileIndex = CurrentFoliageThread->GetTileIndex();
-		LastGeneratedFoliageInfos = CurrentFoliageThread->GetFoliageInfos();
-		if (FoliageComponentsToUpdate.Find(CurrentFoliageGenerationComponent) < 0) {
-			FoliageComponentsToUpdate.Add(CurrentFoliageGenerationComponent);
+	return DiskCache.IsValid() ? DiskCache->GetMissCount() : 0;
+}
+
+bool ATileGenerator::ShouldTileHaveCollision(FTileIndex CurrentTileIndex)
+{
+	if (!bLimitCollisionDistance) return true;
+	return GetDistanceToCenter(CurrentTileIndex) <= CollisionDistance;
+}
+
+bool ATileGenerator::ShouldGenerateTilesAsync()
+{
+	return bGenerateTilesAsync && GetWorld() && GetWorld()->IsGameWorld();
+}
+
+void ATileGenerator::GenerateFoliage(FTileIndex CurrentTileIndex, AProceduralTile* CurrentTile)
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(StartFoliageGeneration);
+	//Quadtree nodes are not stored in the tile slots, resident tiles only queue their foliage once
+	if (Tiles.Find(CurrentTileIndex) == CurrentTile) {
+		if (EnumHasAnyFlags(Tiles.GetFlags(CurrentTileIndex), ETileSlotFlags::Foliage)) return;
+		Tiles.UpdateFlags(CurrentTileIndex, ETileSlotFlags::Foliage);
+	}
+	//Trees are placed first, so bushes and grass avoid them. The components are set up when their job starts,
+	//a running job of the same tile still uses them until then
+	TArray<UFoliageGenerationComponent*> FoliageGenerationComponents;
+	if (bGenerateTrees) FoliageGenerationComponents.Add(CurrentTile->GetTreeGenerationComponent());
+	if (bGenerateBushes) FoliageGenerationComponents.Add(CurrentTile->GetBushGenerationComponent());
+	if (bGenerateGrass) FoliageGenerationComponents.Add(CurrentTile->GetGrassGenerationComponent());
+	if (FoliageGenerationComponents.Num() == 0) return;
+	//Foliage is always placed on the full resolution ground, the heights of a mesh in a coarser LOD ring are not reused
+	//so ring updates do not need to place the foliage again
+	FTileGenerationParams GroundGenerationParams = GetTileGenerationParams(CurrentTileIndex);
+	GroundGenerationParams.TileResolution = TileResolution;
+	FTileHeightfieldPtr GroundHeightfield = CurrentTile->GetMeshResolution() == TileResolution ? CurrentTile->GetGroundHeightfield() : nullptr;
+	AddFoliageJob(new FFoliageGenerationJob(CurrentTile, CurrentTileIndex, FoliageGenerationComponents, TileSize, GroundGenerationParams.GetTerrainTileParams(), GroundHeightfield));
+}
+
+void ATileGenerator::UpdateFoliageJobs()
+{
+	PROCEDURAL_LANDSCAPE_SCOPE(UpdateFoliageJobs);
+	RunningFoliageJobs.RemoveAll([this](FFoliageGenerationJob* FoliageJob) {
+		if (!FoliageJob->IsFinished()) return false;
+		AProceduralTile* CurrentTile = FoliageJob->GetTile();
+		bool bIsTileRemoved = FoliageJob->IsCancelled() || CurrentTile->IsMarkedToDelete();
+		for (UFoliageGenerationComponent* FoliageGenerationComponent : FoliageJob->GetFoliageGenerationComponents()) {
+			if (!bIsTileRemoved && FoliageComponentsToUpdate.Find(FoliageGenerationComponent) < 0) {
+				FoliageComponentsToUpdate.Add(FoliageGenerationComponent);
+			}
+		}
+		delete FoliageJob;
+		return true;
+	});
+
+	int MaxJobs = GetMaxFoliageJobs();
+	for (int i = 0; i < QueuedFoliageJobs.Num() && RunningFoliageJobs.Num() < MaxJobs;) {
+		FFoliageGenerationJob* FoliageJob = QueuedFoliageJobs[i];
+		if (FoliageJob->IsCancelled()) {
+			QueuedFoliageJobs.RemoveAt(i);
+			delete FoliageJob;
+			continue;
+		}
+		//The components of a tile are used by one job at a time, a newer job waits for the older one
+		if (IsTileUsedByFoliageJob(FoliageJob->GetTile())) {
+			++i;
+			continue;
+		}
+		QueuedFoliageJobs.RemoveAt(i);
+		QueuedFoliageJobsByTile.Remove(FoliageJob->GetTileIndex());
+		SetupFoliageJob(FoliageJob);
+		FoliageJob->Start();
+		RunningFoliageJobs.Add(FoliageJob);
+	}
+}
+
+int ATileGenerator::GetMaxFoliageJobs()
+{
+	if (MaxFoliageJobs > 0) return MaxFoliageJobs;
+	int WorkerCount = GThreadPool ? GThreadPool->GetNumThreads() : 1;
+	return FMath::Max(WorkerCount - 1, 1);
+}
+
+void ATileGenerator::SetupFoliageJob(FFoliageGenerationJob* FoliageJob)
+{
+	AProceduralTile* CurrentTile = FoliageJob->GetTile();
+	FTileIndex CurrentTileIndex = FoliageJob->GetTileIndex();
+	for (UFoliageGenerationComponent* FoliageGenerationComponent : FoliageJob->GetFoliageGenerationComponents()) {
+		if (FoliageGenerationComponent == CurrentTile->GetTreeGenerationComponent()) {
+			FoliageGenerationComponent->SetupFoliageGeneration(CurrentTileIndex, TreeData, TreeSpawnCount, TreeMaxTries, TreeBatchSize, RandomSeed, true, bUseCulling, FoliageCullDistance, true, DiskCache, TreePlacementType);
 		}
-		delete CurrentFoliageThread;
-		RunningThread = nullptr;
-	}
-	else if (FoliageGenerationThreads.IsValidIndex(0)) {
-		CurrentFoliageThread = FoliageGenerationThreads[0];
-		FoliageGenerationThreads.RemoveAt(0);
-		if (LastTileIndex == CurrentFoliageThread->GetTileIndex()) {
-			CurrentFoliageThread->SetFoliageInfos(LastGeneratedFoliageInfos);
+		else if (FoliageGenerationComponent == CurrentTile->GetBushGenerationComponent()) {
+			FoliageGenerationComponent->SetupFoliageGeneration(CurrentTileIndex, BushData, BushSpawnCount, BushMaxTries, BushBatchSize, RandomSeed, true, bUseCulling, FoliageCullDistance, false, DiskCache, BushPlacementType);
 		}
 		else {
-			CurrentFoliageThread->SetFoliageInfos(TArray<FGeneratedFoliageInfo>());
+			FoliageGenerationComponent->SetupFoliageGeneration(CurrentTileIndex, GrassData, GrassSpawnCount, GrassMaxTries, GrassBatchSize, RandomSeed, false, bUseCulling, FoliageCullDistance, false, DiskCache);
 		}
-		bIsFoliageThreadFinished = false;
-		CurrentFoliageThread->GetFoliageGenerationComponent()->SetVisibility(false, true);
-		RunningThread = FRunnableThread::Create(CurrentFoliageThread, TEXT("FoliageGeneration"));
+		FoliageGenerationComponent->SetVisibility(false, true);
 	}
 }
 
@@ -199,76 +762,115 @@ void ATileGenerator::SpawnNewFoliage()
 {
 	if (CurrentUpdateTime >= FoliageUpdateCooldown && FoliageComponentsToUpdate.Num() > 0) {
 		SortFoliageComponentsToUpdate();
-		UFoliageGenerationComponent* CurrentFoliageComponent = FoliageComponentsToUpdate[0];
-		if (FoliageComponentsToUpdate[0]->UpdateFoliage()) {
-			FoliageComponentsToUpdate[0]->SetVisibility(true, true);
-			FoliageComponentsToUpdate.RemoveAt(0);
-		}
+		SpawnFoliageBatch();
 		CurrentUpdateTime = 0;
 	}
 }
 
-void ATileGenerator::SortFoliageGenerationThreads()
+bool ATileGenerator::SpawnFoliageBatch()
 {
-	TArray<FFoliageGenerationThread*> SortedArray;
-
-	for (FFoliageGenerationThread* CurrentThread : FoliageGenerationThreads) {
-		int CurrentIndex = 0;
-		int CurrentXDistance = FMath::Abs(CurrentThread->GetTileIndex().X - CenterTileIndex.X);
-		int CurrentYDistance = FMath::Abs(CurrentThread->GetTileIndex().Y - CenterTileIndex.Y);
-		int CurrentDistance = FMath::Max(CurrentXDistance, CurrentYDistance);
-		while (CurrentIndex < SortedArray.Num()) {
-			int OtherXDistance = FMath::Abs(SortedArray[CurrentIndex]->GetTileIndex().X - CenterTileIndex.X);
-			int OtherYDistance = FMath::Abs(SortedArray[CurrentIndex]->GetTileIndex().Y - CenterTileIndex.Y);
-			int OtherDistance = FMath::Max(OtherXDistance, OtherYDistance);
-			if (CurrentDistance < OtherDistance) break;
-			CurrentIndex += 1;
-		}
-		SortedArray.Insert(CurrentThread, CurrentIndex);
+	PROCEDURAL_LANDSCAPE_SCOPE(SpawnNewFoliage);
+	if (FoliageComponentsToUpdate.Num() == 0) return false;
+	if (FoliageComponentsToUpdate[0]->UpdateFoliage()) {
+		FoliageComponentsToUpdate[0]->SetVisibility(true, true);
+		FoliageComponentsToUpdate.RemoveAt(0);
 	}
-	FoliageGenerationThreads = SortedArray;
+	return true;
+}
+
+void ATileGenerator::SortFoliageJobs()
+{
+	QueuedFoliageJobs.RemoveAll([](FFoliageGenerationJob* FoliageJob) {
+		if (!FoliageJob->IsCancelled()) return false;
+		delete FoliageJob;
+		return true;
+	});
+	Algo::StableSort(QueuedFoliageJobs, [this](FFoliageGenerationJob* A, FFoliageGenerationJob* B) {
+		return GetDistanceToCenter(A->GetTileIndex()) < GetDistanceToCenter(B->GetTileIndex());
+	});
+}
+
+void ATileGenerator::AddFoliageJob(FFoliageGenerationJob* FoliageJob)
+{
+	//The newer job generates the same foliage again, so the older one is not needed anymore
+	FFoliageGenerationJob*& QueuedFoliageJob = QueuedFoliageJobsByTile.FindOrAdd(FoliageJob->GetTileIndex());
+	if (QueuedFoliageJob) QueuedFoliageJob->Cancel();
+	QueuedFoliageJob = FoliageJob;
+	QueuedFoliageJobs.Add(FoliageJob);
 }
 
 void ATileGenerator::SortFoliageComponentsToUpdate()
 {
-	TArray<UFoliageGenerationComponent*> SortedArray;
-
-	for (UFoliageGenerationComponent* CurrentComponent : FoliageComponentsToUpdate) {
-		int CurrentIndex = 0;
-		int CurrentXDistance = FMath::Abs(CurrentComponent->GetTileIndex().X - CenterTileIndex.X);
-		int CurrentYDistance = FMath::Abs(CurrentComponent->GetTileIndex().Y - CenterTileIndex.Y);
-		int CurrentDistance = FMath::Max(CurrentXDistance, CurrentYDistance);
-		while (CurrentIndex < SortedArray.Num()) {
-			int OtherXDistance = FMath::Abs(SortedArray[CurrentIndex]->GetTileIndex().X - CenterTileIndex.X);
-			int OtherYDistance = FMath::Abs(SortedArray[CurrentIndex]->GetTileIndex().Y - CenterTileIndex.Y);
-			int OtherDistance = FMath::Max(OtherXDistance, OtherYDistance);
-			if (CurrentDistance < OtherDistance) break;
-			CurrentIndex += 1;
-		}
-		SortedArray.Insert(CurrentComponent, CurrentIndex);
-	}
-	FoliageComponentsToUpdate = SortedArray;
+	Algo::StableSort(FoliageComponentsToUpdate, [this](UFoliageGenerationComponent* A, UFoliageGenerationComponent* B) {
+		return GetDistanceToCenter(A->GetTileIndex()) < GetDistanceToCenter(B->GetTileIndex());
+	});
 }
 
 
-void ATileGenerator::DeleteSingleTile()
+bool ATileGenerator::DeleteSingleTile()
 {
+	PROCEDURAL_LANDSCAPE_SCOPE(DeleteSingleTile);
 	AProceduralTile* TileToDelete;
 	if (TilesToDelete.Dequeue(TileToDelete)) {
-		if (TileToDelete->IsGenerationFinished() && !Tiles.Find(TileToDelete->GetTileIndex())) {
-			TileToDelete->Destroy();
+		if (TileToDelete->IsGenerationFinished() && !IsTileUsedByFoliageJob(TileToDelete)) {
+			if (PooledTiles.Num() < TilePoolSize) {
+				TileToDelete->Recycle();
+				PooledTiles.Add(TileToDelete);
+			}
+			else {
+				TileToDelete->Destroy();
+			}
+			--TilesToDeleteCount;
+			return true;
 		}
 		else {
 			TilesToDelete.Enqueue(TileToDelete);
 		}
 	}
+	return false;
+}
+
+bool ATileGenerator::IsTileUsedByFoliageJob(AProceduralTile* CurrentTile)
+{
+	return RunningFoliageJobs.ContainsByPredicate([CurrentTile](FFoliageGenerationJob* FoliageJob) {
+		return FoliageJob->GetTile() == CurrentTile;
+	});
 }
 
 void ATileGenerator::DeleteAllTiles() {
+	//The running jobs write into the components of the tiles, their results belong to the deleted tiles
+	for (FFoliageGenerationJob* FoliageJob : RunningFoliageJobs) {
+		FoliageJob->Wait();
+		delete FoliageJob;
+	}
+	RunningFoliageJobs.Empty();
+	FoliageComponentsToUpdate.Empty();
 	TArray<AProceduralTile*> Values;
 	Tiles.GenerateValueArray(Values);
 	for (AProceduralTile* Tile : Values) {
 		Tile->Destroy();
 	}
 	Tiles.Empty();
+	for (TPair<FQuadtreeNodeKey, AProceduralTile*>& Node : QuadtreeNodes) {
+		Node.Value->Destroy();
+	}
+	QuadtreeNodes.Empty();
+	for (AProceduralTile* Tile : PooledTiles) {
+		Tile->Destroy();
+	}
+	PooledTiles.Empty();
+	for (TPair<FTileIndex, AProceduralTile*>& PrefetchedTile : PrefetchedTiles) {
+		PrefetchedTile.Value->Destroy();
+	}
+	PrefetchedTiles.Empty();
+	VisibleQuadtreeNodes.Empty();
+	bIsQuadtreeDirty = true;
+	TilesPendingMesh.Empty();
+	TilesPendingMeshUpdate.Empty();
+	TilesToGenerate.Empty();
+	//The queued foliage jobs belong to the deleted tiles
+	for (FFoliageGenerationJob* FoliageJob : QueuedFoliageJobs) {
+		FoliageJob->Cancel();
+	}
+	QueuedFoliageJobsByTile.Empty();
 }
\ No newline at end of file
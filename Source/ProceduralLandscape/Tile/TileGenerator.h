@@ -5,16 +5,49 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "ProceduralTile.h"
-#include "Foliage/FoliageGenerationThread.h"
+#include "TileStore.h"
+#include "Foliage/FoliageGenerationComponent.h"
+#include "Foliage/FoliageGenerationJob.h"
 
 #include "TileGenerator.generated.h"
 
+/**
+ * Node of the terrain quadtree, identified by the tile in its corner with the smallest index and the number of tiles it spans on each axis.
+ */
+struct FQuadtreeNodeKey
+{
+	FTileIndex MinTileIndex;
+
+	int Scale = 1;
+
+	FQuadtreeNodeKey() {};
+
+	FQuadtreeNodeKey(FTileIndex MinTileIndex, int Scale) : MinTileIndex(MinTileIndex), Scale(Scale) {};
+
+	bool operator==(const FQuadtreeNodeKey& Other) const
+	{
+		return MinTileIndex == Other.MinTileIndex && Scale == Other.Scale;
+	}
+
+	/**
+	 * Checks if the tiles covered by this node and the other node intersect.
+	 */
+	bool Overlaps(const FQuadtreeNodeKey& Other) const
+	{
+		return MinTileIndex.X < Other.MinTileIndex.X + Other.Scale && Other.MinTileIndex.X < MinTileIndex.X + Scale
+			&& MinTileIndex.Y < Other.MinTileIndex.Y + Other.Scale && Other.MinTileIndex.Y < MinTileIndex.Y + Scale;
+	}
+};
+
+FORCEINLINE uint32 GetTypeHash(const FQuadtreeNodeKey& Key)
+{
+	return HashCombine(GetTypeHash(Key.MinTileIndex), ::GetTypeHash(Key.Scale));
+}
+
 UCLASS()
 class PROCEDURALLANDSCAPE_API ATileGenerator : public AActor
 {
 	GENERATED_BODY()
-
-	friend class FFoliageGenerationThread;
 	
 public:	
 	// Sets default values for this actor's properties
@@ -48,6 +81,94 @@ public:
 	UPROPERTY(EditAnywhere, Category = "General", meta = (UIMin = 1))
 	bool bReloadInEditor;
 
+	//Should the tile meshes be generated on worker threads during play? Tiles stay hidden until their mesh is uploaded
+	UPROPERTY(EditAnywhere, Category = "General")
+	bool bGenerateTilesAsync = false;
+
+	//Milliseconds per frame that may be spent on uploading tile meshes, generating new tiles, spawning foliage batches and deleting tiles. 0 does one step of each per frame and spawns foliage every FoliageUpdateCooldown
+	UPROPERTY(EditAnywhere, Category = "General", meta = (UIMin = 0))
+	float FrameBudgetMilliseconds = 0.f;
+
+	//Should tiles the player is heading into be generated ahead of time? They are kept hidden until they enter the draw distance. Requires bGenerateTilesAsync
+	UPROPERTY(EditAnywhere, Category = "General|Prefetch")
+	bool bPrefetchTiles = false;
+
+	//How many seconds the location of the player is predicted ahead with its current velocity
+	UPROPERTY(EditAnywhere, Category = "General|Prefetch", meta = (UIMin = 0, EditCondition = "bPrefetchTiles"))
+	float PrefetchTime = 2.f;
+
+	//How many tiles may start their prefetch each frame
+	UPROPERTY(EditAnywhere, Category = "General|Prefetch", meta = (UIMin = 1, EditCondition = "bPrefetchTiles"))
+	int PrefetchTilesPerFrame = 2;
+
+	//How many hidden tiles may exist at the same time
+	UPROPERTY(EditAnywhere, Category = "General|Prefetch", meta = (UIMin = 0, EditCondition = "bPrefetchTiles"))
+	int MaxPrefetchedTiles = 32;
+
+	//How many removed tiles are kept hidden to be reused for new tiles instead of spawning new actors, 0 destroys every removed tile
+	UPROPERTY(EditAnywhere, Category = "General", meta = (UIMin = 0))
+	int TilePoolSize = 16;
+
+	//Should generated heightfields and foliage be stored in Saved/TileCache and loaded from there instead of being generated again
+	UPROPERTY(EditAnywhere, Category = "General|Cache")
+	bool bUseDiskCache = false;
+
+	//Should tiles further away from the player be generated with fewer vertices?
+	UPROPERTY(EditAnywhere, Category = "General|LOD")
+	bool bUseLODRings = false;
+
+	//How many layers of tiles share the same level of detail
+	UPROPERTY(EditAnywhere, Category = "General|LOD", meta = (UIMin = 1, EditCondition = "bUseLODRings"))
+	int LODRingWidth = 1;
+
+	//Number of detail levels, every level halves the resolution of the previous one. Seams line up if TileResolution - 1 is divisible by 2^(LODLevelCount - 1)
+	UPROPERTY(EditAnywhere, Category = "General|LOD", meta = (UIMin = 1, UIMax = 5, EditCondition = "bUseLODRings"))
+	int LODLevelCount = 3;
+
+	//How far the skirts below the tile borders reach down to hide cracks between tiles of different resolution
+	UPROPERTY(EditAnywhere, Category = "General|LOD", meta = (UIMin = 0, EditCondition = "bUseLODRings || bUseQuadtree"))
+	float SkirtDepth = 100.f;
+
+	//Should the landscape be built from quadtree nodes that get larger with the distance to the player instead of a grid of equally sized tiles? Replaces DrawDistance and the LOD rings
+	UPROPERTY(EditAnywhere, Category = "General|Quadtree")
+	bool bUseQuadtree = false;
+
+	//Number of times a root node can be split, a root node spans 2^QuadtreeDepth tiles on each axis
+	UPROPERTY(EditAnywhere, Category = "General|Quadtree", meta = (UIMin = 0, UIMax = 10, EditCondition = "bUseQuadtree"))
+	int QuadtreeDepth = 4;
+
+	//How many layers of root nodes are generated around the root node of the player
+	UPROPERTY(EditAnywhere, Category = "General|Quadtree", meta = (UIMin = 0, EditCondition = "bUseQuadtree"))
+	int QuadtreeRootDistance = 1;
+
+	//A node is split if the player is closer than its width times this factor
+	UPROPERTY(EditAnywhere, Category = "General|Quadtree", meta = (UIMin = 0.5, UIMax = 4, EditCondition = "bUseQuadtree"))
+	float QuadtreeSplitDistance = 1.5f;
+
+	//How many nodes may start their generation each frame
+	UPROPERTY(EditAnywhere, Category = "General|Quadtree", meta = (UIMin = 1, EditCondition = "bUseQuadtree"))
+	int QuadtreeNodeBudget = 4;
+
+	//Should only tiles close to the player have collision?
+	UPROPERTY(EditAnywhere, Category = "General|Collision")
+	bool bLimitCollisionDistance = false;
+
+	//How many layers of tiles around the player have collision. The foliage does not depend on the collision and is generated for every tile
+	UPROPERTY(EditAnywhere, Category = "General|Collision", meta = (UIMin = 0, EditCondition = "bLimitCollisionDistance"))
+	int CollisionDistance = 1;
+
+	//Should the world origin follow the player? Keeps rendering and physics precise far away from the origin, requires bEnableWorldOriginRebasing in the world settings
+	UPROPERTY(EditAnywhere, Category = "General|Origin")
+	bool bRebaseWorldOrigin = false;
+
+	//Distance between the player and the current world origin at which the origin is moved to the player
+	UPROPERTY(EditAnywhere, Category = "General|Origin", meta = (UIMin = 1000, EditCondition = "bRebaseWorldOrigin"))
+	float RebaseDistance = 1000000.f;
+
+	//Graph of height operations that replaces the major, minor and detail noise, the noise settings are used if it is not set
+	UPROPERTY(EditAnywhere, Category = "General|Terrain")
+	class UTerrainGraphAsset* TerrainGraph = nullptr;
+
 	//Influence of the PerlinNoise
 	UPROPERTY(EditAnywhere, Category = "MajorNoise", meta = (UIMin = 0))
 	int MajorNoiseStrength; 
@@ -96,6 +217,46 @@ public:
 	UPROPERTY(EditAnywhere, Category = "MinorNoise|Randomness")
 	float MinorNoiseScaleDeviation = 0.0f;
 
+	//Number of octaves of the fractal noise that adds detail on top of the major and minor noise, 0 disables it. Counts up to 8 are specialized and cheaper
+	UPROPERTY(EditAnywhere, Category = "DetailNoise", meta = (UIMin = 0, UIMax = 12))
+	int DetailNoiseOctaves = 0;
+
+	//How the octaves are combined
+	UPROPERTY(EditAnywhere, Category = "DetailNoise", meta = (EditCondition = "DetailNoiseOctaves > 0"))
+	EDetailNoiseType DetailNoiseType = EDetailNoiseType::Fbm;
+
+	//The influence of the first octave
+	UPROPERTY(EditAnywhere, Category = "DetailNoise", meta = (UIMin = 0, EditCondition = "DetailNoiseOctaves > 0"))
+	float DetailNoiseStrength = 0.0f;
+
+	//X and Y offset of the first octave
+	UPROPERTY(EditAnywhere, Category = "DetailNoise", meta = (EditCondition = "DetailNoiseOctaves > 0"))
+	FVector2D DetailNoiseOffset = FVector2D::ZeroVector;
+
+	//X and Y scale of the first octave
+	UPROPERTY(EditAnywhere, Category = "DetailNoise", meta = (EditCondition = "DetailNoiseOctaves > 0"))
+	FVector2D DetailNoiseScale = FVector2D(1.0f, 1.0f);
+
+	//Factor the scale grows by from one octave to the next
+	UPROPERTY(EditAnywhere, Category = "DetailNoise", meta = (UIMin = 1, UIMax = 4, EditCondition = "DetailNoiseOctaves > 0"))
+	float DetailNoiseLacunarity = 2.0f;
+
+	//Factor the strength shrinks by from one octave to the next
+	UPROPERTY(EditAnywhere, Category = "DetailNoise", meta = (UIMin = 0, UIMax = 1, EditCondition = "DetailNoiseOctaves > 0"))
+	float DetailNoiseGain = 0.5f;
+
+	//Distance in tiles the detail noise is displaced by, 0 disables the domain warping
+	UPROPERTY(EditAnywhere, Category = "DetailNoise|Warping", meta = (UIMin = 0, EditCondition = "DetailNoiseOctaves > 0"))
+	float DetailNoiseWarpStrength = 0.0f;
+
+	//X and Y scale of the noise that displaces the detail noise
+	UPROPERTY(EditAnywhere, Category = "DetailNoise|Warping", meta = (EditCondition = "DetailNoiseOctaves > 0"))
+	FVector2D DetailNoiseWarpScale = FVector2D(0.25f, 0.25f);
+
+	//Randomness for the offset value
+	UPROPERTY(EditAnywhere, Category = "DetailNoise|Randomness")
+	float DetailNoiseOffsetDeviation = 0.0f;
+
 	//If trees should be generated
 	UPROPERTY(EditAnywhere, Category = "Foliage|General")
 	bool bGenerateTrees = false;
@@ -112,6 +273,10 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Foliage|General")
 	float FoliageUpdateCooldown = 0.25;
 
+	//Max number of tiles whose foliage is generated at the same time on the thread pool. 0 uses all workers of the pool but one, which stays free for the tile meshes
+	UPROPERTY(EditAnywhere, Category = "Foliage|General", meta = (UIMin = 0))
+	int MaxFoliageJobs = 0;
+
 	//Should occlusion culling be applied?
 	UPROPERTY(EditAnywhere, Category = "Foliage|General")
 	bool bUseCulling = false;
@@ -132,6 +297,10 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Foliage|TreeGeneration", meta = (EditCondition = "bGenerateTrees"))
 	int TreeBatchSize = 50;
 
+	//How the tree locations are chosen, poisson-disk sampling spaces the trees evenly by their radius
+	UPROPERTY(EditAnywhere, Category = "Foliage|TreeGeneration", meta = (EditCondition = "bGenerateTrees"))
+	EFoliagePlacementType TreePlacementType = EFoliagePlacementType::Random;
+
 	//Trees and their respective data for generation
 	UPROPERTY(EditAnywhere, Category = "Foliage|TreeGeneration", meta = (EditCondition = "bGenerateTrees"))
 	TArray<class UFoliageDataAsset*> TreeData; 
@@ -168,6 +337,10 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Foliage|BushGeneration", meta = (EditCondition = "bGenerateBushes"))
 	int BushBatchSize = 50;
 
+	//How the bush locations are chosen, poisson-disk sampling spaces the bushes evenly by their radius
+	UPROPERTY(EditAnywhere, Category = "Foliage|BushGeneration", meta = (EditCondition = "bGenerateBushes"))
+	EFoliagePlacementType BushPlacementType = EFoliagePlacementType::Random;
+
 	//Bush types and their respective data for generation
 	UPROPERTY(EditAnywhere, Category = "Foliage|BushGeneration", meta = (EditCondition = "bGenerateBushes"))
 	TArray<class UFoliageDataAsset*> BushData; 
@@ -186,6 +359,46 @@ public:
 	 */
 	void UpdateTiles(FTileIndex NewCenterIndex);
 
+	/**
+	 * Number of allocations the mesh buffer pool made for vertex data since the generator was created.
+	 * 
+	 * \return the number of allocations
+	 */
+	UFUNCTION(BlueprintPure, Category = "General")
+	int GetMeshBufferAllocationCount() const;
+
+	/**
+	 * Number of heightfield and foliage records that were loaded from the disk cache.
+	 * 
+	 * \return the number of cache hits, 0 if the cache is disabled
+	 */
+	UFUNCTION(BlueprintPure, Category = "General|Cache")
+	int GetDiskCacheHitCount() const;
+
+	/**
+	 * Number of heightfield and foliage records that had to be generated because they were not in the disk cache.
+	 * 
+	 * \return the number of cache misses, 0 if the cache is disabled
+	 */
+	UFUNCTION(BlueprintPure, Category = "General|Cache")
+	int GetDiskCacheMissCount() const;
+
+	/**
+	 * Calculates the noise parameters the tiles of this generator are created with, without changing the generator.
+	 * 
+	 * \param Seed the random seed the noise deviations are drawn with
+	 * \return the parameters shared by all tiles, the tile index is not set
+	 */
+	FTileGenerationParams MakeTileGenerationParams(int Seed) const;
+
+	/**
+	 * Calculates the resolution of the tiles in a LOD ring, every level halves the number of quads on each axis.
+	 * 
+	 * \param LODLevel the level of the ring, 0 is full detail
+	 * \return the number of vertices on each axis
+	 */
+	int GetLODResolution(int LODLevel) const;
+
 	virtual void Tick(float DeltaSeconds);
 
 protected:
@@ -201,37 +414,60 @@ private:
 	UPROPERTY(EditAnywhere)
 	FTileIndex CenterTileIndex;
 
-	//Can a new foliage thread be started
-	UPROPERTY()
-	bool bIsFoliageThreadFinished = true;
+	//All tiles within the draw distance, stored in a ring buffer around the CenterTileIndex
+	FTileStore Tiles;
+
+	//New tiles whose mesh is still generated asynchronously
+	TArray<AProceduralTile*> TilesPendingMesh;
+
+	//Existing tiles whose new level of detail is still generated asynchronously
+	TArray<AProceduralTile*> TilesPendingMeshUpdate;
+
+	//Indices of tiles that are generated by the scheduler, sorted by their distance to the CenterTileIndex
+	TArray<FTileIndex> TilesToGenerate;
+
+	//All quadtree nodes that currently exist, including nodes that are about to be replaced
+	TMap<FQuadtreeNodeKey, AProceduralTile*> QuadtreeNodes;
 
-	//All tiles that currently exist
-	TMap<FTileIndex, AProceduralTile*> Tiles; 
+	//Nodes that should be visible for the current CenterTileIndex, sorted by their distance to it
+	TArray<FQuadtreeNodeKey> VisibleQuadtreeNodes;
+
+	//Does VisibleQuadtreeNodes have to be collected again
+	bool bIsQuadtreeDirty = true;
+
+	//Reusable buffers for the mesh generation of the tiles
+	FTileMeshBufferPoolPtr MeshBufferPool;
+
+	//Cache of generated tile data for the current generation parameters, only set if bUseDiskCache is enabled
+	FTileDiskCachePtr DiskCache;
 
 	//Parameters that are needed for the generation of atile
 	FTileGenerationParams TileGenerationParams;
 
-	//Threads that create locations for a specific foliage component
-	TArray<FFoliageGenerationThread*> FoliageGenerationThreads;
+	//Foliage jobs that wait for a free slot on the thread pool, sorted by the distance of their tile to the CenterTileIndex
+	TArray<FFoliageGenerationJob*> QueuedFoliageJobs;
+
+	//Queued foliage job of every tile, so the job of a removed tile can be cancelled without searching QueuedFoliageJobs
+	TMap<FTileIndex, FFoliageGenerationJob*> QueuedFoliageJobsByTile;
+
+	//Foliage jobs that were started on the thread pool and whose result was not collected yet
+	TArray<FFoliageGenerationJob*> RunningFoliageJobs;
 
 	//Tiles that are marked to be deleted
 	TQueue<AProceduralTile*> TilesToDelete;
 
-	//Currently running thread
-	class FRunnableThread* RunningThread;
+	//Number of tiles in TilesToDelete, the queue does not track its size
+	int TilesToDeleteCount = 0;
 
-	//Current thread that generates new foliage instances
-	class FFoliageGenerationThread* CurrentFoliageThread;
+	//Hidden tiles that can be reused for new tiles
+	TArray<AProceduralTile*> PooledTiles;
 
-	//The FoliageInfos of the previous foliage generation
-	TArray<struct FGeneratedFoliageInfo> LastGeneratedFoliageInfos;
+	//Hidden tiles outside of the draw distance that were generated ahead of the player
+	TMap<FTileIndex, AProceduralTile*> PrefetchedTiles;
 
 	//Components for which the creation of new instances is already finished
 	TArray<UFoliageGenerationComponent*> FoliageComponentsToUpdate;
 
-	//TileIndex of the previous foliage component
-	struct FTileIndex LastTileIndex;
-
 	//Time passed since last update
 	float CurrentUpdateTime = 0.f;
 
@@ -250,6 +486,200 @@ private:
 	 */
 	AProceduralTile* GenerateTile(FTileIndex CurrentTileIndex);
 
+	/**
+	 * Stores a tile in the slot of its index and records whether its mesh is still pending.
+	 * 
+	 * \param CurrentTileIndex the index of the tile
+	 * \param CurrentTile the tile
+	 */
+	void StoreTile(FTileIndex CurrentTileIndex, AProceduralTile* CurrentTile);
+
+	/**
+	 * Spawns a tile and starts the generation of its mesh.
+	 *
+	 * \param CurrentTileGenerationParams the parameters of the new tile
+	 * \param bHasCollision if the mesh of the tile should have collision
+	 * \return the spawned tile
+	 */
+	AProceduralTile* SpawnTile(FTileGenerationParams CurrentTileGenerationParams, bool bHasCollision);
+
+	/**
+	 * Generates the mesh of an existing tile again, e.g. because its level of detail changed.
+	 *
+	 * \param CurrentTile the tile to update
+	 */
+	void UpdateTileMesh(AProceduralTile* CurrentTile);
+
+	/**
+	 * Sets up the generation parameters for a single tile.
+	 *
+	 * \param CurrentTileIndex the index of the tile
+	 * \return the parameters that will be used for the generation of this tile
+	 */
+	FTileGenerationParams GetTileGenerationParams(FTileIndex CurrentTileIndex);
+
+	/**
+	 * Calculates the resolution of a tile depending on its distance to the CenterTileIndex.
+	 *
+	 * \param CurrentTileIndex the index of the tile
+	 * \return the number of vertices on each axis
+	 */
+	int GetTileResolution(FTileIndex CurrentTileIndex);
+
+	/**
+	 * Refines the quadtree for the current location of the player, generates missing nodes and removes replaced ones.
+	 *
+	 * \param NodeBudget how many nodes may start their generation
+	 */
+	void UpdateQuadtree(int NodeBudget);
+
+	/**
+	 * Collects the nodes that should be visible below the provided node.
+	 *
+	 * \param Node the node to refine
+	 * \param Nodes_Out receives the nodes that should be visible
+	 */
+	void CollectVisibleQuadtreeNodes(FQuadtreeNodeKey Node, TArray<FQuadtreeNodeKey>& Nodes_Out);
+
+	/**
+	 * Calculates the distance between the CenterTileIndex and the closest tile of the node.
+	 *
+	 * \param Node the node to measure
+	 * \return the distance in tiles
+	 */
+	float GetQuadtreeNodeDistance(FQuadtreeNodeKey Node);
+
+	/**
+	 * Generates a new tile that covers all tiles of the node.
+	 *
+	 * \param Node the node to generate
+	 * \return the generated tile
+	 */
+	AProceduralTile* GenerateQuadtreeNode(FQuadtreeNodeKey Node);
+
+	/**
+	 * Checks if the node exists and its mesh is uploaded.
+	 *
+	 * \param Node the node to check
+	 * \return true if the node can be shown
+	 */
+	bool IsQuadtreeNodeReady(FQuadtreeNodeKey Node);
+
+	/**
+	 * Location of the current world origin, tile indices are derived from locations that are offset by it.
+	 *
+	 * \return the world origin or zero if origin rebasing was never used
+	 */
+	FVector GetWorldOrigin() const;
+
+	/**
+	 * Moves the world origin to the player once the player is further than RebaseDistance away from it.
+	 * Tiles and foliage are placed relative to their center, so the world shift moves them without any regeneration.
+	 */
+	void RebaseWorldOrigin();
+
+	/**
+	 * Calculates the index of the tile the player is currently located on.
+	 *
+	 * \return the index of the tile below the player or the CenterTileIndex if there is no player
+	 */
+	FTileIndex GetObserverTileIndex();
+
+	/**
+	 * Generates the tiles around the predicted location of the player, uploads finished prefetches and releases the ones that are no longer needed.
+	 *
+	 */
+	void PrefetchTiles();
+
+	/**
+	 * Moves a prefetched tile to the tiles within the draw distance and shows it.
+	 *
+	 * \param CurrentTileIndex the index of the tile that entered the draw distance
+	 * \return true if the tile was prefetched
+	 */
+	bool PromotePrefetchedTile(FTileIndex CurrentTileIndex);
+
+	/**
+	 * Collects the tiles within DrawDistance of one center that are further than DrawDistance away from the other center.
+	 * Only the rows and columns outside of the other square are visited.
+	 *
+	 * \param SquareCenterIndex center of the square whose tiles are collected
+	 * \param OtherCenterIndex center of the square whose tiles are skipped
+	 * \param TileIndices_Out receives the indices of the tiles
+	 */
+	void CollectTilesOutsideSquare(FTileIndex SquareCenterIndex, FTileIndex OtherCenterIndex, TArray<FTileIndex>& TileIndices_Out);
+
+	/**
+	 * Updates collision and level of detail of the tiles whose distance to the center can affect them.
+	 *
+	 * \param Shift how many tiles the center moved
+	 */
+	void UpdateTilesNearCenter(int Shift);
+
+	/**
+	 * Calculates the number of tile layers between a tile and the CenterTileIndex.
+	 *
+	 * \param CurrentTileIndex the index of the tile
+	 * \return the distance in tiles
+	 */
+	int GetDistanceToCenter(FTileIndex CurrentTileIndex);
+
+	/**
+	 * Queues a foliage job and registers it for its tile, a queued job of the same tile is replaced.
+	 *
+	 * \param FoliageJob the job to queue
+	 */
+	void AddFoliageJob(FFoliageGenerationJob* FoliageJob);
+
+	/**
+	 * Stops the foliage generation of a tile and queues it for deletion.
+	 *
+	 * \param CurrentTile the tile to remove
+	 */
+	void RemoveTile(AProceduralTile* CurrentTile);
+
+	/**
+	 * Uploads the meshes of all tiles whose asynchronous generation is finished and starts their foliage generation.
+	 *
+	 * \param MaxTileCount the maximum number of meshes to upload
+	 * \return the number of uploaded meshes
+	 */
+	int FinishPendingTiles(int MaxTileCount = MAX_int32);
+
+	/**
+	 * Performs work by priority until FrameBudgetMilliseconds are used or there is nothing left to do.
+	 *
+	 */
+	void RunScheduledWork();
+
+	/**
+	 * Publishes the depths of the generation queues to the stats and the CSV profiler.
+	 *
+	 */
+	void UpdateStats();
+
+	/**
+	 * Generates the first tile of TilesToGenerate.
+	 *
+	 * \return true if a tile was generated
+	 */
+	bool GenerateQueuedTile();
+
+	/**
+	 * Checks if tile meshes should be generated on worker threads.
+	 *
+	 * \return true if async generation is enabled and the tiles are generated in a game world
+	 */
+	bool ShouldGenerateTilesAsync();
+
+	/**
+	 * Checks if the tile at the provided index should have collision.
+	 *
+	 * \param CurrentTileIndex the index of the tile
+	 * \return true if collision is not limited or the tile is within CollisionDistance of the CenterTileIndex
+	 */
+	bool ShouldTileHaveCollision(FTileIndex CurrentTileIndex);
+
 	/**
 	 * Generates the Foliage for the provided tile
 	 *
@@ -259,10 +689,24 @@ private:
 	void GenerateFoliage(FTileIndex CurrentTileIndex, AProceduralTile* CurrentTile);
 
 	/**
-	 * Starts a new thread for the foliage generation for a single FoliageGenerationComponent
+	 * Collects the finished foliage jobs and starts queued jobs until GetMaxFoliageJobs are running
+	 *
+	 */
+	void UpdateFoliageJobs();
+
+	/**
+	 * Sets up the components of a foliage job with the current foliage settings and hides them until their instances are spawned.
 	 *
+	 * \param FoliageJob the job that is about to start
 	 */
-	void InitializeFoliageThread();
+	void SetupFoliageJob(FFoliageGenerationJob* FoliageJob);
+
+	/**
+	 * Number of foliage jobs that may run at the same time, see MaxFoliageJobs.
+	 *
+	 * \return at least 1
+	 */
+	int GetMaxFoliageJobs();
 
 	/**
 	 * Spawns the generated foliage for the first element of FoliageComponentsToUpdate.
@@ -271,10 +715,17 @@ private:
 	void SpawnNewFoliage();
 
 	/**
-	 *Sorts the FoliageGenerationThreads by the distance to the CenterTileIndex
+	 * Spawns the next batch of instances of the first element of FoliageComponentsToUpdate.
+	 *
+	 * \return true if a batch was spawned
+	 */
+	bool SpawnFoliageBatch();
+
+	/**
+	 * Deletes the cancelled QueuedFoliageJobs and sorts the others by the distance to the CenterTileIndex
 	 * 
 	 */
-	void SortFoliageGenerationThreads();
+	void SortFoliageJobs();
 
 	/**
 	 * Sorts the FoliageComponentsToUpdate by the distance to the CenterTileIndex
@@ -282,14 +733,23 @@ private:
 	 */
 	void SortFoliageComponentsToUpdate();
 
+	/**
+	 * Checks if a started foliage job generates foliage for the provided tile.
+	 *
+	 * \param CurrentTile the tile to check
+	 * \return true if the foliage components of the tile are used by a running job
+	 */
+	bool IsTileUsedByFoliageJob(AProceduralTile* CurrentTile);
+
 	/**
 	 * Delets all tiles in the Tiles-Map
 	 */
 	void DeleteAllTiles();
 
 	/**
-	 * Deletes the first tile in TilesToDelete
+	 * Moves the first tile in TilesToDelete to the pool or deletes it if the pool is full
 	 *
+	 * \return true if a tile was removed, false if there was none or it is still in use
 	 */
-	void DeleteSingleTile();
+	bool DeleteSingleTile();
 };
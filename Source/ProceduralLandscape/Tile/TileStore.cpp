@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileStore.h"
+
+namespace
+{
+	//Spare ring around the draw distance, a tile that is one step behind the draw distance while the center moves never evicts a tile inside it
+	constexpr int SlotMargin = 1;
+}
+
+void FTileStore::Reset(int DrawDistance)
+{
+	Width = 2 * FMath::Max(DrawDistance, 0) + 1 + SlotMargin;
+	Slots.Reset();
+	Slots.SetNum(Width * Width);
+	TileCount = 0;
+}
+
+AProceduralTile* FTileStore::Add(FTileIndex TileIndex, AProceduralTile* Tile)
+{
+	FTileSlot& Slot = Slots[GetSlotIndex(TileIndex)];
+	AProceduralTile* EvictedTile = Slot.Tile != Tile ? Slot.Tile : nullptr;
+	if (!Slot.Tile) ++TileCount;
+	Slot.TileIndex = TileIndex;
+	Slot.Tile = Tile;
+	Slot.Flags = ETileSlotFlags::None;
+	return EvictedTile;
+}
+
+bool FTileStore::Remove(FTileIndex TileIndex, AProceduralTile*& Tile_Out)
+{
+	FTileSlot* Slot = FindSlot(TileIndex);
+	if (!Slot) return false;
+	Tile_Out = Slot->Tile;
+	Slot->Tile = nullptr;
+	Slot->Flags = ETileSlotFlags::None;
+	--TileCount;
+	return true;
+}
+
+void FTileStore::Empty()
+{
+	for (FTileSlot& Slot : Slots) {
+		Slot.Tile = nullptr;
+		Slot.Flags = ETileSlotFlags::None;
+	}
+	TileCount = 0;
+}
+
+void FTileStore::GenerateValueArray(TArray<AProceduralTile*>& Tiles_Out) const
+{
+	Tiles_Out.Reset(TileCount);
+	for (const FTileSlot& Slot : Slots) {
+		if (Slot.Tile) Tiles_Out.Add(Slot.Tile);
+	}
+}
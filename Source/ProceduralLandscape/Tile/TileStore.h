@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralTile.h"
+
+/**
+ * Streaming state of a tile slot.
+ */
+enum class ETileSlotFlags : uint8
+{
+	None = 0,
+
+	//The mesh of the tile is generated on a worker thread
+	Meshing = 1 << 0,
+
+	//The mesh of the tile is uploaded
+	Ready = 1 << 1,
+
+	//The foliage of the tile was queued, it is only queued once per tile
+	Foliage = 1 << 2
+};
+ENUM_CLASS_FLAGS(ETileSlotFlags);
+
+/**
+ * Resident tiles around the center of the landscape.
+ *
+ * The tiles are stored in a dense two dimensional ring buffer that is indexed by the tile coordinates modulo its width.
+ * Every tile within the draw distance of the center has its own slot, so lookups are a single array read and moving
+ * the center never rehashes or reallocates anything. Every slot keeps the streaming state of its tile next to the pointer.
+ */
+class PROCEDURALLANDSCAPE_API FTileStore
+{
+public:
+	/**
+	 * Removes all tiles and resizes the store for a draw distance.
+	 *
+	 * \param DrawDistance the number of tiles around the center that are resident
+	 */
+	void Reset(int DrawDistance);
+
+	/**
+	 * Finds the tile at an index.
+	 *
+	 * \param TileIndex the index of the tile
+	 * \return the tile or nullptr if the tile is not resident
+	 */
+	FORCEINLINE AProceduralTile* Find(FTileIndex TileIndex) const
+	{
+		const FTileSlot* Slot = FindSlot(TileIndex);
+		return Slot ? Slot->Tile : nullptr;
+	}
+
+	FORCEINLINE bool Contains(FTileIndex TileIndex) const
+	{
+		return Find(TileIndex) != nullptr;
+	}
+
+	/**
+	 * Stores a tile in the slot of its index.
+	 *
+	 * \param TileIndex the index of the tile
+	 * \param Tile the tile
+	 * \return the tile that occupied the slot before, nullptr unless a tile outside the draw distance was not removed
+	 */
+	AProceduralTile* Add(FTileIndex TileIndex, AProceduralTile* Tile);
+
+	/**
+	 * Clears the slot of a tile.
+	 *
+	 * \param TileIndex the index of the tile
+	 * \param Tile_Out receives the removed tile
+	 * \return true if the tile was resident
+	 */
+	bool Remove(FTileIndex TileIndex, AProceduralTile*& Tile_Out);
+
+	/**
+	 * Removes all tiles without resizing the store.
+	 */
+	void Empty();
+
+	/**
+	 * Number of resident tiles.
+	 */
+	FORCEINLINE int Num() const
+	{
+		return TileCount;
+	}
+
+	/**
+	 * Collects all resident tiles.
+	 *
+	 * \param Tiles_Out receives the tiles
+	 */
+	void GenerateValueArray(TArray<AProceduralTile*>& Tiles_Out) const;
+
+	/**
+	 * Streaming state of a resident tile, None if the tile is not resident.
+	 */
+	FORCEINLINE ETileSlotFlags GetFlags(FTileIndex TileIndex) const
+	{
+		const FTileSlot* Slot = FindSlot(TileIndex);
+		return Slot ? Slot->Flags : ETileSlotFlags::None;
+	}
+
+	/**
+	 * Sets and clears flags of a resident tile, does nothing if the tile is not resident.
+	 *
+	 * \param TileIndex the index of the tile
+	 * \param FlagsToSet flags that are set
+	 * \param FlagsToClear flags that are cleared
+	 */
+	FORCEINLINE void UpdateFlags(FTileIndex TileIndex, ETileSlotFlags FlagsToSet, ETileSlotFlags FlagsToClear = ETileSlotFlags::None)
+	{
+		FTileSlot* Slot = FindSlot(TileIndex);
+		if (!Slot) return;
+		Slot->Flags = (Slot->Flags & ~FlagsToClear) | FlagsToSet;
+	}
+
+private:
+	struct FTileSlot
+	{
+		FTileIndex TileIndex;
+
+		AProceduralTile* Tile = nullptr;
+
+		ETileSlotFlags Flags = ETileSlotFlags::None;
+	};
+
+	TArray<FTileSlot> Slots;
+
+	//Number of slots on each axis
+	int Width = 0;
+
+	int TileCount = 0;
+
+	FORCEINLINE int GetSlotIndex(FTileIndex TileIndex) const
+	{
+		//The remainder of a negative index is negative as well, it is moved into [0, Width)
+		int64 Row = TileIndex.X % Width;
+		int64 Column = TileIndex.Y % Width;
+		if (Row < 0) Row += Width;
+		if (Column < 0) Column += Width;
+		return int(Row) * Width + int(Column);
+	}
+
+	FORCEINLINE const FTileSlot* FindSlot(FTileIndex TileIndex) const
+	{
+		if (Slots.Num() == 0) return nullptr;
+		const FTileSlot& Slot = Slots[GetSlotIndex(TileIndex)];
+		return Slot.Tile && Slot.TileIndex == TileIndex ? &Slot : nullptr;
+	}
+
+	FORCEINLINE FTileSlot* FindSlot(FTileIndex TileIndex)
+	{
+		return const_cast<FTileSlot*>(static_cast<const FTileStore*>(this)->FindSlot(TileIndex));
+	}
+};
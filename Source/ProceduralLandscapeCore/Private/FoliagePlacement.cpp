@@ -0,0 +1,258 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FoliagePlacement.h"
+
+#include "Math/RandomStream.h"
+
+namespace
+{
+	/**
+	 * State of a single placement that is shared by all placement modes.
+	 */
+	struct FPlacementContext
+	{
+		FPlacementContext(const FFoliagePlacementParams& PlacementParams, TArrayView<const FFoliageDescriptor> Descriptors, FFoliageGroundSampler SampleGround, TArray<FGeneratedFoliageInfo>& FoliageInfos, TArray<FFoliageInstance>& Instances_Out)
+			: PlacementParams(PlacementParams), Descriptors(Descriptors), SampleGround(SampleGround), FoliageInfos(FoliageInfos), Instances_Out(Instances_Out), RandomStream(PlacementParams.Seed)
+		{
+			float MaxRadius = 0.f;
+			for (const FFoliageDescriptor& Descriptor : Descriptors) {
+				TileBounds.Add(FFoliagePlacement::GetTileBounds(PlacementParams, Descriptor));
+				MaxRadius = FMath::Max(MaxRadius, Descriptor.Radius);
+			}
+			for (const FGeneratedFoliageInfo& FoliageInfo : FoliageInfos) {
+				MaxRadius = FMath::Max(MaxRadius, FoliageInfo.Radius);
+			}
+			Grid.Build(PlacementParams.TileSize, MaxRadius, FoliageInfos);
+		}
+
+		const FFoliagePlacementParams& PlacementParams;
+
+		TArrayView<const FFoliageDescriptor> Descriptors;
+
+		FFoliageGroundSampler SampleGround;
+
+		TArray<FGeneratedFoliageInfo>& FoliageInfos;
+
+		TArray<FFoliageInstance>& Instances_Out;
+
+		FRandomStream RandomStream;
+
+		TArray<FTileBounds, TInlineAllocator<8>> TileBounds;
+
+		FFoliageOverlapGrid Grid;
+
+		//Number of placed instances
+		int Count = 0;
+
+		/**
+		 * Picks a random foliage type and a random location inside its bounds.
+		 */
+		void PickRandomCandidate(int& DescriptorIndex_Out, float& XPos_Out, float& YPos_Out)
+		{
+			DescriptorIndex_Out = RandomStream.RandRange(0, Descriptors.Num() - 1);
+			const FTileBounds& CurrentBounds = TileBounds[DescriptorIndex_Out];
+			XPos_Out = RandomStream.FRandRange(CurrentBounds.XMin, CurrentBounds.XMax);
+			YPos_Out = RandomStream.FRandRange(CurrentBounds.YMin, CurrentBounds.YMax);
+		}
+
+		/**
+		 * Samples the ground below a candidate and places an instance unless the candidate overlaps existing foliage.
+		 *
+		 * \return true if the instance was placed
+		 */
+		bool TryPlace(int DescriptorIndex, float XPos, float YPos);
+	};
+
+	bool FPlacementContext::TryPlace(int DescriptorIndex, float XPos, float YPos)
+	{
+		const FFoliageDescriptor& Descriptor = Descriptors[DescriptorIndex];
+		float ZPos = 0;
+		FVector GroundNormal = FVector::UpVector;
+		if (!SampleGround(XPos, YPos, ZPos, GroundNormal)) {
+			ZPos = 0;
+			GroundNormal = FVector::UpVector;
+		}
+		if (Descriptor.MaxSlope < 90.f && GroundNormal.Z < FMath::Cos(FMath::DegreesToRadians(Descriptor.MaxSlope))) return false;
+		FVector Location(XPos, YPos, ZPos);
+
+		float Distance;
+		float ClosestRadius;
+		FFoliageGrowthCurvePtr GrowthCurve;
+		bool bDoesOverlap = FFoliagePlacement::DoesOverlap(Location, Grid, FoliageInfos, Descriptor.Radius, Distance, ClosestRadius, GrowthCurve);
+
+		float GrowthFactor = 1;
+		if (bDoesOverlap && GrowthCurve.IsValid()) {
+			float NormalizedDistance = Distance / ClosestRadius;
+			GrowthFactor = (*GrowthCurve)(NormalizedDistance);
+		}
+
+		if (bDoesOverlap && (!GrowthCurve.IsValid() || Descriptor.bIsTree)) return false;
+
+		FVector Scale;
+		if (Descriptor.bUniformScale) {
+			float Rand = RandomStream.FRandRange(-Descriptor.ScaleRandomDeviationUniform, Descriptor.ScaleRandomDeviationUniform);
+			Scale = FVector(Descriptor.ScaleUniform + Rand);
+		}
+		else {
+			float ScaleX = RandomStream.FRandRange(Descriptor.Scale.X - Descriptor.ScaleRandomDeviation.X, Descriptor.Scale.X + Descriptor.ScaleRandomDeviation.X);
+			float ScaleY = RandomStream.FRandRange(Descriptor.Scale.Y - Descriptor.ScaleRandomDeviation.Y, Descriptor.Scale.Y + Descriptor.ScaleRandomDeviation.Y);
+			float ScaleZ = RandomStream.FRandRange(Descriptor.Scale.Z - Descriptor.ScaleRandomDeviation.Z, Descriptor.Scale.Z + Descriptor.ScaleRandomDeviation.Z);
+			Scale = FVector(ScaleX, ScaleY, ScaleZ);
+		}
+
+		FFoliageInstance& Instance = Instances_Out.AddDefaulted_GetRef();
+		Instance.DescriptorIndex = DescriptorIndex;
+		Instance.Transform.MultiplyScale3D(Scale * GrowthFactor);
+		Instance.Transform.SetLocation(Location);
+		FRotator Rotation(ForceInitToZero);
+		Rotation.Yaw = RandomStream.FRandRange(-180, 180);
+		Instance.Transform.SetRotation(Rotation.Quaternion());
+
+		FGeneratedFoliageInfo GeneratedFoliageInfo;
+		GeneratedFoliageInfo.Location = Location;
+		GeneratedFoliageInfo.Radius = Descriptor.Radius;
+		GeneratedFoliageInfo.GrowthCurve = Descriptor.GrowthCurve;
+		GeneratedFoliageInfo.bIsTree = Descriptor.bIsTree;
+		Grid.Add(FoliageInfos.Add(GeneratedFoliageInfo), Location);
+
+		Count += 1;
+		return true;
+	}
+
+	/**
+	 * Rejection sampling, stops after MaxTries consecutive rejected candidates.
+	 */
+	void PlaceRandom(FPlacementContext& Context)
+	{
+		int Tries = 0;
+		while (Context.Count < Context.PlacementParams.SpawnCount && Tries < Context.PlacementParams.MaxTries) {
+			int DescriptorIndex;
+			float XPos;
+			float YPos;
+			Context.PickRandomCandidate(DescriptorIndex, XPos, YPos);
+			if (!Context.TryPlace(DescriptorIndex, XPos, YPos)) {
+				Tries += 1;
+				continue;
+			}
+			Tries = 0;
+		}
+	}
+
+	/**
+	 * Bridson's poisson-disk sampling. Every placed instance stays active until MaxTries candidates in the annulus between
+	 * one and two radii around it were rejected, so the tile is filled front by front and every candidate lands close to
+	 * the free space. Once no instance is active a new front is started at a random location, the placement stops
+	 * after MaxTries consecutive rejected random locations.
+	 */
+	void PlacePoissonDisk(FPlacementContext& Context)
+	{
+		TArray<int> ActiveInstances;
+		int SeedTries = 0;
+		while (Context.Count < Context.PlacementParams.SpawnCount) {
+			if (ActiveInstances.Num() == 0) {
+				if (SeedTries >= Context.PlacementParams.MaxTries) break;
+				int DescriptorIndex;
+				float XPos;
+				float YPos;
+				Context.PickRandomCandidate(DescriptorIndex, XPos, YPos);
+				if (!Context.TryPlace(DescriptorIndex, XPos, YPos)) {
+					SeedTries += 1;
+					continue;
+				}
+				SeedTries = 0;
+				ActiveInstances.Add(Context.FoliageInfos.Num() - 1);
+				continue;
+			}
+
+			int ActiveIndex = Context.RandomStream.RandRange(0, ActiveInstances.Num() - 1);
+			//Copied, the foliage infos grow while the candidates are placed
+			FVector ActiveLocation = Context.FoliageInfos[ActiveInstances[ActiveIndex]].Location;
+			float ActiveRadius = Context.FoliageInfos[ActiveInstances[ActiveIndex]].Radius;
+			bool bIsPlaced = false;
+			for (int Try = 0; Try < Context.PlacementParams.MaxTries && !bIsPlaced; ++Try) {
+				int DescriptorIndex = Context.RandomStream.RandRange(0, Context.Descriptors.Num() - 1);
+				float MinDistance = FMath::Max3(ActiveRadius, Context.Descriptors[DescriptorIndex].Radius, 1.f);
+				float Angle = Context.RandomStream.FRandRange(0.f, 2 * PI);
+				float Distance = Context.RandomStream.FRandRange(MinDistance, 2 * MinDistance);
+				float XPos = ActiveLocation.X + Distance * FMath::Cos(Angle);
+				float YPos = ActiveLocation.Y + Distance * FMath::Sin(Angle);
+				const FTileBounds& CurrentBounds = Context.TileBounds[DescriptorIndex];
+				if (XPos < CurrentBounds.XMin || XPos > CurrentBounds.XMax || YPos < CurrentBounds.YMin || YPos > CurrentBounds.YMax) continue;
+				if (!Context.TryPlace(DescriptorIndex, XPos, YPos)) continue;
+				ActiveInstances.Add(Context.FoliageInfos.Num() - 1);
+				bIsPlaced = true;
+			}
+			if (!bIsPlaced) ActiveInstances.RemoveAtSwap(ActiveIndex);
+		}
+	}
+}
+
+void FFoliagePlacement::PlaceFoliage(const FFoliagePlacementParams& PlacementParams, TArrayView<const FFoliageDescriptor> Descriptors, FFoliageGroundSampler SampleGround, TArray<FGeneratedFoliageInfo>& FoliageInfos, TArray<FFoliageInstance>& Instances_Out)
+{
+	if (Descriptors.Num() == 0) return;
+	FPlacementContext Context(PlacementParams, Descriptors, SampleGround, FoliageInfos, Instances_Out);
+	if (PlacementParams.Mode == EFoliagePlacementMode::PoissonDisk) PlacePoissonDisk(Context);
+	else PlaceRandom(Context);
+}
+
+bool FFoliagePlacement::DoesOverlap(FVector NewLocation, const FFoliageOverlapGrid& Grid, const TArray<FGeneratedFoliageInfo>& FoliageInfos, float CurrentFoliageRadius, float& Distance, float& ClosestRadius, FFoliageGrowthCurvePtr& GrowthCurve)
+{
+	return Grid.DoesOverlap(NewLocation, FoliageInfos, CurrentFoliageRadius, Distance, ClosestRadius, GrowthCurve);
+}
+
+FTileBounds FFoliagePlacement::GetTileBounds(const FFoliagePlacementParams& PlacementParams, const FFoliageDescriptor& Descriptor)
+{
+	int TileSize = PlacementParams.TileSize;
+	FTileBounds TileBounds;
+	TileBounds.XMin = -TileSize / 2 + Descriptor.Radius / 2;
+	TileBounds.XMax = TileSize / 2 - Descriptor.Radius / 2;
+	TileBounds.YMin = -TileSize / 2 + Descriptor.Radius / 2;
+	TileBounds.YMax = TileSize / 2 - Descriptor.Radius / 2;
+	return TileBounds;
+}
+
+void FFoliageOverlapGrid::Build(int TileSize, float MaxRadius, const TArray<FGeneratedFoliageInfo>& FoliageInfos)
+{
+	CellSize = FMath::Max3(MaxRadius, float(TileSize) / MaxCellsPerAxis, 1.f);
+	CellsPerAxis = FMath::Clamp(FMath::CeilToInt(TileSize / CellSize), 1, MaxCellsPerAxis);
+	Origin = -TileSize / 2.f;
+	CellHeads.Init(INDEX_NONE, CellsPerAxis * CellsPerAxis);
+	NextIndices.Reset(FoliageInfos.Num());
+	for (int i = 0; i < FoliageInfos.Num(); ++i) {
+		Add(i, FoliageInfos[i].Location);
+	}
+}
+
+void FFoliageOverlapGrid::Add(int FoliageInfoIndex, const FVector& Location)
+{
+	//Foliage outside the tile is clamped into the border cells, clamping never moves two locations further apart
+	int Cell = GetCellCoordinate(Location.X) * CellsPerAxis + GetCellCoordinate(Location.Y);
+	if (NextIndices.Num() <= FoliageInfoIndex) NextIndices.SetNumUninitialized(FoliageInfoIndex + 1, false);
+	NextIndices[FoliageInfoIndex] = CellHeads[Cell];
+	CellHeads[Cell] = FoliageInfoIndex;
+}
+
+bool FFoliageOverlapGrid::DoesOverlap(FVector NewLocation, const TArray<FGeneratedFoliageInfo>& FoliageInfos, float CurrentFoliageRadius, float& Distance, float& ClosestRadius, FFoliageGrowthCurvePtr& GrowthCurve) const
+{
+	bool bDoesOverlap = false;
+	Distance = TNumericLimits<float>::Max();
+	int CellX = GetCellCoordinate(NewLocation.X);
+	int CellY = GetCellCoordinate(NewLocation.Y);
+	for (int X = FMath::Max(CellX - 1, 0); X <= FMath::Min(CellX + 1, CellsPerAxis - 1); ++X) {
+		for (int Y = FMath::Max(CellY - 1, 0); Y <= FMath::Min(CellY + 1, CellsPerAxis - 1); ++Y) {
+			for (int i = CellHeads[X * CellsPerAxis + Y]; i != INDEX_NONE; i = NextIndices[i]) {
+				const FGeneratedFoliageInfo& CurrentFoliageInfo = FoliageInfos[i];
+				float CurrentDistance = FVector::Dist(CurrentFoliageInfo.Location, NewLocation);
+				if (CurrentDistance >= FMath::Max(CurrentFoliageRadius, CurrentFoliageInfo.Radius)) continue;
+				bDoesOverlap = true;
+				if (CurrentDistance < Distance && CurrentFoliageInfo.bIsTree) {
+					Distance = CurrentDistance;
+					ClosestRadius = CurrentFoliageInfo.Radius;
+					GrowthCurve = CurrentFoliageInfo.GrowthCurve;
+				}
+			}
+		}
+	}
+	return bDoesOverlap;
+}
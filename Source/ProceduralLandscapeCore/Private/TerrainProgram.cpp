@@ -0,0 +1,200 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainProgram.h"
+
+#include "TileFractalNoise.h"
+#include "TileNoise.h"
+
+#include "Hash/CityHash.h"
+
+namespace
+{
+	/**
+	 * Hashes the bytes of a plain value into the running hash.
+	 */
+	template<typename ValueType>
+	FORCEINLINE void HashValue(uint64& Hash, const ValueType& Value)
+	{
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&Value), sizeof(ValueType), Hash);
+	}
+}
+
+void FTerrainProgram::Finalize()
+{
+	//Index of the last instruction that reads each virtual register
+	TMap<int, int> LastReads;
+	for (int i = 0; i < Instructions.Num(); ++i) {
+		for (int Input : { Instructions[i].InputA, Instructions[i].InputB, Instructions[i].InputC }) {
+			if (Input >= 0) LastReads.Add(Input, i);
+		}
+	}
+	//The outputs are read after the last instruction
+	if (HeightRegister >= 0) LastReads.Add(HeightRegister, Instructions.Num());
+	if (ColorRegister >= 0) LastReads.Add(ColorRegister, Instructions.Num());
+
+	TMap<int, int> PhysicalRegisters;
+	TArray<int> FreeRegisters;
+	RegisterCount = 0;
+	for (int i = 0; i < Instructions.Num(); ++i) {
+		FTerrainInstruction& Instruction = Instructions[i];
+		for (int* Input : { &Instruction.InputA, &Instruction.InputB, &Instruction.InputC }) {
+			if (*Input < 0) continue;
+			int* PhysicalRegister = PhysicalRegisters.Find(*Input);
+			*Input = PhysicalRegister ? *PhysicalRegister : -1;
+		}
+		//Operands that are read for the last time can hold the output, every operation reads a sample before it writes it
+		for (int Input : { Instruction.InputA, Instruction.InputB, Instruction.InputC }) {
+			if (Input < 0 || FreeRegisters.Contains(Input)) continue;
+			const int* VirtualRegister = PhysicalRegisters.FindKey(Input);
+			if (VirtualRegister && LastReads.FindRef(*VirtualRegister) == i) {
+				PhysicalRegisters.Remove(*VirtualRegister);
+				FreeRegisters.Add(Input);
+			}
+		}
+		int VirtualOutput = Instruction.Output;
+		Instruction.Output = FreeRegisters.Num() > 0 ? FreeRegisters.Pop(false) : RegisterCount++;
+		if (LastReads.Contains(VirtualOutput)) PhysicalRegisters.Add(VirtualOutput, Instruction.Output);
+		else FreeRegisters.Add(Instruction.Output);
+	}
+	HeightRegister = HeightRegister >= 0 ? PhysicalRegisters.FindRef(HeightRegister) : -1;
+	ColorRegister = ColorRegister >= 0 ? PhysicalRegisters.FindRef(ColorRegister) : -1;
+	Hash = CalculateHash();
+}
+
+bool FTerrainProgram::IsValid() const
+{
+	if (HeightRegister < 0 || HeightRegister >= RegisterCount || ColorRegister >= RegisterCount) return false;
+	TBitArray<> Written(false, RegisterCount);
+	for (const FTerrainInstruction& Instruction : Instructions) {
+		for (int Input : { Instruction.InputA, Instruction.InputB, Instruction.InputC }) {
+			if (Input >= RegisterCount || (Input >= 0 && !Written[Input])) return false;
+		}
+		bool bHasOperands = true;
+		switch (Instruction.Op) {
+		case ETerrainOp::Add:
+		case ETerrainOp::Multiply:
+		case ETerrainOp::Min:
+		case ETerrainOp::Max:
+			bHasOperands = Instruction.InputA >= 0 && Instruction.InputB >= 0;
+			break;
+		case ETerrainOp::Clamp:
+		case ETerrainOp::Mask:
+			bHasOperands = Instruction.InputA >= 0;
+			break;
+		case ETerrainOp::Curve:
+			bHasOperands = Instruction.InputA >= 0 && Instruction.CurveCount >= 2 && Instruction.CurveStart >= 0 && Instruction.CurveStart + Instruction.CurveCount <= CurveSamples.Num();
+			break;
+		case ETerrainOp::Select:
+			bHasOperands = Instruction.InputA >= 0 && Instruction.InputB >= 0 && Instruction.InputC >= 0;
+			break;
+		default:
+			break;
+		}
+		if (!bHasOperands || Instruction.Output < 0 || Instruction.Output >= RegisterCount) return false;
+		Written[Instruction.Output] = true;
+	}
+	return Written[HeightRegister] && (ColorRegister < 0 || Written[ColorRegister]);
+}
+
+void FTerrainProgram::EvaluateRow(double XPos, const double* YPositions, int Count, float* Registers, float* Heights_Out, float* ColorHeights_Out) const
+{
+	TArray<float, TInlineAllocator<258>> FoldedYPositions;
+	FoldedYPositions.SetNumUninitialized(Count);
+	for (const FTerrainInstruction& Instruction : Instructions) {
+		float* Out = Registers + Instruction.Output * Count;
+		const float* A = Instruction.InputA >= 0 ? Registers + Instruction.InputA * Count : nullptr;
+		const float* B = Instruction.InputB >= 0 ? Registers + Instruction.InputB * Count : nullptr;
+		const float* C = Instruction.InputC >= 0 ? Registers + Instruction.InputC * Count : nullptr;
+		switch (Instruction.Op) {
+		case ETerrainOp::Constant:
+			for (int i = 0; i < Count; ++i) Out[i] = Instruction.Value;
+			break;
+		case ETerrainOp::Noise: {
+			float FoldedXPos = FTileNoise::FoldRow(XPos, YPositions, Count, Instruction.Scale, Instruction.Offset, FoldedYPositions.GetData());
+			FTileNoise::GetZOffsetRow(FoldedXPos, FoldedYPositions.GetData(), Count, FVector2D::UnitVector, FVector2D::ZeroVector, Instruction.Strength, Out);
+			break;
+		}
+		case ETerrainOp::Fractal:
+			if (Instruction.Fractal.IsEnabled()) FTileFractalNoise::GetZOffsetRow(XPos, YPositions, Count, Instruction.Fractal, Out);
+			else FMemory::Memzero(Out, Count * sizeof(float));
+			break;
+		case ETerrainOp::Add:
+			for (int i = 0; i < Count; ++i) Out[i] = A[i] + B[i];
+			break;
+		case ETerrainOp::Multiply:
+			for (int i = 0; i < Count; ++i) Out[i] = A[i] * B[i];
+			break;
+		case ETerrainOp::Min:
+			for (int i = 0; i < Count; ++i) Out[i] = FMath::Min(A[i], B[i]);
+			break;
+		case ETerrainOp::Max:
+			for (int i = 0; i < Count; ++i) Out[i] = FMath::Max(A[i], B[i]);
+			break;
+		case ETerrainOp::Clamp:
+			for (int i = 0; i < Count; ++i) Out[i] = FMath::Clamp(A[i], Instruction.MinValue, Instruction.MaxValue);
+			break;
+		case ETerrainOp::Curve: {
+			const float* Samples = CurveSamples.GetData() + Instruction.CurveStart;
+			float LastIndex = float(Instruction.CurveCount - 1);
+			float SamplesPerUnit = LastIndex / FMath::Max(Instruction.MaxValue - Instruction.MinValue, SMALL_NUMBER);
+			for (int i = 0; i < Count; ++i) {
+				float Position = FMath::Clamp((A[i] - Instruction.MinValue) * SamplesPerUnit, 0.f, LastIndex);
+				int Index = FMath::Min(int(Position), Instruction.CurveCount - 2);
+				Out[i] = FMath::Lerp(Samples[Index], Samples[Index + 1], Position - Index);
+			}
+			break;
+		}
+		case ETerrainOp::Mask: {
+			float InverseRange = 1.f / FMath::Max(Instruction.MaxValue - Instruction.MinValue, SMALL_NUMBER);
+			for (int i = 0; i < Count; ++i) {
+				float Alpha = FMath::Clamp((A[i] - Instruction.MinValue) * InverseRange, 0.f, 1.f);
+				Out[i] = Alpha * Alpha * (3.f - 2.f * Alpha);
+			}
+			break;
+		}
+		case ETerrainOp::Select:
+			for (int i = 0; i < Count; ++i) Out[i] = A[i] + (B[i] - A[i]) * C[i];
+			break;
+		}
+	}
+	FMemory::Memcpy(Heights_Out, Registers + HeightRegister * Count, Count * sizeof(float));
+	if (ColorRegister >= 0) FMemory::Memcpy(ColorHeights_Out, Registers + ColorRegister * Count, Count * sizeof(float));
+	else FMemory::Memzero(ColorHeights_Out, Count * sizeof(float));
+}
+
+uint64 FTerrainProgram::CalculateHash() const
+{
+	uint64 ProgramHash = 0;
+	HashValue(ProgramHash, HeightRegister);
+	HashValue(ProgramHash, ColorRegister);
+	for (const FTerrainInstruction& Instruction : Instructions) {
+		//Fields are hashed one by one, the padding of the instruction is undefined
+		HashValue(ProgramHash, Instruction.Op);
+		HashValue(ProgramHash, Instruction.Output);
+		HashValue(ProgramHash, Instruction.InputA);
+		HashValue(ProgramHash, Instruction.InputB);
+		HashValue(ProgramHash, Instruction.InputC);
+		HashValue(ProgramHash, Instruction.Value);
+		HashValue(ProgramHash, Instruction.MinValue);
+		HashValue(ProgramHash, Instruction.MaxValue);
+		HashValue(ProgramHash, Instruction.Scale);
+		HashValue(ProgramHash, Instruction.Offset);
+		HashValue(ProgramHash, Instruction.Strength);
+		HashValue(ProgramHash, Instruction.Fractal.OctaveCount);
+		HashValue(ProgramHash, Instruction.Fractal.Type);
+		HashValue(ProgramHash, Instruction.Fractal.Scale);
+		HashValue(ProgramHash, Instruction.Fractal.Offset);
+		HashValue(ProgramHash, Instruction.Fractal.Strength);
+		HashValue(ProgramHash, Instruction.Fractal.Lacunarity);
+		HashValue(ProgramHash, Instruction.Fractal.Gain);
+		HashValue(ProgramHash, Instruction.Fractal.WarpStrength);
+		HashValue(ProgramHash, Instruction.Fractal.WarpScale);
+		HashValue(ProgramHash, Instruction.CurveStart);
+		HashValue(ProgramHash, Instruction.CurveCount);
+	}
+	if (CurveSamples.Num() > 0) {
+		ProgramHash = CityHash64WithSeed(reinterpret_cast<const char*>(CurveSamples.GetData()), CurveSamples.Num() * sizeof(float), ProgramHash);
+	}
+	return ProgramHash;
+}
@@ -0,0 +1,182 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileFractalNoise.h"
+
+#include "TileNoise.h"
+
+#include "Templates/IntegerSequence.h"
+
+namespace
+{
+	//Added to the offset of every octave, otherwise all octaves share a lattice point at the origin of the noise
+	const FVector2D OctaveOffsetStep(19.19f, 47.77f);
+
+	//Offsets of the two warp noises, so the samples are not displaced along the diagonal only
+	const FVector2D WarpOffsetX(5.2f, 1.3f);
+	const FVector2D WarpOffsetY(1.7f, 9.2f);
+
+	//Large enough for a row of the highest tile resolution including the apron
+	typedef TArray<float, TInlineAllocator<258>> FNoiseRow;
+
+	//Sample locations in units of tiles, kept in double precision until they are folded into the period of the noise
+	typedef TArray<double, TInlineAllocator<258>> FLocationRow;
+
+	/**
+	 * Folded sample locations of the current octave.
+	 */
+	struct FFoldedRow
+	{
+		FNoiseRow XPositions;
+		FNoiseRow YPositions;
+	};
+
+	/**
+	 * Evaluates the unscaled noise of a single octave, XStride is 0 if all samples share the same X position.
+	 */
+	FORCEINLINE void EvaluateOctave(const double* XPositions, int XStride, const double* YPositions, int Count, FVector2D Scale, FVector2D Offset, FFoldedRow& Folded, float* Noise_Out)
+	{
+		if (XStride == 0) {
+			float FoldedXPos = FTileNoise::FoldRow(*XPositions, YPositions, Count, Scale, Offset, Folded.YPositions.GetData());
+			FTileNoise::GetZOffsetRow(FoldedXPos, Folded.YPositions.GetData(), Count, FVector2D::UnitVector, FVector2D::ZeroVector, 1.f, Noise_Out);
+			return;
+		}
+		for (int i = 0; i < Count; ++i) {
+			Folded.XPositions[i] = FTileNoise::FoldCoordinate(XPositions[i], Scale.X, Offset.X);
+			Folded.YPositions[i] = FTileNoise::FoldCoordinate(YPositions[i], Scale.Y, Offset.Y);
+		}
+		FTileNoise::GetZOffsets(Folded.XPositions.GetData(), Folded.YPositions.GetData(), Count, FVector2D::UnitVector, FVector2D::ZeroVector, 1.f, Noise_Out);
+	}
+
+	/**
+	 * Buffers and running parameters shared by the octaves of a row.
+	 */
+	struct FOctaveRow
+	{
+		FNoiseRow Noise;
+		FFoldedRow Folded;
+		FNoiseRow Weights;
+		FVector2D Scale;
+		float Strength;
+	};
+
+	/**
+	 * Adds a single octave to the offsets and advances the scale and strength to the next octave.
+	 */
+	template<ETileFractalType Type>
+	FORCEINLINE void AddOctave(int Octave, const double* XPositions, int XStride, const double* YPositions, int Count, const FTileFractalParams& FractalParams, FOctaveRow& Row, float* ZOffsets_Out)
+	{
+		EvaluateOctave(XPositions, XStride, YPositions, Count, Row.Scale, FractalParams.Offset + OctaveOffsetStep * Octave, Row.Folded, Row.Noise.GetData());
+		if constexpr (Type == ETileFractalType::Fbm) {
+			for (int i = 0; i < Count; ++i) {
+				ZOffsets_Out[i] += Row.Noise[i] * Row.Strength;
+			}
+		}
+		else {
+			//Valleys of one octave flatten the following octaves, so the detail gathers on the ridges
+			for (int i = 0; i < Count; ++i) {
+				float Signal = 1.f - FMath::Abs(Row.Noise[i]);
+				Signal *= Signal * Row.Weights[i];
+				Row.Weights[i] = FMath::Clamp(Signal * 2.f, 0.f, 1.f);
+				ZOffsets_Out[i] += Signal * Row.Strength;
+			}
+		}
+		Row.Scale *= FractalParams.Lacunarity;
+		Row.Strength *= FractalParams.Gain;
+	}
+
+	/**
+	 * Expands one call of AddOctave per octave at compile time, there is no loop and every octave index is a constant.
+	 */
+	template<ETileFractalType Type, int... Octaves>
+	FORCEINLINE void AddOctaves(TIntegerSequence<int, Octaves...>, const double* XPositions, int XStride, const double* YPositions, int Count, const FTileFractalParams& FractalParams, FOctaveRow& Row, float* ZOffsets_Out)
+	{
+		(AddOctave<Type>(Octaves, XPositions, XStride, YPositions, Count, FractalParams, Row, ZOffsets_Out), ...);
+	}
+
+	/**
+	 * Sums the octaves of the fractal. StaticOctaveCount is 0 if the octave count is only known at runtime and the octaves are
+	 * added in a loop, otherwise they are expanded at compile time.
+	 */
+	template<int StaticOctaveCount, ETileFractalType Type>
+	void SumOctaves(const double* XPositions, int XStride, const double* YPositions, int Count, const FTileFractalParams& FractalParams, float* ZOffsets_Out)
+	{
+		FOctaveRow Row;
+		Row.Noise.SetNumUninitialized(Count);
+		if (XStride != 0) Row.Folded.XPositions.SetNumUninitialized(Count);
+		Row.Folded.YPositions.SetNumUninitialized(Count);
+		if constexpr (Type == ETileFractalType::Ridged) Row.Weights.Init(1.f, Count);
+		Row.Scale = FractalParams.Scale;
+		Row.Strength = FractalParams.Strength;
+		FMemory::Memzero(ZOffsets_Out, Count * sizeof(float));
+
+		if constexpr (StaticOctaveCount > 0) {
+			AddOctaves<Type>(TMakeIntegerSequence<int, StaticOctaveCount>(), XPositions, XStride, YPositions, Count, FractalParams, Row, ZOffsets_Out);
+		}
+		else {
+			for (int Octave = 0; Octave < FractalParams.OctaveCount; ++Octave) {
+				AddOctave<Type>(Octave, XPositions, XStride, YPositions, Count, FractalParams, Row, ZOffsets_Out);
+			}
+		}
+	}
+
+	template<ETileFractalType Type>
+	void DispatchOctaves(const double* XPositions, int XStride, const double* YPositions, int Count, const FTileFractalParams& FractalParams, float* ZOffsets_Out)
+	{
+		static_assert(FTileFractalNoise::MaxUnrolledOctaveCount == 8, "Every octave count up to MaxUnrolledOctaveCount needs a case");
+		switch (FractalParams.OctaveCount) {
+		case 1: SumOctaves<1, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		case 2: SumOctaves<2, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		case 3: SumOctaves<3, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		case 4: SumOctaves<4, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		case 5: SumOctaves<5, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		case 6: SumOctaves<6, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		case 7: SumOctaves<7, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		case 8: SumOctaves<8, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		default: SumOctaves<0, Type>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out); break;
+		}
+	}
+
+	void EvaluateFractal(const double* XPositions, int XStride, const double* YPositions, int Count, const FTileFractalParams& FractalParams, float* ZOffsets_Out)
+	{
+		if (FractalParams.Type == ETileFractalType::Ridged) DispatchOctaves<ETileFractalType::Ridged>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out);
+		else DispatchOctaves<ETileFractalType::Fbm>(XPositions, XStride, YPositions, Count, FractalParams, ZOffsets_Out);
+	}
+}
+
+void FTileFractalNoise::GetZOffsetRow(double XPos, const double* YPositions, int Count, const FTileFractalParams& FractalParams, float* ZOffsets_Out)
+{
+	if (!FractalParams.IsWarped()) {
+		EvaluateFractal(&XPos, 0, YPositions, Count, FractalParams, ZOffsets_Out);
+		return;
+	}
+
+	//Every sample is displaced by a low frequency noise before the octaves are evaluated, this bends the features of the fractal
+	FNoiseRow FoldedYPositions;
+	FNoiseRow WarpX;
+	FNoiseRow WarpY;
+	FoldedYPositions.SetNumUninitialized(Count);
+	WarpX.SetNumUninitialized(Count);
+	WarpY.SetNumUninitialized(Count);
+	float FoldedXPos = FTileNoise::FoldRow(XPos, YPositions, Count, FractalParams.WarpScale, WarpOffsetX, FoldedYPositions.GetData());
+	FTileNoise::GetZOffsetRow(FoldedXPos, FoldedYPositions.GetData(), Count, FVector2D::UnitVector, FVector2D::ZeroVector, FractalParams.WarpStrength, WarpX.GetData());
+	FoldedXPos = FTileNoise::FoldRow(XPos, YPositions, Count, FractalParams.WarpScale, WarpOffsetY, FoldedYPositions.GetData());
+	FTileNoise::GetZOffsetRow(FoldedXPos, FoldedYPositions.GetData(), Count, FVector2D::UnitVector, FVector2D::ZeroVector, FractalParams.WarpStrength, WarpY.GetData());
+
+	FLocationRow WarpedXPositions;
+	FLocationRow WarpedYPositions;
+	WarpedXPositions.SetNumUninitialized(Count);
+	WarpedYPositions.SetNumUninitialized(Count);
+	for (int i = 0; i < Count; ++i) {
+		WarpedXPositions[i] = XPos + WarpX[i];
+		WarpedYPositions[i] = YPositions[i] + WarpY[i];
+	}
+	EvaluateFractal(WarpedXPositions.GetData(), 1, WarpedYPositions.GetData(), Count, FractalParams, ZOffsets_Out);
+}
+
+float FTileFractalNoise::GetZOffset(double XPos, double YPos, const FTileFractalParams& FractalParams)
+{
+	float ZOffset;
+	GetZOffsetRow(XPos, &YPos, 1, FractalParams, &ZOffset);
+	return ZOffset;
+}
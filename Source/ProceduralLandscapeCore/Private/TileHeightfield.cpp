@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileHeightfield.h"
+
+#include "TerrainProgram.h"
+#include "TileFractalNoise.h"
+#include "TileNoise.h"
+
+void FTileTerrain::GenerateHeightfield(const FTerrainTileParams& TerrainTileParams, FTileHeightfield& Heightfield_Out)
+{
+	int SampleCount = TerrainTileParams.TileResolution + 2;
+	float MeshSize = TerrainTileParams.GetMeshSize();
+	float DistanceBetweenVertices = MeshSize / (TerrainTileParams.TileResolution - 1);
+
+	Heightfield_Out.SampleCount = SampleCount;
+	Heightfield_Out.DistanceBetweenVertices = DistanceBetweenVertices;
+	Heightfield_Out.Heights.SetNumUninitialized(SampleCount * SampleCount, false);
+	Heightfield_Out.MinorHeights.SetNumUninitialized(SampleCount * SampleCount, false);
+	Heightfield_Out.MaxZ = 0;
+	Heightfield_Out.MinZ = 0;
+
+	//The V coordinate only depends on the column, so it is shared by every row.
+	//The locations stay in double precision, every layer folds them into the period of its noise.
+	TArray<double, TInlineAllocator<258>> VPositions;
+	VPositions.SetNumUninitialized(SampleCount);
+	for (int Column = -1; Column <= TerrainTileParams.TileResolution; ++Column) {
+		float CurrentYOffset = MeshSize / 2 - DistanceBetweenVertices * Column;
+		VPositions[Column + 1] = TerrainTileParams.GetNoiseY(CurrentYOffset);
+	}
+	TArray<float, TInlineAllocator<258>> FoldedVPositions;
+	FoldedVPositions.SetNumUninitialized(SampleCount);
+
+	//A terrain graph evaluates each of its instructions for a whole row, one register holds a row of samples
+	const FTerrainProgram* TerrainProgram = TerrainTileParams.TerrainProgram.Get();
+	TArray<float> Registers;
+	if (TerrainProgram) Registers.SetNumUninitialized(TerrainProgram->GetRegisterCount() * SampleCount);
+
+	TArray<float, TInlineAllocator<258>> MajorHeights;
+	MajorHeights.SetNumUninitialized(SampleCount);
+	bool bHasDetailNoise = TerrainTileParams.DetailNoise.IsEnabled();
+	TArray<float, TInlineAllocator<258>> DetailHeights;
+	if (bHasDetailNoise) DetailHeights.SetNumUninitialized(SampleCount);
+	for (int Row = -1; Row <= TerrainTileParams.TileResolution; ++Row) {
+		float CurrentXOffset = MeshSize / 2 - DistanceBetweenVertices * Row;
+		double UPos = TerrainTileParams.GetNoiseX(CurrentXOffset);
+
+		int RowStart = Heightfield_Out.GetSampleIndex(Row, -1);
+		float* MinorRow = Heightfield_Out.MinorHeights.GetData() + RowStart;
+		float* HeightRow = Heightfield_Out.Heights.GetData() + RowStart;
+		if (TerrainProgram) {
+			TerrainProgram->EvaluateRow(UPos, VPositions.GetData(), SampleCount, Registers.GetData(), HeightRow, MinorRow);
+		}
+		else {
+			float FoldedUPos = FTileNoise::FoldRow(UPos, VPositions.GetData(), SampleCount, TerrainTileParams.MinorNoiseScale, TerrainTileParams.MinorNoiseOffset, FoldedVPositions.GetData());
+			FTileNoise::GetZOffsetRow(FoldedUPos, FoldedVPositions.GetData(), SampleCount, FVector2D::UnitVector, FVector2D::ZeroVector, TerrainTileParams.MinorNoiseStrength, MinorRow);
+			FoldedUPos = FTileNoise::FoldRow(UPos, VPositions.GetData(), SampleCount, TerrainTileParams.MajorNoiseScale, TerrainTileParams.MajorNoiseOffset, FoldedVPositions.GetData());
+			FTileNoise::GetZOffsetRow(FoldedUPos, FoldedVPositions.GetData(), SampleCount, FVector2D::UnitVector, FVector2D::ZeroVector, TerrainTileParams.MajorNoiseStrength, MajorHeights.GetData());
+
+			for (int i = 0; i < SampleCount; ++i) {
+				HeightRow[i] = MajorHeights[i] + MinorRow[i];
+			}
+			if (bHasDetailNoise) {
+				FTileFractalNoise::GetZOffsetRow(UPos, VPositions.GetData(), SampleCount, TerrainTileParams.DetailNoise, DetailHeights.GetData());
+				for (int i = 0; i < SampleCount; ++i) {
+					HeightRow[i] += DetailHeights[i];
+				}
+			}
+		}
+
+		if (Row < 0 || Row >= TerrainTileParams.TileResolution) continue;
+		for (int Column = 0; Column < TerrainTileParams.TileResolution; ++Column) {
+			float CurrentZOffset = HeightRow[Column + 1];
+			if (CurrentZOffset < Heightfield_Out.MinZ) Heightfield_Out.MinZ = CurrentZOffset;
+			if (CurrentZOffset > Heightfield_Out.MaxZ) Heightfield_Out.MaxZ = CurrentZOffset;
+		}
+	}
+}
+
+FVector FTileTerrain::CalculateVertexNormal(const FTileHeightfield& Heightfield_In, int Row, int Column) {
+	//Rows grow towards -X and columns towards -Y, so the diagonal neighbours are the samples at Row +-1 and Column +-1
+	float DistanceBetweenVertices = Heightfield_In.DistanceBetweenVertices;
+	float ZTopLeft = Heightfield_In.GetHeight(Row + 1, Column - 1);
+	float ZTopRight = Heightfield_In.GetHeight(Row - 1, Column - 1);
+	float ZBottomLeft = Heightfield_In.GetHeight(Row + 1, Column + 1);
+	float ZBottomRight = Heightfield_In.GetHeight(Row - 1, Column + 1);
+
+	FVector TopLeftLocation(-DistanceBetweenVertices, DistanceBetweenVertices, ZTopLeft);
+	FVector TopRightLocation(DistanceBetweenVertices, DistanceBetweenVertices, ZTopRight);
+	FVector BottomLeftLocation(-DistanceBetweenVertices, -DistanceBetweenVertices, ZBottomLeft);
+	FVector BottomRightLocation(DistanceBetweenVertices, -DistanceBetweenVertices, ZBottomRight);
+
+
+	FVector Normal_01 = FVector::CrossProduct((BottomLeftLocation - TopLeftLocation), (TopRightLocation - TopLeftLocation));
+	FVector Normal_02 = FVector::CrossProduct((BottomRightLocation - BottomLeftLocation), (TopRightLocation - BottomLeftLocation));
+	return (Normal_02 + Normal_01 / 2).GetSafeNormal();
+}
+
+void FTileTerrain::GenerateNormals(const FTileHeightfield& Heightfield_In, FVector* Normals_Out)
+{
+	int TileResolution = Heightfield_In.SampleCount - 2;
+	for (int Row = 0; Row < TileResolution; ++Row) {
+		for (int Column = 0; Column < TileResolution; ++Column) {
+			Normals_Out[Row * TileResolution + Column] = CalculateVertexNormal(Heightfield_In, Row, Column);
+		}
+	}
+}
+
+float FTileTerrain::SampleHeight(const FTileHeightfield& Heightfield_In, float XOffset, float YOffset, FVector* Normal_Out)
+{
+	int TileResolution = Heightfield_In.SampleCount - 2;
+	if (TileResolution < 2 || Heightfield_In.Heights.Num() == 0) {
+		if (Normal_Out) *Normal_Out = FVector::UpVector;
+		return 0.f;
+	}
+
+	//Rows grow towards -X and columns towards -Y, see GenerateHeightfield
+	float DistanceBetweenVertices = Heightfield_In.DistanceBetweenVertices;
+	float HalfMeshSize = DistanceBetweenVertices * (TileResolution - 1) / 2;
+	float RowPosition = FMath::Clamp((HalfMeshSize - XOffset) / DistanceBetweenVertices, -1.f, float(TileResolution));
+	float ColumnPosition = FMath::Clamp((HalfMeshSize - YOffset) / DistanceBetweenVertices, -1.f, float(TileResolution));
+	int Row = FMath::Min(FMath::FloorToInt(RowPosition), TileResolution - 1);
+	int Column = FMath::Min(FMath::FloorToInt(ColumnPosition), TileResolution - 1);
+	float RowAlpha = RowPosition - Row;
+	float ColumnAlpha = ColumnPosition - Column;
+
+	float Z00 = Heightfield_In.GetHeight(Row, Column);
+	float Z01 = Heightfield_In.GetHeight(Row, Column + 1);
+	float Z10 = Heightfield_In.GetHeight(Row + 1, Column);
+	float Z11 = Heightfield_In.GetHeight(Row + 1, Column + 1);
+
+	if (Normal_Out) {
+		//The slope along X is the negated slope along the rows, the normal of z = f(x, y) is (-df/dx, -df/dy, 1)
+		float RowSlope = FMath::Lerp(Z10 - Z00, Z11 - Z01, ColumnAlpha) / DistanceBetweenVertices;
+		float ColumnSlope = FMath::Lerp(Z01 - Z00, Z11 - Z10, RowAlpha) / DistanceBetweenVertices;
+		*Normal_Out = FVector(RowSlope, ColumnSlope, 1).GetSafeNormal();
+	}
+	return FMath::Lerp(FMath::Lerp(Z00, Z01, ColumnAlpha), FMath::Lerp(Z10, Z11, ColumnAlpha), RowAlpha);
+}
+
+float FTileTerrain::MapToUV(int64 TileCoordinate, double NoisePosition) {
+	return float(double(TileCoordinate & 255) + (NoisePosition - double(TileCoordinate)));
+}
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileIndexBufferCache.h"
+
+#include "Misc/ScopeLock.h"
+
+FCriticalSection FTileIndexBufferCache::Lock;
+
+TMap<int, TSharedPtr<const TArray<int32>, ESPMode::ThreadSafe>> FTileIndexBufferCache::IndexBuffers;
+
+FTileIndexBufferRef FTileIndexBufferCache::Get(int TileResolution, bool bWithSkirts)
+{
+	int Key = (TileResolution << 1) | (bWithSkirts ? 1 : 0);
+	FScopeLock ScopeLock(&Lock);
+	TSharedPtr<const TArray<int32>, ESPMode::ThreadSafe>* IndexBuffer = IndexBuffers.Find(Key);
+	if (IndexBuffer) return IndexBuffer->ToSharedRef();
+
+	FTileIndexBufferRef NewIndexBuffer = MakeShared<TArray<int32>, ESPMode::ThreadSafe>(GenerateTriangles(TileResolution, bWithSkirts));
+	IndexBuffers.Add(Key, NewIndexBuffer);
+	return NewIndexBuffer;
+}
+
+int FTileIndexBufferCache::GetPerimeterVertex(int TileResolution, int PerimeterIndex)
+{
+	//The loop runs along row 0, the last column, the last row and column 0, so all skirt triangles face outwards
+	int LastIndex = TileResolution - 1;
+	int Side = PerimeterIndex / LastIndex;
+	int Offset = PerimeterIndex % LastIndex;
+	switch (Side) {
+	case 0: return Offset;
+	case 1: return Offset * TileResolution + LastIndex;
+	case 2: return LastIndex * TileResolution + (LastIndex - Offset);
+	default: return (LastIndex - Offset) * TileResolution;
+	}
+}
+
+TArray<int32> FTileIndexBufferCache::GenerateTriangles(int TileResolution, bool bWithSkirts)
+{
+	TArray<int32> Triangles;
+	int QuadsPerAxis = TileResolution - 1;
+	int PerimeterCount = bWithSkirts ? GetPerimeterCount(TileResolution) : 0;
+	Triangles.SetNumUninitialized(QuadsPerAxis * QuadsPerAxis * 6 + PerimeterCount * 6);
+
+	int32* Index = Triangles.GetData();
+	for (int Row = 0; Row < QuadsPerAxis; ++Row) {
+		for (int Column = 0; Column < QuadsPerAxis; ++Column) {
+			int Current = (Row * TileResolution) + Column;
+			int Right = Current + 1;
+			int Lower = Current + TileResolution;
+			int LowerRight = Lower + 1;
+			*Index++ = Right;
+			*Index++ = LowerRight;
+			*Index++ = Current;
+			*Index++ = Lower;
+			*Index++ = Current;
+			*Index++ = LowerRight;
+		}
+	}
+
+	//The skirt vertices follow the grid vertices in the same order as the perimeter loop
+	int FirstSkirtVertex = TileResolution * TileResolution;
+	for (int PerimeterIndex = 0; PerimeterIndex < PerimeterCount; ++PerimeterIndex) {
+		int NextPerimeterIndex = (PerimeterIndex + 1) % PerimeterCount;
+		int Current = GetPerimeterVertex(TileResolution, PerimeterIndex);
+		int Next = GetPerimeterVertex(TileResolution, NextPerimeterIndex);
+		int CurrentSkirt = FirstSkirtVertex + PerimeterIndex;
+		int NextSkirt = FirstSkirtVertex + NextPerimeterIndex;
+		*Index++ = Current;
+		*Index++ = CurrentSkirt;
+		*Index++ = Next;
+		*Index++ = Next;
+		*Index++ = CurrentSkirt;
+		*Index++ = NextSkirt;
+	}
+	return Triangles;
+}
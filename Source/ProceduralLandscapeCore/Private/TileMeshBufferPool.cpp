@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileMeshBufferPool.h"
+
+#include "TileIndexBufferCache.h"
+
+#include "Misc/ScopeLock.h"
+
+FTileMeshDataPtr FTileMeshBufferPool::Acquire(int TileResolution)
+{
+	FTileMeshDataPtr MeshData;
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (FreeBuffers.Num() > 0) MeshData = FreeBuffers.Pop(false);
+	}
+	if (!MeshData.IsValid()) MeshData = MakeShared<FTileMeshData, ESPMode::ThreadSafe>();
+
+	//Reserves room for skirts, so switching them on does not allocate
+	int VertexCount = TileResolution * TileResolution + FTileIndexBufferCache::GetPerimeterCount(TileResolution);
+	int SampleCount = (TileResolution + 2) * (TileResolution + 2);
+	PrepareStream(MeshData->Vertices, VertexCount);
+	PrepareStream(MeshData->Normals, VertexCount);
+	PrepareStream(MeshData->UV0, VertexCount);
+	PrepareStream(MeshData->VertexColor, VertexCount);
+	PrepareStream(MeshData->Heightfield.Heights, SampleCount);
+	PrepareStream(MeshData->Heightfield.MinorHeights, SampleCount);
+	MeshData->Triangles.Reset();
+	return MeshData;
+}
+
+void FTileMeshBufferPool::Release(const FTileMeshDataPtr& MeshData)
+{
+	if (!MeshData.IsValid()) return;
+	MeshData->Triangles.Reset();
+	FScopeLock ScopeLock(&Lock);
+	FreeBuffers.Add(MeshData);
+}
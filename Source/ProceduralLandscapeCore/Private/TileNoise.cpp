@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileNoise.h"
+
+#include "Math/RandomStream.h"
+
+namespace
+{
+	//Number of lanes of a VectorRegister4Float
+	constexpr int NoiseLaneCount = 4;
+
+	//Largest accepted difference between the kernel and FMath::PerlinNoise2D for the unscaled noise value
+	constexpr float NoiseTolerance = 2.5e-7f;
+
+	//Gradient directions of the engine's Grad2, indexed by Hash & 7
+	const float GradientX[8] = { 1.f, 1.f, 0.f, -1.f, -1.f, -1.f, 0.f, 1.f };
+	const float GradientY[8] = { 0.f, 1.f, 1.f, 1.f, 0.f, -1.f, -1.f, -1.f };
+
+	/**
+	 * Gradient index for every lattice point of the 256x256 noise period.
+	 * The engine does not expose its permutation table, so the indices are read back from FMath::PerlinNoise2D:
+	 * close to a lattice point the noise is dominated by the gradient of that point, and the probe offsets are
+	 * chosen so all eight gradients produce clearly distinct values.
+	 */
+	struct FGradientTable
+	{
+		uint8 Indices[256 * 256];
+
+		bool bIsValid = false;
+
+		FGradientTable()
+		{
+			const float ProbeX = 1.f / 1024;
+			const float ProbeY = 1.f / 4096;
+			for (int Xi = 0; Xi < 256; ++Xi) {
+				for (int Yi = 0; Yi < 256; ++Yi) {
+					float Value = FMath::PerlinNoise2D(FVector2D(Xi + ProbeX, Yi + ProbeY));
+					int BestIndex = 0;
+					float BestError = TNumericLimits<float>::Max();
+					for (int GradientIndex = 0; GradientIndex < 8; ++GradientIndex) {
+						float Error = FMath::Abs(Value - (GradientX[GradientIndex] * ProbeX + GradientY[GradientIndex] * ProbeY));
+						if (Error < BestError) {
+							BestError = Error;
+							BestIndex = GradientIndex;
+						}
+					}
+					Indices[GetIndex(Xi, Yi)] = uint8(BestIndex);
+				}
+			}
+			bIsValid = Validate();
+		}
+
+		static FORCEINLINE int GetIndex(int Xi, int Yi)
+		{
+			return ((Xi & 255) << 8) | (Yi & 255);
+		}
+
+		/**
+		 * Compares the scalar reproduction against FMath::PerlinNoise2D for a fixed set of random locations.
+		 */
+		bool Validate() const;
+	};
+
+	const FGradientTable& GetGradientTable()
+	{
+		static const FGradientTable GradientTable;
+		return GradientTable;
+	}
+
+	FORCEINLINE float SmoothCurve(float X)
+	{
+		return X * X * X * (X * (X * 6.0f - 15.0f) + 10.0f);
+	}
+
+	/**
+	 * Scalar reproduction of FMath::PerlinNoise2D that uses the gradient table.
+	 */
+	FORCEINLINE float PerlinNoise2D(const FGradientTable& GradientTable, float LocationX, float LocationY)
+	{
+		float Xfl = FMath::FloorToFloat(LocationX);
+		float Yfl = FMath::FloorToFloat(LocationY);
+		int32 Xi = (int32)(Xfl);
+		int32 Yi = (int32)(Yfl);
+		float X = LocationX - Xfl;
+		float Y = LocationY - Yfl;
+		float Xm1 = X - 1.0f;
+		float Ym1 = Y - 1.0f;
+
+		uint8 AA = GradientTable.Indices[FGradientTable::GetIndex(Xi, Yi)];
+		uint8 BA = GradientTable.Indices[FGradientTable::GetIndex(Xi + 1, Yi)];
+		uint8 AB = GradientTable.Indices[FGradientTable::GetIndex(Xi, Yi + 1)];
+		uint8 BB = GradientTable.Indices[FGradientTable::GetIndex(Xi + 1, Yi + 1)];
+
+		float U = SmoothCurve(X);
+		float V = SmoothCurve(Y);
+
+		float GradAA = GradientX[AA] * X + GradientY[AA] * Y;
+		float GradBA = GradientX[BA] * Xm1 + GradientY[BA] * Y;
+		float GradAB = GradientX[AB] * X + GradientY[AB] * Ym1;
+		float GradBB = GradientX[BB] * Xm1 + GradientY[BB] * Ym1;
+
+		return FMath::Lerp(FMath::Lerp(GradAA, GradBA, U), FMath::Lerp(GradAB, GradBB, U), V);
+	}
+
+	bool FGradientTable::Validate() const
+	{
+		FRandomStream RandomStream(256);
+		for (int i = 0; i < 1024; ++i) {
+			float LocationX = RandomStream.FRandRange(-512, 512);
+			float LocationY = RandomStream.FRandRange(-512, 512);
+			float Expected = FMath::PerlinNoise2D(FVector2D(LocationX, LocationY));
+			if (FMath::Abs(PerlinNoise2D(*this, LocationX, LocationY) - Expected) > NoiseTolerance) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+float FTileNoise::GetZOffset(float XPos, float YPos, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength)
+{
+	float ZOffset;
+	EvaluateBatch(&XPos, 0, &YPos, 1, NoiseScale, NoiseOffset, NoiseStrength, &ZOffset);
+	return ZOffset;
+}
+
+void FTileNoise::GetZOffsetRow(float XPos, const float* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength, float* ZOffsets_Out)
+{
+	EvaluateBatch(&XPos, 0, YPositions, Count, NoiseScale, NoiseOffset, NoiseStrength, ZOffsets_Out);
+}
+
+void FTileNoise::GetZOffsets(const float* XPositions, const float* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength, float* ZOffsets_Out)
+{
+	EvaluateBatch(XPositions, 1, YPositions, Count, NoiseScale, NoiseOffset, NoiseStrength, ZOffsets_Out);
+}
+
+float FTileNoise::FoldRow(double XPos, const double* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float* YPositions_Out)
+{
+	for (int i = 0; i < Count; ++i) {
+		YPositions_Out[i] = FoldCoordinate(YPositions[i], NoiseScale.Y, NoiseOffset.Y);
+	}
+	return FoldCoordinate(XPos, NoiseScale.X, NoiseOffset.X);
+}
+
+bool FTileNoise::IsVectorKernelEnabled()
+{
+	return GetGradientTable().bIsValid;
+}
+
+void FTileNoise::EvaluateBatch(const float* XPositions, int XStride, const float* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength, float* ZOffsets_Out)
+{
+	//Hoisted out of the sample loop, the engine evaluates the same products and sums in single precision.
+	//Scale and offset are applied in separate statements so they are never contracted into a fused multiply-add.
+	const float ScaleX = NoiseScale.X;
+	const float ScaleY = NoiseScale.Y;
+	const float OffsetX = NoiseOffset.X;
+	const float OffsetY = NoiseOffset.Y;
+
+	const FGradientTable& GradientTable = GetGradientTable();
+	if (!GradientTable.bIsValid) {
+		for (int i = 0; i < Count; ++i) {
+			float ScaledXPos = XPositions[i * XStride] * ScaleX;
+			float ScaledYPos = YPositions[i] * ScaleY;
+			ZOffsets_Out[i] = FMath::PerlinNoise2D(FVector2D(ScaledXPos + OffsetX, ScaledYPos + OffsetY)) * NoiseStrength;
+		}
+		return;
+	}
+
+	const VectorRegister4Float One = VectorSetFloat1(1.0f);
+	const VectorRegister4Float Six = VectorSetFloat1(6.0f);
+	const VectorRegister4Float Fifteen = VectorSetFloat1(15.0f);
+	const VectorRegister4Float Ten = VectorSetFloat1(10.0f);
+	const VectorRegister4Float Strength = VectorSetFloat1(NoiseStrength);
+
+	alignas(16) float Xs[NoiseLaneCount];
+	alignas(16) float Ys[NoiseLaneCount];
+	alignas(16) float GradientXs[4][NoiseLaneCount];
+	alignas(16) float GradientYs[4][NoiseLaneCount];
+	alignas(16) float Results[NoiseLaneCount];
+
+	int VectorCount = Count - Count % NoiseLaneCount;
+	for (int Start = 0; Start < VectorCount; Start += NoiseLaneCount) {
+		//Lattice lookups are gathers, they are done per lane and only the arithmetic runs in vector registers
+		for (int Lane = 0; Lane < NoiseLaneCount; ++Lane) {
+			float ScaledXPos = XPositions[(Start + Lane) * XStride] * ScaleX;
+			float ScaledYPos = YPositions[Start + Lane] * ScaleY;
+			float LocationX = ScaledXPos + OffsetX;
+			float LocationY = ScaledYPos + OffsetY;
+			float Xfl = FMath::FloorToFloat(LocationX);
+			float Yfl = FMath::FloorToFloat(LocationY);
+			int32 Xi = (int32)(Xfl);
+			int32 Yi = (int32)(Yfl);
+			Xs[Lane] = LocationX - Xfl;
+			Ys[Lane] = LocationY - Yfl;
+
+			uint8 Corners[4] = {
+				GradientTable.Indices[FGradientTable::GetIndex(Xi, Yi)],
+				GradientTable.Indices[FGradientTable::GetIndex(Xi + 1, Yi)],
+				GradientTable.Indices[FGradientTable::GetIndex(Xi, Yi + 1)],
+				GradientTable.Indices[FGradientTable::GetIndex(Xi + 1, Yi + 1)]
+			};
+			for (int Corner = 0; Corner < 4; ++Corner) {
+				GradientXs[Corner][Lane] = GradientX[Corners[Corner]];
+				GradientYs[Corner][Lane] = GradientY[Corners[Corner]];
+			}
+		}
+
+		//Multiplies and adds are kept separate so no fused multiply-add changes the rounding
+		VectorRegister4Float X = VectorLoadAligned(Xs);
+		VectorRegister4Float Y = VectorLoadAligned(Ys);
+		VectorRegister4Float Xm1 = VectorSubtract(X, One);
+		VectorRegister4Float Ym1 = VectorSubtract(Y, One);
+
+		VectorRegister4Float U = VectorMultiply(VectorMultiply(VectorMultiply(X, X), X), VectorAdd(VectorMultiply(X, VectorSubtract(VectorMultiply(X, Six), Fifteen)), Ten));
+		VectorRegister4Float V = VectorMultiply(VectorMultiply(VectorMultiply(Y, Y), Y), VectorAdd(VectorMultiply(Y, VectorSubtract(VectorMultiply(Y, Six), Fifteen)), Ten));
+
+		VectorRegister4Float GradAA = VectorAdd(VectorMultiply(VectorLoadAligned(GradientXs[0]), X), VectorMultiply(VectorLoadAligned(GradientYs[0]), Y));
+		VectorRegister4Float GradBA = VectorAdd(VectorMultiply(VectorLoadAligned(GradientXs[1]), Xm1), VectorMultiply(VectorLoadAligned(GradientYs[1]), Y));
+		VectorRegister4Float GradAB = VectorAdd(VectorMultiply(VectorLoadAligned(GradientXs[2]), X), VectorMultiply(VectorLoadAligned(GradientYs[2]), Ym1));
+		VectorRegister4Float GradBB = VectorAdd(VectorMultiply(VectorLoadAligned(GradientXs[3]), Xm1), VectorMultiply(VectorLoadAligned(GradientYs[3]), Ym1));
+
+		VectorRegister4Float LerpA = VectorAdd(GradAA, VectorMultiply(U, VectorSubtract(GradBA, GradAA)));
+		VectorRegister4Float LerpB = VectorAdd(GradAB, VectorMultiply(U, VectorSubtract(GradBB, GradAB)));
+		VectorRegister4Float Noise = VectorAdd(LerpA, VectorMultiply(V, VectorSubtract(LerpB, LerpA)));
+
+		VectorStoreAligned(VectorMultiply(Noise, Strength), Results);
+		FMemory::Memcpy(ZOffsets_Out + Start, Results, sizeof(Results));
+	}
+
+	for (int i = VectorCount; i < Count; ++i) {
+		float ScaledXPos = XPositions[i * XStride] * ScaleX;
+		float ScaledYPos = YPositions[i] * ScaleY;
+		ZOffsets_Out[i] = PerlinNoise2D(GradientTable, ScaledXPos + OffsetX, ScaledYPos + OffsetY) * NoiseStrength;
+	}
+}
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class ProceduralLandscapeCore : ModuleRules
+{
+	public ProceduralLandscapeCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		//The terrain math must not depend on UObjects, actors or the world, so it can run on any thread and in headless tools
+		PublicDependencyModuleNames.AddRange(new string[] { "Core" });
+	}
+}
@@ -0,0 +1,206 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Maps the normalized distance to the closest tree to a scale factor for the foliage growing next to it.
+ * The curve is evaluated on worker threads, so it must not reference UObjects.
+ */
+typedef TSharedPtr<const TFunction<float(float)>, ESPMode::ThreadSafe> FFoliageGrowthCurvePtr;
+
+/**
+ * Plain description of a foliage type, everything the placement needs and nothing else.
+ */
+struct FFoliageDescriptor
+{
+	//The radius in which no other foliage may be placed
+	float Radius = 0.f;
+
+	//Is this foliage type a tree?
+	bool bIsTree = false;
+
+	//Determines size of other foliage instances in the radius of this foliage type, can be null
+	FFoliageGrowthCurvePtr GrowthCurve;
+
+	//Should uniform scaling be applied?
+	bool bUniformScale = true;
+
+	float ScaleUniform = 1.f;
+
+	float ScaleRandomDeviationUniform = 0.f;
+
+	FVector Scale = FVector::OneVector;
+
+	FVector ScaleRandomDeviation = FVector::ZeroVector;
+
+	//Steepest slope of the ground in degrees this foliage type grows on, 90 allows any slope
+	float MaxSlope = 90.f;
+};
+
+/**
+ * Foliage that is already placed on a tile, later placements keep their distance to it.
+ * The location is relative to the center of the tile.
+ */
+struct FGeneratedFoliageInfo {
+	FVector Location;
+	FFoliageGrowthCurvePtr GrowthCurve;
+	float Radius;
+	bool bIsTree;
+};
+
+struct FTileBounds {
+	float XMin;
+	float XMax;
+	float YMin;
+	float YMax;
+};
+
+/**
+ * A single placed instance.
+ */
+struct FFoliageInstance
+{
+	FTransform Transform;
+
+	//Index of the foliage descriptor the instance was placed for
+	int DescriptorIndex = 0;
+};
+
+/**
+ * Uniform grid over the foliage of a tile that accelerates the overlap tests of the placement.
+ *
+ * Two instances overlap if they are closer than the larger of their radii, so with cells at least as large as the
+ * largest radius every overlap is found in the 3x3 cells around the new location. The cells store the indices of
+ * the foliage infos as linked lists, so adding an instance never allocates more than one int.
+ */
+class PROCEDURALLANDSCAPECORE_API FFoliageOverlapGrid
+{
+public:
+	//Upper bound of the cells on each axis, small foliage gets larger cells instead of millions of empty ones
+	static constexpr int MaxCellsPerAxis = 64;
+
+	/**
+	 * Sizes the grid for a tile and inserts the existing foliage of the tile.
+	 *
+	 * \param TileSize the size of the tile, the grid is centered on the tile
+	 * \param MaxRadius the largest radius of all foliage that is inserted or tested
+	 * \param FoliageInfos the existing foliage of the tile
+	 */
+	void Build(int TileSize, float MaxRadius, const TArray<FGeneratedFoliageInfo>& FoliageInfos);
+
+	/**
+	 * Inserts foliage that was appended to the foliage infos.
+	 *
+	 * \param FoliageInfoIndex the index of the foliage in the foliage infos
+	 * \param Location the location of the foliage
+	 */
+	void Add(int FoliageInfoIndex, const FVector& Location);
+
+	/**
+	 * Checks if NewLocation overlaps with any foliage in the neighbouring cells, see FFoliagePlacement::DoesOverlap.
+	 */
+	bool DoesOverlap(FVector NewLocation, const TArray<FGeneratedFoliageInfo>& FoliageInfos, float CurrentFoliageRadius, float& Distance, float& ClosestRadius, FFoliageGrowthCurvePtr& GrowthCurve) const;
+
+private:
+	//Location of the corner of the first cell on both axes
+	float Origin = 0.f;
+
+	float CellSize = 1.f;
+
+	int CellsPerAxis = 0;
+
+	//Index of the first foliage info in every cell, INDEX_NONE if the cell is empty
+	TArray<int> CellHeads;
+
+	//Index of the next foliage info in the same cell for every foliage info
+	TArray<int> NextIndices;
+
+	FORCEINLINE int GetCellCoordinate(float Position) const
+	{
+		return FMath::Clamp(FMath::FloorToInt((Position - Origin) / CellSize), 0, CellsPerAxis - 1);
+	}
+};
+
+/**
+ * How the candidate locations of a placement are chosen.
+ */
+enum class EFoliagePlacementMode : uint8
+{
+	//Random locations on the whole tile, stops after MaxTries consecutive rejected candidates
+	Random,
+
+	//Bridson's poisson-disk sampling, candidates are drawn around the placed instances and MaxTries is the number of candidates per instance
+	PoissonDisk
+};
+
+/**
+ * Parameters of a single foliage placement on a tile.
+ */
+struct FFoliagePlacementParams
+{
+	EFoliagePlacementMode Mode = EFoliagePlacementMode::Random;
+
+	//All locations are relative to the center of the tile, so they stay precise at any distance from the origin
+	int TileSize = 0;
+
+	//Max number of instances to place
+	int SpawnCount = 0;
+
+	//Max number of consecutive failed tries before the placement stops, see EFoliagePlacementMode
+	int MaxTries = 0;
+
+	//Seed of the random stream of the placement
+	int32 Seed = 0;
+};
+
+/**
+ * Finds the height and the normal of the ground at a location relative to the center of the tile, returns false if there is no ground.
+ * The sampler is called for every candidate on the thread of the placement.
+ */
+typedef TFunctionRef<bool(float XPos, float YPos, float& Z_Out, FVector& Normal_Out)> FFoliageGroundSampler;
+
+/**
+ * Pure functions for the placement of foliage on a tile.
+ */
+class PROCEDURALLANDSCAPECORE_API FFoliagePlacement
+{
+public:
+	/**
+	 * Places foliage instances that keep their distance to each other and to the existing foliage of the tile.
+	 * The instances are placed relative to the center of the tile.
+	 * Instances inside the radius of a tree with a growth curve are placed with a reduced scale instead of being rejected.
+	 * Candidates on ground that is steeper than the MaxSlope of their foliage type are rejected.
+	 *
+	 * \param PlacementParams the parameters of the placement
+	 * \param Descriptors the foliage types to place, each try picks one at random
+	 * \param SampleGround finds the ground below a candidate, candidates without ground are placed at Z = 0 on flat ground
+	 * \param FoliageInfos the existing foliage of the tile, the placed instances are added
+	 * \param Instances_Out receives the placed instances
+	 */
+	static void PlaceFoliage(const FFoliagePlacementParams& PlacementParams, TArrayView<const FFoliageDescriptor> Descriptors, FFoliageGroundSampler SampleGround, TArray<FGeneratedFoliageInfo>& FoliageInfos, TArray<FFoliageInstance>& Instances_Out);
+
+	/**
+	 * Checks if NewLocation overlaps with any location in FoliageInfos
+	 *
+	 * \param NewLocation The new location to check if it is valid
+	 * \param Grid the grid over the FoliageInfos
+	 * \param FoliageInfos The already existing foliage instances
+	 * \param CurrentFoliageRadius the radius of the foliage type that is placed
+	 * \param Distance the distance to the closest tree
+	 * \param ClosestRadius the radius of the closest tree
+	 * \param GrowthCurve the GrowthCurve of the closest tree
+	 * \return true if the location is inside the radius of existing foliage, false otherwise
+	 */
+	static bool DoesOverlap(FVector NewLocation, const FFoliageOverlapGrid& Grid, const TArray<FGeneratedFoliageInfo>& FoliageInfos, float CurrentFoliageRadius, float& Distance, float& ClosestRadius, FFoliageGrowthCurvePtr& GrowthCurve);
+
+	/**
+	 * Calculates the area of a tile in which the center of a foliage type may be placed, relative to the center of the tile.
+	 *
+	 * \param PlacementParams the parameters of the placement
+	 * \param Descriptor the foliage type
+	 * \return the bounds for the foliage type
+	 */
+	static FTileBounds GetTileBounds(const FFoliagePlacementParams& PlacementParams, const FFoliageDescriptor& Descriptor);
+};
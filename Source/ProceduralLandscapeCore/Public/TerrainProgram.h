@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileFractalNoise.h"
+
+/**
+ * Operations of a terrain program, every operation writes a whole row of samples into its output register.
+ */
+enum class ETerrainOp : uint8
+{
+	//Output = Value
+	Constant,
+
+	//Output = perlin noise at the sample location
+	Noise,
+
+	//Output = fractal noise at the sample location
+	Fractal,
+
+	//Output = A + B
+	Add,
+
+	//Output = A * B
+	Multiply,
+
+	//Output = Min(A, B)
+	Min,
+
+	//Output = Max(A, B)
+	Max,
+
+	//Output = Clamp(A, MinValue, MaxValue)
+	Clamp,
+
+	//Output = curve sampled at A, A is mapped from [MinValue, MaxValue] to the samples of the curve
+	Curve,
+
+	//Output = smooth step of A from MinValue to MaxValue, the result is in [0, 1]
+	Mask,
+
+	//Output = Lerp(A, B, C), C is usually a mask
+	Select
+};
+
+/**
+ * A single instruction of a terrain program.
+ */
+struct FTerrainInstruction
+{
+	ETerrainOp Op = ETerrainOp::Constant;
+
+	//Register the result is written to
+	int Output = 0;
+
+	//Registers of the operands, -1 if unused
+	int InputA = -1;
+
+	int InputB = -1;
+
+	int InputC = -1;
+
+	//Constant value
+	float Value = 0.f;
+
+	//Range of Clamp, Curve and Mask
+	float MinValue = 0.f;
+
+	float MaxValue = 1.f;
+
+	//Scale, offset and strength of Noise
+	FVector2D Scale = FVector2D::ZeroVector;
+
+	FVector2D Offset = FVector2D::ZeroVector;
+
+	float Strength = 0.f;
+
+	//Parameters of Fractal
+	FTileFractalParams Fractal;
+
+	//Range of the samples of Curve in FTerrainProgram::CurveSamples
+	int CurveStart = 0;
+
+	int CurveCount = 0;
+};
+
+/**
+ * Flat program that derives the height of a tile from its sample locations.
+ *
+ * A terrain graph is compiled into a program once. The program evaluates a whole row of the heightfield per
+ * instruction, so the cost per tile only depends on the number of instructions and not on the shape of the graph,
+ * and every instruction is a tight loop over contiguous floats. The program does not reference UObjects and
+ * is shared read-only between all worker threads.
+ */
+class PROCEDURALLANDSCAPECORE_API FTerrainProgram
+{
+public:
+	//Instructions in execution order, every operand is written by an earlier instruction
+	TArray<FTerrainInstruction> Instructions;
+
+	//Samples of all curves, every curve is sampled evenly over its input range
+	TArray<float> CurveSamples;
+
+	//Register that holds the height after the last instruction
+	int HeightRegister = -1;
+
+	//Register that is stored as the minor height and drives the vertex colors, -1 if the minor height is 0
+	int ColorRegister = -1;
+
+	/**
+	 * Finishes the program after all instructions were added. Until then every instruction may write its own register,
+	 * afterwards a register is reused as soon as its value is no longer read and the hash is up to date.
+	 */
+	void Finalize();
+
+	/**
+	 * Checks that every operand is written before it is read and that the height register is set.
+	 */
+	bool IsValid() const;
+
+	/**
+	 * Number of registers needed to evaluate the program.
+	 */
+	int GetRegisterCount() const {
+		return RegisterCount;
+	}
+
+	/**
+	 * Hash of all instructions and curves, changes whenever the generated terrain changes.
+	 */
+	uint64 GetHash() const {
+		return Hash;
+	}
+
+	/**
+	 * Evaluates the program for a row of samples that share the same X position
+	 *
+	 * \param XPos location on the X-axis of the whole row in units of tiles
+	 * \param YPositions locations on the Y-axis in units of tiles, Count entries
+	 * \param Count number of samples in the row
+	 * \param Registers scratch memory of GetRegisterCount() * Count floats
+	 * \param Heights_Out receives Count heights
+	 * \param ColorHeights_Out receives Count minor heights
+	 */
+	void EvaluateRow(double XPos, const double* YPositions, int Count, float* Registers, float* Heights_Out, float* ColorHeights_Out) const;
+
+private:
+	//Number of registers after the allocation
+	int RegisterCount = 0;
+
+	//Hash of the finished program
+	uint64 Hash = 0;
+
+	/**
+	 * Calculates the hash of all instructions and curves.
+	 */
+	uint64 CalculateHash() const;
+};
+
+typedef TSharedPtr<const FTerrainProgram, ESPMode::ThreadSafe> FTerrainProgramPtr;
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * How the octaves of a fractal noise layer are combined.
+ */
+enum class ETileFractalType : uint8
+{
+	//Plain sum of the octaves (fractional brownian motion)
+	Fbm,
+
+	//Inverted and squared octaves, every octave is weighted by the previous one, produces sharp ridges
+	Ridged
+};
+
+/**
+ * Plain parameters of a fractal noise layer.
+ */
+struct FTileFractalParams
+{
+	//Number of octaves, the layer is disabled if it is 0
+	int OctaveCount = 0;
+
+	//Type of the fractal
+	ETileFractalType Type = ETileFractalType::Fbm;
+
+	//X and Y scale of the first octave
+	FVector2D Scale = FVector2D::ZeroVector;
+
+	//X and Y offset of the first octave
+	FVector2D Offset = FVector2D::ZeroVector;
+
+	//Height of the first octave
+	float Strength = 0.f;
+
+	//Factor the frequency grows by from one octave to the next
+	float Lacunarity = 2.f;
+
+	//Factor the strength shrinks by from one octave to the next
+	float Gain = 0.5f;
+
+	//Distance in tiles the sample locations are displaced by, domain warping is disabled if it is 0
+	float WarpStrength = 0.f;
+
+	//X and Y scale of the noise that displaces the sample locations
+	FVector2D WarpScale = FVector2D::ZeroVector;
+
+	FORCEINLINE bool IsEnabled() const
+	{
+		return OctaveCount > 0 && Strength != 0.f;
+	}
+
+	FORCEINLINE bool IsWarped() const
+	{
+		return WarpStrength != 0.f;
+	}
+};
+
+/**
+ * Multi-octave noise built on top of the batched perlin noise of FTileNoise.
+ *
+ * The octaves are expanded at compile time for every octave count up to MaxUnrolledOctaveCount, so the common configurations
+ * run without a loop counter and with a constant offset per octave. Larger counts use a generic loop.
+ * Every octave is folded into the period of the perlin noise in double precision, so far away tiles keep their detail.
+ */
+class PROCEDURALLANDSCAPECORE_API FTileFractalNoise
+{
+public:
+	//Largest octave count that gets its own specialization
+	static constexpr int MaxUnrolledOctaveCount = 8;
+
+	/**
+	 * Calculates the Z-Offsets of the fractal for a row of samples that share the same X position
+	 *
+	 * \param XPos location on the X-axis of the whole row in units of tiles
+	 * \param YPositions locations on the Y-axis in units of tiles, Count entries
+	 * \param Count number of samples in the row
+	 * \param FractalParams the parameters of the fractal, must be enabled
+	 * \param ZOffsets_Out receives Count Z-Offsets
+	 */
+	static void GetZOffsetRow(double XPos, const double* YPositions, int Count, const FTileFractalParams& FractalParams, float* ZOffsets_Out);
+
+	/**
+	 * Calculates the Z-Offset of the fractal at Position(XPos,YPos)
+	 *
+	 * \param XPos location on the X-axis
+	 * \param YPos location on the Y-axis
+	 * \param FractalParams the parameters of the fractal, must be enabled
+	 * \return the Z-Offset
+	 */
+	static float GetZOffset(double XPos, double YPos, const FTileFractalParams& FractalParams);
+};
@@ -0,0 +1,188 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TerrainProgram.h"
+#include "TileFractalNoise.h"
+
+/**
+ * Plain parameters of the terrain of a single tile, everything the height and normal math needs and nothing else.
+ */
+struct FTerrainTileParams
+{
+	FVector2D MajorNoiseScale = FVector2D::ZeroVector;
+
+	FVector2D MajorNoiseOffset = FVector2D::ZeroVector;
+
+	FVector2D MinorNoiseScale = FVector2D::ZeroVector;
+
+	FVector2D MinorNoiseOffset = FVector2D::ZeroVector;
+
+	float MajorNoiseStrength = 0.f;
+
+	float MinorNoiseStrength = 0.f;
+
+	//Fractal layer that is added on top of the major and minor noise
+	FTileFractalParams DetailNoise;
+
+	//Compiled terrain graph, replaces the major, minor and detail noise if it is set
+	FTerrainProgramPtr TerrainProgram;
+
+	//Index of the tile in the corner with the smallest index
+	int64 TileX = 0;
+
+	int64 TileY = 0;
+
+	int TileSize = 0;
+
+	//Number of vertices on each axis
+	int TileResolution = 0;
+
+	//Number of tiles the mesh spans on each axis
+	int LODScale = 1;
+
+	/**
+	 * Width of the generated mesh, the distance between the vertices grows with the LODScale.
+	 */
+	FORCEINLINE float GetMeshSize() const
+	{
+		return float(TileSize) * LODScale;
+	}
+
+	/**
+	 * Location of the mesh center on the X-axis. The noise is always sampled in units of TileSize, so meshes of any scale share the same terrain.
+	 */
+	FORCEINLINE double GetMeshCenterX() const
+	{
+		return double(TileX) * TileSize + (LODScale - 1) * double(TileSize) / 2;
+	}
+
+	/**
+	 * Location of the mesh center on the Y-axis.
+	 */
+	FORCEINLINE double GetMeshCenterY() const
+	{
+		return double(TileY) * TileSize + (LODScale - 1) * double(TileSize) / 2;
+	}
+
+	/**
+	 * Converts an offset from the mesh center on the X-axis to the location of the noise in units of tiles.
+	 * The tile index and the local offset are combined in double precision, so the result stays exact far away from the origin.
+	 */
+	FORCEINLINE double GetNoiseX(double LocalOffset) const
+	{
+		return double(TileX) + (LocalOffset + double(TileSize) * LODScale / 2) / TileSize;
+	}
+
+	/**
+	 * Converts an offset from the mesh center on the Y-axis to the location of the noise in units of tiles.
+	 */
+	FORCEINLINE double GetNoiseY(double LocalOffset) const
+	{
+		return double(TileY) + (LocalOffset + double(TileSize) * LODScale / 2) / TileSize;
+	}
+};
+
+/**
+ * Heights of a tile sampled once per grid point, including a one sample apron around the tile
+ * so normals of border vertices can be derived without evaluating the noise again.
+ */
+struct FTileHeightfield
+{
+	//Number of samples on each axis including the apron (TileResolution + 2)
+	int SampleCount = 0;
+
+	//Distance between two neighbouring samples
+	float DistanceBetweenVertices = 0.f;
+
+	//Combined height of all noise layers for every sample
+	TArray<float> Heights;
+
+	//Height of the minor noise layer for every sample
+	TArray<float> MinorHeights;
+
+	//Highest height inside the tile (apron excluded)
+	float MaxZ = 0.f;
+
+	//Smallest height inside the tile (apron excluded)
+	float MinZ = 0.f;
+
+	/**
+	 * Converts a grid position to the index of the sample, Row and Column range from -1 to TileResolution.
+	 */
+	FORCEINLINE int GetSampleIndex(int Row, int Column) const
+	{
+		return (Row + 1) * SampleCount + (Column + 1);
+	}
+
+	FORCEINLINE float GetHeight(int Row, int Column) const
+	{
+		return Heights[GetSampleIndex(Row, Column)];
+	}
+
+	FORCEINLINE float GetMinorHeight(int Row, int Column) const
+	{
+		return MinorHeights[GetSampleIndex(Row, Column)];
+	}
+};
+
+/**
+ * Read only heightfield that is shared with worker threads, e.g. the foliage placement of a tile.
+ */
+typedef TSharedPtr<const FTileHeightfield, ESPMode::ThreadSafe> FTileHeightfieldPtr;
+
+/**
+ * Pure functions that derive the terrain of a tile from its parameters.
+ */
+class PROCEDURALLANDSCAPECORE_API FTileTerrain
+{
+public:
+	/**
+	 * Samples the height of every grid point of the tile and its one sample apron exactly once.
+	 * 
+	 * \param TerrainTileParams the parameters of the tile
+	 * \param Heightfield_Out reference to the heightfield that will store the samples, its buffers are reused
+	 */
+	static void GenerateHeightfield(const FTerrainTileParams& TerrainTileParams, FTileHeightfield& Heightfield_Out);
+
+	/**
+	 * Calculates the normal of the vertex at grid position (Row, Column) from its diagonal neighbours in the heightfield
+	 * 
+	 * \param Heightfield_In the previously sampled heights of a tile
+	 * \param Row current row
+	 * \param Column current column
+	 * \return the normal vector of this vertex
+	 */
+	static FVector CalculateVertexNormal(const FTileHeightfield& Heightfield_In, int Row, int Column);
+
+	/**
+	 * Calculates the normals of all grid vertices of a tile, row by row.
+	 * 
+	 * \param Heightfield_In the previously sampled heights of a tile
+	 * \param Normals_Out receives (SampleCount - 2)^2 normals, must be large enough
+	 */
+	static void GenerateNormals(const FTileHeightfield& Heightfield_In, FVector* Normals_Out);
+
+	/**
+	 * Interpolates the height of the terrain between the samples of the heightfield, so the ground below any location
+	 * of the tile is found without tracing against its collision. Locations outside the apron are clamped to it.
+	 * 
+	 * \param Heightfield_In the previously sampled heights of a tile
+	 * \param XOffset location on the X-axis relative to the mesh center
+	 * \param YOffset location on the Y-axis relative to the mesh center
+	 * \param Normal_Out receives the normal of the bilinear surface at the location, can be null
+	 * \return the height at the location, 0 if the heightfield is empty
+	 */
+	static float SampleHeight(const FTileHeightfield& Heightfield_In, float XOffset, float YOffset, FVector* Normal_Out = nullptr);
+
+	/**
+	 * Maps a location in units of tiles to the UV-Space. The textures repeat every tile, so only the tile index is wrapped
+	 * and the UVs of a mesh stay continuous while keeping their precision at any distance from the origin
+	 * 
+	 * \param TileCoordinate index of the tile on this axis
+	 * \param NoisePosition location in units of tiles, see FTerrainTileParams::GetNoiseX
+	 * \return mapped Value to UV-Space
+	 */
+	static float MapToUV(int64 TileCoordinate, double NoisePosition);
+};
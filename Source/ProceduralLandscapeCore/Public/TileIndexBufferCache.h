@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+typedef TSharedRef<const TArray<int32>, ESPMode::ThreadSafe> FTileIndexBufferRef;
+
+/**
+ * Process-wide cache of the triangle index lists of the tiles.
+ * The indices only depend on the resolution of a tile and if it has skirts, so every tile with the same layout shares one immutable list.
+ */
+class PROCEDURALLANDSCAPECORE_API FTileIndexBufferCache
+{
+public:
+	/**
+	 * Returns the index list for a tile, generates it on first use. Can be called from any thread.
+	 * 
+	 * \param TileResolution the resolution of a tile
+	 * \param bWithSkirts if the tile has a skirt vertex below every border vertex
+	 * \return the shared index list
+	 */
+	static FTileIndexBufferRef Get(int TileResolution, bool bWithSkirts = false);
+
+	/**
+	 * Number of vertices on the border of a tile, which is also the number of skirt vertices.
+	 * 
+	 * \param TileResolution the resolution of a tile
+	 * \return the number of border vertices
+	 */
+	static int GetPerimeterCount(int TileResolution) {
+		return 4 * (TileResolution - 1);
+	}
+
+	/**
+	 * Returns the grid vertex at a position of the closed loop around the border of a tile.
+	 * Skirt vertex PerimeterIndex lies below this vertex.
+	 * 
+	 * \param TileResolution the resolution of a tile
+	 * \param PerimeterIndex the position on the border, from 0 to GetPerimeterCount - 1
+	 * \return the index of the grid vertex
+	 */
+	static int GetPerimeterVertex(int TileResolution, int PerimeterIndex);
+
+private:
+	//The lock to regulate access to the IndexBuffers map
+	static FCriticalSection Lock;
+
+	//Index lists by resolution and skirt layout
+	static TMap<int, TSharedPtr<const TArray<int32>, ESPMode::ThreadSafe>> IndexBuffers;
+
+	/**
+	 * Generates the triangle index list of a tile
+	 * 
+	 * \param TileResolution the resolution of a tile
+	 * \param bWithSkirts if triangles for the skirts should be added
+	 * \return the generated index list
+	 */
+	static TArray<int32> GenerateTriangles(int TileResolution, bool bWithSkirts);
+};
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileMeshData.h"
+
+#include <atomic>
+
+/**
+ * Pool of reusable mesh data buffers for the tile generation.
+ * Tiles borrow a buffer for the generation of their mesh and return it once the mesh is uploaded,
+ * so streaming tiles of the same resolution does not allocate vertex data anymore.
+ */
+class PROCEDURALLANDSCAPECORE_API FTileMeshBufferPool
+{
+public:
+	/**
+	 * Borrows a buffer whose streams are empty and have enough capacity for a tile of this resolution.
+	 * 
+	 * \param TileResolution the resolution of the tile that will be generated
+	 * \return the borrowed buffer
+	 */
+	FTileMeshDataPtr Acquire(int TileResolution);
+
+	/**
+	 * Returns a buffer to the pool.
+	 * 
+	 * \param MeshData the buffer that was previously borrowed
+	 */
+	void Release(const FTileMeshDataPtr& MeshData);
+
+	/**
+	 * Number of times a stream of a pooled buffer had to allocate memory, stays constant while streaming in steady state.
+	 * 
+	 * \return the number of allocations
+	 */
+	int GetAllocationCount() const {
+		return AllocationCount.load();
+	}
+
+private:
+	//The lock to regulate access to the FreeBuffers array
+	FCriticalSection Lock;
+
+	//Buffers that are currently not borrowed
+	TArray<FTileMeshDataPtr> FreeBuffers;
+
+	//Number of times a stream had to allocate memory
+	std::atomic<int> AllocationCount{ 0 };
+
+	/**
+	 * Empties a stream and makes sure it can hold Num elements without allocating.
+	 * 
+	 * \param Stream the stream to prepare
+	 * \param Num the number of elements the stream has to hold
+	 */
+	template<typename ElementType>
+	void PrepareStream(TArray<ElementType>& Stream, int Num)
+	{
+		Stream.Reset();
+		if (Stream.Max() < Num) {
+			Stream.Reserve(Num);
+			++AllocationCount;
+		}
+	}
+};
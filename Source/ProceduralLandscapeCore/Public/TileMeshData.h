@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileHeightfield.h"
+
+/**
+ * Plain buffers of a generated tile mesh. They can be filled on any thread and are uploaded on the game thread.
+ */
+struct FTileMeshData
+{
+	TArray<FVector> Vertices;
+
+	//Shared index list of all tiles with the same resolution, only set if a new mesh section is created
+	TSharedPtr<const TArray<int32>, ESPMode::ThreadSafe> Triangles;
+
+	TArray<FVector> Normals;
+
+	TArray<FVector2D> UV0;
+
+	TArray<FColor> VertexColor;
+
+	//Heights the vertices were generated from
+	FTileHeightfield Heightfield;
+
+	//Size of the tile the data was generated for
+	int TileSize = 0;
+};
+
+typedef TSharedPtr<FTileMeshData, ESPMode::ThreadSafe> FTileMeshDataPtr;
+
+typedef TSharedPtr<class FTileMeshBufferPool, ESPMode::ThreadSafe> FTileMeshBufferPoolPtr;
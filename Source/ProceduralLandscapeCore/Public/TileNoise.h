@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Batched evaluation of the perlin noise that is used for the height of the tiles.
+ *
+ * The vectorized kernel reproduces FMath::PerlinNoise2D with the same operation order, so results are
+ * bit-for-bit identical as long as the compiler does not contract the scalar engine code into fused
+ * multiply-adds. If it does, the difference stays below 2 ULP of the unscaled noise value (|Z| <= 2.5e-7 * NoiseStrength).
+ * The gradient table is derived from FMath::PerlinNoise2D on first use and validated against it,
+ * if the validation fails every sample falls back to the scalar engine function.
+ */
+class PROCEDURALLANDSCAPECORE_API FTileNoise
+{
+public:
+	//The lattice of the perlin noise wraps after this many units on both axes
+	static constexpr double NoisePeriod = 256.0;
+
+	/**
+	 * Caclulates the Z-Offset at Position(XPos,YPos) using the perlin noise function
+	 *
+	 * \param XPos location on the X-axis
+	 * \param YPos location on the Y-axis
+	 * \param NoiseScale scale of the the PerlineNoise
+	 * \param NoiseOffset offset of the PerlineNoise
+	 * \param NoiseStrength strength of the PerlineNoise
+	 * \return the Z-Position of a vertex
+	 */
+	static float GetZOffset(float XPos, float YPos, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength);
+
+	/**
+	 * Caclulates the Z-Offsets for a row of samples that share the same X position
+	 *
+	 * \param XPos location on the X-axis of the whole row
+	 * \param YPositions locations on the Y-axis, Count entries
+	 * \param Count number of samples in the row
+	 * \param NoiseScale scale of the the PerlineNoise
+	 * \param NoiseOffset offset of the PerlineNoise
+	 * \param NoiseStrength strength of the PerlineNoise
+	 * \param ZOffsets_Out receives Count Z-Offsets
+	 */
+	static void GetZOffsetRow(float XPos, const float* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength, float* ZOffsets_Out);
+
+	/**
+	 * Caclulates the Z-Offsets for arbitrary sample positions
+	 *
+	 * \param XPositions locations on the X-axis, Count entries
+	 * \param YPositions locations on the Y-axis, Count entries
+	 * \param Count number of samples
+	 * \param NoiseScale scale of the the PerlineNoise
+	 * \param NoiseOffset offset of the PerlineNoise
+	 * \param NoiseStrength strength of the PerlineNoise
+	 * \param ZOffsets_Out receives Count Z-Offsets
+	 */
+	static void GetZOffsets(const float* XPositions, const float* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength, float* ZOffsets_Out);
+
+	/**
+	 * Scales and offsets a location in double precision and folds it into a single period of the noise.
+	 * The perlin noise repeats every NoisePeriod units, so the folded value produces the same noise
+	 * with full float precision no matter how far the location is from the origin.
+	 *
+	 * \param Position location on one axis in units of tiles
+	 * \param NoiseScale scale of the noise on this axis
+	 * \param NoiseOffset offset of the noise on this axis
+	 * \return the noise coordinate in [0, NoisePeriod), to be sampled with a scale of 1 and an offset of 0
+	 */
+	static FORCEINLINE float FoldCoordinate(double Position, double NoiseScale, double NoiseOffset)
+	{
+		double NoisePosition = Position * NoiseScale + NoiseOffset;
+		return float(NoisePosition - NoisePeriod * FMath::FloorToDouble(NoisePosition / NoisePeriod));
+	}
+
+	/**
+	 * Folds the locations of a row of samples that share the same X position, see FoldCoordinate
+	 *
+	 * \param XPos location on the X-axis of the whole row
+	 * \param YPositions locations on the Y-axis, Count entries
+	 * \param Count number of samples in the row
+	 * \param NoiseScale scale of the the PerlineNoise
+	 * \param NoiseOffset offset of the PerlineNoise
+	 * \param YPositions_Out receives Count folded locations on the Y-axis
+	 * \return the folded location on the X-axis
+	 */
+	static float FoldRow(double XPos, const double* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float* YPositions_Out);
+
+	/**
+	 * Checks if the vectorized kernel is used or if all samples are evaluated with FMath::PerlinNoise2D.
+	 *
+	 * \return true if the vectorized kernel passed its validation
+	 */
+	static bool IsVectorKernelEnabled();
+
+private:
+	/**
+	 * Evaluates Count samples, XStride is 0 if all samples share the same X position.
+	 */
+	static void EvaluateBatch(const float* XPositions, int XStride, const float* YPositions, int Count, FVector2D NoiseScale, FVector2D NoiseOffset, float NoiseStrength, float* ZOffsets_Out);
+};
@@ -9,6 +9,6 @@ public class ProceduralLandscapeEditorTarget : TargetRules
 	{
 		Type = TargetType.Editor;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
-		ExtraModuleNames.AddRange( new string[] { "ProceduralLandscape" } );
+		ExtraModuleNames.AddRange( new string[] { "ProceduralLandscape", "ProceduralLandscapeCore" } );
 	}
 }